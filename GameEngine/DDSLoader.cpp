@@ -1,50 +1,391 @@
 #include "DDSLoader.h"
 
-bool DDSLoader::load(const std::filesystem::path& path, std::uint32_t& width, std::uint32_t& height, VkFormat& format, std::vector<std::uint8_t>& data) {
+VkFormat DDSLoader::toVkFormat(DXGIFormat format) {
+	switch (format) {
+	case DXGIFormat::R16G16B16A16_FLOAT:  return VK_FORMAT_R16G16B16A16_SFLOAT;
+	case DXGIFormat::R8G8B8A8_UNORM:      return VK_FORMAT_R8G8B8A8_UNORM;
+	case DXGIFormat::R8G8B8A8_UNORM_SRGB: return VK_FORMAT_R8G8B8A8_SRGB;
+	case DXGIFormat::B8G8R8A8_UNORM:      return VK_FORMAT_B8G8R8A8_UNORM;
+	case DXGIFormat::B8G8R8A8_UNORM_SRGB: return VK_FORMAT_B8G8R8A8_SRGB;
+	case DXGIFormat::BC1_UNORM:           return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	case DXGIFormat::BC1_UNORM_SRGB:      return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+	case DXGIFormat::BC2_UNORM:           return VK_FORMAT_BC2_UNORM_BLOCK;
+	case DXGIFormat::BC2_UNORM_SRGB:      return VK_FORMAT_BC2_SRGB_BLOCK;
+	case DXGIFormat::BC3_UNORM:           return VK_FORMAT_BC3_UNORM_BLOCK;
+	case DXGIFormat::BC3_UNORM_SRGB:      return VK_FORMAT_BC3_SRGB_BLOCK;
+	case DXGIFormat::BC4_UNORM:           return VK_FORMAT_BC4_UNORM_BLOCK;
+	case DXGIFormat::BC4_SNORM:           return VK_FORMAT_BC4_SNORM_BLOCK;
+	case DXGIFormat::BC5_UNORM:           return VK_FORMAT_BC5_UNORM_BLOCK;
+	case DXGIFormat::BC5_SNORM:           return VK_FORMAT_BC5_SNORM_BLOCK;
+	case DXGIFormat::BC6H_UF16:           return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+	case DXGIFormat::BC6H_SF16:           return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+	case DXGIFormat::BC7_UNORM:           return VK_FORMAT_BC7_UNORM_BLOCK;
+	case DXGIFormat::BC7_UNORM_SRGB:      return VK_FORMAT_BC7_SRGB_BLOCK;
+	default:                              return VK_FORMAT_UNDEFINED;
+	}
+}
+
+DDSLoader::DXGIFormat DDSLoader::toDXGIFormat(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_R16G16B16A16_SFLOAT:  return DXGIFormat::R16G16B16A16_FLOAT;
+	case VK_FORMAT_R8G8B8A8_UNORM:       return DXGIFormat::R8G8B8A8_UNORM;
+	case VK_FORMAT_R8G8B8A8_SRGB:        return DXGIFormat::R8G8B8A8_UNORM_SRGB;
+	case VK_FORMAT_B8G8R8A8_UNORM:       return DXGIFormat::B8G8R8A8_UNORM;
+	case VK_FORMAT_B8G8R8A8_SRGB:        return DXGIFormat::B8G8R8A8_UNORM_SRGB;
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: return DXGIFormat::BC1_UNORM;
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:  return DXGIFormat::BC1_UNORM_SRGB;
+	case VK_FORMAT_BC2_UNORM_BLOCK:      return DXGIFormat::BC2_UNORM;
+	case VK_FORMAT_BC2_SRGB_BLOCK:       return DXGIFormat::BC2_UNORM_SRGB;
+	case VK_FORMAT_BC3_UNORM_BLOCK:      return DXGIFormat::BC3_UNORM;
+	case VK_FORMAT_BC3_SRGB_BLOCK:       return DXGIFormat::BC3_UNORM_SRGB;
+	case VK_FORMAT_BC4_UNORM_BLOCK:      return DXGIFormat::BC4_UNORM;
+	case VK_FORMAT_BC4_SNORM_BLOCK:      return DXGIFormat::BC4_SNORM;
+	case VK_FORMAT_BC5_UNORM_BLOCK:      return DXGIFormat::BC5_UNORM;
+	case VK_FORMAT_BC5_SNORM_BLOCK:      return DXGIFormat::BC5_SNORM;
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:    return DXGIFormat::BC6H_UF16;
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK:    return DXGIFormat::BC6H_SF16;
+	case VK_FORMAT_BC7_UNORM_BLOCK:      return DXGIFormat::BC7_UNORM;
+	case VK_FORMAT_BC7_SRGB_BLOCK:       return DXGIFormat::BC7_UNORM_SRGB;
+	default:                             return (DXGIFormat)0;
+	}
+}
+
+DDSLoader::BlockInfo DDSLoader::blockInfo(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC4_SNORM_BLOCK:
+		return { 4, 8 };
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return { 4, 16 };
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		return { 1, 8 };
+	default:
+		return { 1, 4 };
+	}
+}
+
+bool DDSLoader::load(const std::filesystem::path& path, TexImage& image) {
 	std::ifstream ifs(path, std::ios::in | std::ios::binary);
 	if (!ifs) {
 		std::cerr << "[DDSLoader] (" << path << ") failed to open file" << std::endl;
 		return false;
 	}
 
+	ifs.seekg(0, std::ios::end);
+	auto fileSize = ifs.tellg();
+	ifs.seekg(0, std::ios::beg);
+
+	std::vector<std::uint8_t> fileData(fileSize);
+	ifs.read((char*)fileData.data(), fileSize);
+
+	return load(fileData, image);
+}
+
+bool DDSLoader::load(const std::vector<std::uint8_t>& fileData, TexImage& image) {
+	std::size_t payloadOffset{}, payloadSize{};
+	if (!parseHeader(fileData.data(), fileData.size(), fileData.size(), image, payloadOffset, payloadSize)) return false;
+
+	image.data.assign(fileData.begin() + payloadOffset, fileData.begin() + payloadOffset + payloadSize);
+	if (alphaModeUnknown_) image.opaque = isOpaque(image.format, image.data.data(), image.data.size());
+
+	return true;
+}
+
+bool DDSLoader::parseHeader(const std::uint8_t* headerData, std::size_t headerSize, std::size_t fileSize, TexImage& image, std::size_t& payloadOffset, std::size_t& payloadSize) {
+	if (headerSize < sizeof(Header)) {
+		std::cerr << "[DDSLoader] input file is too small for DDS header" << std::endl;
+		return false;
+	}
+
 	Header header{};
-	ifs.read((char*)&header, sizeof(Header));
+	std::memcpy(&header, headerData, sizeof(Header));
 
 	if (!(header.magic == 0x20534444 && header.size == 124)) {
-		std::cerr << "[DDSLoader] (" << path << ") input file is not DDS file" << std::endl;
+		std::cerr << "[DDSLoader] input file is not DDS file" << std::endl;
 		return false;
 	}
 
-	width = header.width;
-	height = header.height;
+	payloadOffset = sizeof(Header);
+	image.format = VK_FORMAT_UNDEFINED;
+	image.arrayLayers = 1;
+	image.cube = false;
+	image.opaque = false;
+	// legacy headers carry no alpha mode
+	alphaModeUnknown_ = true;
 
 	// format check
-	switch ((FourCC)header.fourCC) {
-	case FourCC::DXT1:
-		format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
-		break;
-	case FourCC::DXT2:
-	case FourCC::DXT3:
-		format = VK_FORMAT_BC2_SRGB_BLOCK;
+	if (header.pfFlags & PF_FOURCC) {
+		switch ((FourCC)header.fourCC) {
+		case FourCC::DX10: {
+			if (headerSize < sizeof(Header) + sizeof(ExtendHeader)) {
+				std::cerr << "[DDSLoader] input file is too small for DX10 header" << std::endl;
+				return false;
+			}
+
+			ExtendHeader extendHeader{};
+			std::memcpy(&extendHeader, headerData + sizeof(Header), sizeof(ExtendHeader));
+			payloadOffset += sizeof(ExtendHeader);
+
+			if ((DDSDimension)extendHeader.dimension == DDSDimension::DIM_3D) {
+				std::cerr << "[DDSLoader] volume texture is not supported" << std::endl;
+				return false;
+			}
+
+			image.format = toVkFormat((DXGIFormat)extendHeader.format);
+			image.cube = (extendHeader.miscFlag & MISC_TEXTURECUBE) != 0;
+			image.arrayLayers = std::max<std::uint32_t>(1, extendHeader.arraySize) * (image.cube ? 6 : 1);
+			image.opaque = (extendHeader.miscFlag2 & ALPHA_MODE_MASK) == ALPHA_MODE_OPAQUE;
+			alphaModeUnknown_ = (extendHeader.miscFlag2 & ALPHA_MODE_MASK) == ALPHA_MODE_UNKNOWN;
+			break;
+		}
+		case FourCC::DXT1:
+			image.format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+			break;
+		case FourCC::DXT2:
+		case FourCC::DXT3:
+			image.format = VK_FORMAT_BC2_SRGB_BLOCK;
+			break;
+		case FourCC::DXT4:
+		case FourCC::DXT5:
+			image.format = VK_FORMAT_BC3_SRGB_BLOCK;
+			break;
+		case FourCC::ATI1:
+		case FourCC::BC4U:
+			image.format = VK_FORMAT_BC4_UNORM_BLOCK;
+			break;
+		case FourCC::BC4S:
+			image.format = VK_FORMAT_BC4_SNORM_BLOCK;
+			break;
+		case FourCC::ATI2:
+		case FourCC::BC5U:
+			image.format = VK_FORMAT_BC5_UNORM_BLOCK;
+			break;
+		case FourCC::BC5S:
+			image.format = VK_FORMAT_BC5_SNORM_BLOCK;
+			break;
+		case FourCC::RGBA16F:
+			image.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+			break;
+		default:
+			break;
+		}
+	}
+	else if ((header.pfFlags & PF_RGB) && header.rgbBitCount == 32) {
+		if (header.rBitMask == 0x000000ff && header.gBitMask == 0x0000ff00 && header.bBitMask == 0x00ff0000) {
+			image.format = VK_FORMAT_R8G8B8A8_UNORM;
+		}
+		else if (header.rBitMask == 0x00ff0000 && header.gBitMask == 0x0000ff00 && header.bBitMask == 0x000000ff) {
+			image.format = VK_FORMAT_B8G8R8A8_UNORM;
+		}
+	}
+
+	if (image.format == VK_FORMAT_UNDEFINED) {
+		std::cerr << "[DDSLoader] input file has unknown format" << std::endl;
+		return false;
+	}
+
+	// formats without alpha channel are sampled with alpha 1
+	switch (image.format) {
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC4_SNORM_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+		image.opaque = true;
+		alphaModeUnknown_ = false;
 		break;
-	case FourCC::DXT4:
-	case FourCC::DXT5:
-		format = VK_FORMAT_BC3_SRGB_BLOCK;
+	default:
 		break;
+	}
+
+	// legacy cubemap (all 6 faces are required)
+	if (header.caps2 & CUBE) {
+		if ((header.caps2 & 0x0000fc00) != 0x0000fc00) {
+			std::cerr << "[DDSLoader] cubemap with missing faces is not supported" << std::endl;
+			return false;
+		}
+		if (!image.cube) {
+			image.cube = true;
+			image.arrayLayers = 6;
+		}
+	}
+	if ((header.caps2 & VOLUME) || ((header.flags & H_DEPTH) && header.depth > 1)) {
+		std::cerr << "[DDSLoader] volume texture is not supported" << std::endl;
+		return false;
+	}
+
+	if (header.width == 0) {
+		std::cerr << "[DDSLoader] input file has zero width" << std::endl;
+		return false;
+	}
+
+	image.size = { header.width, std::max<std::uint32_t>(1, header.height), 1 };
+
+	// full chain ends at 1x1, larger counts from header would repeat 1x1 levels
+	std::uint32_t fullChainLevels = 1;
+	for (auto extent = std::max(image.size.width, image.size.height); extent > 1; extent >>= 1) ++fullChainLevels;
+
+	// layout: for each layer (or face), mip chain is stored largest -> smallest
+	image.mipLevels = (header.flags & H_MIPMAP) ? std::clamp<std::uint32_t>(header.mipmapCount, 1, fullChainLevels) : 1;
+	image.subresourceOffsets.resize(static_cast<std::size_t>(image.arrayLayers) * image.mipLevels);
+
+	auto block = blockInfo(image.format);
+
+	payloadSize = 0;
+	for (std::uint32_t layer = 0; layer < image.arrayLayers; ++layer) {
+		for (std::uint32_t level = 0; level < image.mipLevels; ++level) {
+			std::size_t levelWidth = std::max<std::size_t>(1, image.size.width >> level);
+			std::size_t levelHeight = std::max<std::size_t>(1, image.size.height >> level);
+
+			image.subresourceOffsets[layer * image.mipLevels + level] = payloadSize;
+			payloadSize += ((levelWidth + block.extent - 1) / block.extent) * ((levelHeight + block.extent - 1) / block.extent) * block.size;
+		}
+	}
+
+	if (fileSize < payloadOffset + payloadSize) {
+		std::cerr << "[DDSLoader] input file is truncated" << std::endl;
+		return false;
+	}
+
+	image.data.clear();
+
+	return true;
+}
+
+bool DDSLoader::isOpaque(VkFormat format, const std::uint8_t* data, std::size_t size) {
+	switch (format) {
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		for (std::size_t offset = 0; offset + 8 <= size; offset += 8) {
+			std::uint16_t color0{}, color1{};
+			std::uint32_t indices{};
+			std::memcpy(&color0, data + offset, sizeof(std::uint16_t));
+			std::memcpy(&color1, data + offset + 2, sizeof(std::uint16_t));
+			std::memcpy(&indices, data + offset + 4, sizeof(std::uint32_t));
+
+			// 3 color mode: index 3 is transparent black
+			if (color0 > color1) continue;
+			for (std::uint32_t texel = 0; texel < 16; ++texel) {
+				if (((indices >> (texel * 2)) & 0x3) == 3) return false;
+			}
+		}
+		return true;
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+		// explicit 4 bit alpha in first 8 bytes of block
+		for (std::size_t offset = 0; offset + 16 <= size; offset += 16) {
+			for (std::size_t i = 0; i < 8; ++i) {
+				if (data[offset + i] != 0xff) return false;
+			}
+		}
+		return true;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+		for (std::size_t offset = 0; offset + 16 <= size; offset += 16) {
+			std::uint32_t alpha0 = data[offset];
+			std::uint32_t alpha1 = data[offset + 1];
+			std::uint64_t indices{};
+			std::memcpy(&indices, data + offset + 2, 6);
+
+			// decoded alpha of each 3 bit index, only 255 everywhere counts
+			for (std::uint32_t texel = 0; texel < 16; ++texel) {
+				auto index = static_cast<std::uint32_t>((indices >> (texel * 3)) & 0x7);
+				std::uint32_t alpha{};
+				if (index == 0) alpha = alpha0;
+				else if (index == 1) alpha = alpha1;
+				else if (alpha0 > alpha1) alpha = ((8 - index) * alpha0 + (index - 1) * alpha1) / 7;
+				else if (index == 6) alpha = 0;
+				else if (index == 7) alpha = 255;
+				else alpha = ((6 - index) * alpha0 + (index - 1) * alpha1) / 5;
+
+				if (alpha != 255) return false;
+			}
+		}
+		return true;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		for (std::size_t offset = 3; offset < size; offset += 4) {
+			if (data[offset] != 0xff) return false;
+		}
+		return true;
 	default:
-		std::cerr << "[DDSLoader] input file has unknown format" << std::endl;
+		// BC7 / float: alpha is not decoded here
+		return false;
+	}
+}
+
+bool DDSLoader::write(const std::filesystem::path& path, const TexImage& image) {
+	auto format = toDXGIFormat(image.format);
+	if (format == (DXGIFormat)0) {
+		std::cerr << "[DDSLoader] (" << path << ") format cannot be written as DDS" << std::endl;
 		return false;
 	}
 
-	std::size_t blockSize = (FourCC)header.fourCC == FourCC::DXT1 ? 8 : 16;
-	std::size_t blockWidth = header.width;
-	std::size_t blockHeight = header.height;
+	Header header{};
+	header.magic = 0x20534444;
+	header.size = 124;
+	header.flags = H_CAPS | H_HEIGHT | H_WIDTH | H_FORMAT | H_LINEAR | (image.mipLevels > 1 ? H_MIPMAP : 0);
+	header.height = image.size.height;
+	header.width = image.size.width;
+	header.pitchOrLinearSize = static_cast<Dword>(image.subresourceOffsets.size() > 1 ? image.subresourceOffsets[1] : image.data.size());
+	header.depth = 1;
+	header.mipmapCount = image.mipLevels;
+	header.pfSize = 32;
+	header.pfFlags = PF_FOURCC;
+	header.fourCC = (Dword)FourCC::DX10;
+	header.caps = TEXTURE | (image.mipLevels > 1 ? (COMPLEX | MIPMAP) : 0);
+	header.caps2 = image.cube ? (CUBE | 0x0000fc00) : 0;
+
+	ExtendHeader extendHeader{};
+	extendHeader.format = (Dword)format;
+	extendHeader.dimension = (Dword)DDSDimension::DIM_2D;
+	extendHeader.miscFlag = image.cube ? MISC_TEXTURECUBE : 0;
+	extendHeader.arraySize = image.cube ? image.arrayLayers / 6 : image.arrayLayers;
+	// known either way, so reader never has to scan texels
+	extendHeader.miscFlag2 = image.opaque ? ALPHA_MODE_OPAQUE : ALPHA_MODE_STRAIGHT;
+
+	auto temporaryPath = path;
+	temporaryPath += ".tmp";
+
+	{
+		std::ofstream ofs(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!ofs) {
+			std::cerr << "[DDSLoader] (" << temporaryPath << ") failed to open file" << std::endl;
+			return false;
+		}
 
-	std::size_t mainImageSize = std::max<std::size_t>(1, (blockWidth + 3) / 4) * std::max<std::size_t>(1, (blockHeight + 3) / 4) * blockSize;
-	
-	data.resize(mainImageSize);
+		ofs.write((const char*)&header, sizeof(Header));
+		ofs.write((const char*)&extendHeader, sizeof(ExtendHeader));
+		ofs.write((const char*)image.data.data(), image.data.size());
 
-	ifs.read((char*)data.data(), mainImageSize);
+		if (!ofs) {
+			std::cerr << "[DDSLoader] (" << temporaryPath << ") failed to write file" << std::endl;
+			return false;
+		}
+	}
+
+	// readers never see partially written file
+	std::error_code error{};
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error) {
+		std::cerr << "[DDSLoader] (" << path << ") failed to rename file: " << error.message() << std::endl;
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
 
 	return true;
-}
\ No newline at end of file
+}
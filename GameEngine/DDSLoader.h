@@ -2,10 +2,15 @@
 
 #include <vulkan/vulkan.h>
 
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <string_view>
+#include <vector>
+
+#include "TexImage.h"
 
 #define MAKE_FOURCC(x, y, z, w) (((w) << 24) | ((z) << 16) | ((y) << 8) | (x))
 
@@ -69,7 +74,10 @@ class DDSLoader {
 		BC4S = MAKE_FOURCC('B', 'C', '4', 'S'),
 		BC5U = MAKE_FOURCC('B', 'C', '5', 'U'),
 		BC5S = MAKE_FOURCC('B', 'C', '5', 'S'),
-
+		ATI1 = MAKE_FOURCC('A', 'T', 'I', '1'),
+		ATI2 = MAKE_FOURCC('A', 'T', 'I', '2'),
+		// D3DFMT_A16B16G16R16F
+		RGBA16F = 113,
 	};
 
 	enum CapsFlagBit {
@@ -104,6 +112,73 @@ class DDSLoader {
 		DIM_3D = 4,
 	};
 
+	enum ExtendMiscFlagBit {
+		MISC_TEXTURECUBE = 0x00000004,
+	};
+
+	// low 3 bits of miscFlag2
+	enum AlphaMode {
+		ALPHA_MODE_UNKNOWN = 0,
+		ALPHA_MODE_STRAIGHT = 1,
+		ALPHA_MODE_PREMULTIPLIED = 2,
+		ALPHA_MODE_OPAQUE = 3,
+		ALPHA_MODE_CUSTOM = 4,
+		ALPHA_MODE_MASK = 0x00000007,
+	};
+
+	// DXGI_FORMAT values used by DX10 header
+	enum class DXGIFormat {
+		R16G16B16A16_FLOAT  = 10,
+		R8G8B8A8_UNORM      = 28,
+		R8G8B8A8_UNORM_SRGB = 29,
+		BC1_UNORM           = 71,
+		BC1_UNORM_SRGB      = 72,
+		BC2_UNORM           = 74,
+		BC2_UNORM_SRGB      = 75,
+		BC3_UNORM           = 77,
+		BC3_UNORM_SRGB      = 78,
+		BC4_UNORM           = 80,
+		BC4_SNORM           = 81,
+		BC5_UNORM           = 83,
+		BC5_SNORM           = 84,
+		B8G8R8A8_UNORM      = 87,
+		B8G8R8A8_UNORM_SRGB = 91,
+		BC6H_UF16           = 95,
+		BC6H_SF16           = 96,
+		BC7_UNORM           = 98,
+		BC7_UNORM_SRGB      = 99,
+	};
+
+	// size of one block (4x4 texels for BCn, 1 texel otherwise)
+	struct BlockInfo {
+		std::uint32_t extent;
+		std::size_t size;
+	};
+
+	static VkFormat toVkFormat(DXGIFormat);
+	static DXGIFormat toDXGIFormat(VkFormat);
+	static BlockInfo blockInfo(VkFormat);
+
+	// set by parseHeader: no DX10 alpha mode (legacy header or ALPHA_MODE_UNKNOWN), texels decide TexImage::opaque
+	bool alphaModeUnknown_ = false;
+
 public:
-	bool load(const std::filesystem::path& path, std::uint32_t& width, std::uint32_t& height, VkFormat& format, std::vector<std::uint8_t>& data);
+	// largest header (magic + header + DX10 header), enough to call parseHeader()
+	static constexpr std::size_t maxHeaderSize = sizeof(Header) + sizeof(ExtendHeader);
+
+	bool load(const std::filesystem::path& path, TexImage& image);
+	// parse DDS file already in memory
+	bool load(const std::vector<std::uint8_t>& fileData, TexImage& image);
+
+	// parse headers only (image.data is left empty)
+	// subresource offsets are relative to payload, which starts at payloadOffset in file and is payloadSize bytes long
+	bool parseHeader(const std::uint8_t* headerData, std::size_t headerSize, std::size_t fileSize, TexImage& image, std::size_t& payloadOffset, std::size_t& payloadSize);
+
+	// true -> image.opaque has to come from isOpaque() over payload
+	bool isAlphaModeUnknown() const { return alphaModeUnknown_; }
+	// every texel of data (whole blocks of format) has alpha 1; false for formats it cannot decode
+	static bool isOpaque(VkFormat format, const std::uint8_t* data, std::size_t size);
+
+	// write image as DX10 DDS (written to temporary file, then renamed)
+	bool write(const std::filesystem::path& path, const TexImage& image);
 };
\ No newline at end of file
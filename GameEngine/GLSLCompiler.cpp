@@ -30,63 +30,154 @@ bool GLSLCompiler::compile(const std::filesystem::path& path) {
 		return false;
 	}
 
-	// check time stamp
-	{
-		std::filesystem::file_time_type lastCompiledTime{};
+	std::ifstream shaderFile(path);
+	if (shaderFile.fail()) {
+		std::cerr << "[GLSLCompiler] (" << path << ") failed to open file" << std::endl;
+		return false;
+	}
+	std::string shaderSource(std::istreambuf_iterator<char>(shaderFile), {});
 
-		auto timeStampPath = path.stem();
-		timeStampPath.concat(".stamp");
+	if (!compiler_) compiler_ = std::make_unique<shaderc::Compiler>();
 
-		std::ifstream timeStampFile(timeStampPath);
-		if (timeStampFile) {
-			timeStampFile.read((char*)&lastCompiledTime, sizeof(std::filesystem::file_time_type));
+	shaderc::CompileOptions options{};
+	options.SetOptimizationLevel(options_.optimizationLevel);
+	if (options_.generateDebugInfo) options.SetGenerateDebugInfo();
+	options.SetIncluder(std::make_unique<Includer>());
 
-			// compare: last compile time > last update time?
-			// -> no need to compile
-			if (lastCompiledTime > std::filesystem::last_write_time(path)) {
-				std::cerr << "[GLSLCompiler] (" << path << ") file has no changes from last compilation -> compilation skipped" << std::endl;
-				return true;
-			}
-		}
+	// key is taken from preprocessor output, so it covers exactly what compiler sees
+	auto preprocessed = compiler_->PreprocessGlsl(shaderSource, shaderKind, path.generic_string().c_str(), options);
+	if (preprocessed.GetCompilationStatus() != shaderc_compilation_status_success) {
+		std::cerr << "[GLSLCompiler] GLSL preprocessing failed:" << std::endl << preprocessed.GetErrorMessage() << std::endl;
+		return false;
 	}
+	std::string preprocessedSource(preprocessed.cbegin(), preprocessed.cend());
 
+	std::stringstream cacheName{};
+	cacheName << std::hex << std::setw(16) << std::setfill('0') << cacheKey(preprocessedSource, shaderKind) << ".spv";
+	auto cachedPath = cacheDirectory_ / cacheName.str();
+
+	std::vector<std::uint32_t> shaderCode{};
+	if (loadCached(cachedPath, shaderCode)) {
+		std::cerr << "[GLSLCompiler] (" << path << ") found in shader cache -> compilation skipped" << std::endl;
+	}
 	// shader compile
-	{
+	else {
 		std::cerr << "[GLSLCompiler] (" << path << ") compiling GLSL file" << std::endl;
 
-		shaderc::Compiler compiler{};
-		shaderc::CompileOptions options{};
-
-		std::ifstream shaderFile(path);
-		if (shaderFile.fail()) {
-			std::cerr << "[GLSLCompiler] (" << path << ") failed to open file" << std::endl;
-			return false;
-		}
-
-		std::string shaderSource{ std::istreambuf_iterator<char>(shaderFile), std::istreambuf_iterator<char>() };
-
-		auto compiled = compiler.CompileGlslToSpv(shaderSource, shaderKind, path.generic_string().c_str());
+		// original source (not preprocessed one), so messages point into real files
+		auto compiled = compiler_->CompileGlslToSpv(shaderSource, shaderKind, path.generic_string().c_str(), options);
 		if (compiled.GetCompilationStatus() != shaderc_compilation_status_success) {
 			std::cerr << "[GLSLCompiler] GLSL compilation failed:" << std::endl << compiled.GetErrorMessage() << std::endl;
 			return false;
 		}
 
-		auto shaderSPIRVPath = path.stem();
-		shaderSPIRVPath.concat(".spv");
+		shaderCode.assign(compiled.cbegin(), compiled.cend());
+		// failure only costs compilation next time
+		storeCached(cachedPath, shaderCode);
+	}
+
+	auto shaderSPIRVPath = path;
+	shaderSPIRVPath.replace_extension(".spv");
+
+	std::ofstream shaderSPIRV(shaderSPIRVPath, std::ios::out | std::ios::binary | std::ios::trunc);
+	shaderSPIRV.write((const char*)shaderCode.data(), sizeof(std::uint32_t) * shaderCode.size());
+	if (!shaderSPIRV) {
+		std::cerr << "[GLSLCompiler] (" << shaderSPIRVPath << ") failed to write file" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+shaderc_include_result* GLSLCompiler::Includer::GetInclude(const char* requested, shaderc_include_type, const char* requesting, std::size_t depth) {
+	auto include = new Include{};
+	auto path = std::filesystem::path(requesting).parent_path() / requested;
+
+	// empty source name tells shaderc include failed, content is error message then
+	std::ifstream ifs(path);
+	if (depth > maxIncludeDepth) {
+		include->content = "includes are nested too deep (cyclic include?)";
+	}
+	else if (ifs.fail()) {
+		include->content = "failed to open " + path.generic_string();
+	}
+	else {
+		include->name = path.generic_string();
+		include->content.assign(std::istreambuf_iterator<char>(ifs), {});
+	}
+
+	include->result = { include->name.data(), include->name.size(), include->content.data(), include->content.size(), include };
+	return &include->result;
+}
+
+void GLSLCompiler::Includer::ReleaseInclude(shaderc_include_result* result) {
+	delete static_cast<Include*>(result->user_data);
+}
+
+std::uint64_t GLSLCompiler::cacheKey(const std::string& source, shaderc_shader_kind shaderKind) const {
+	// SPIR-V version shaderc emits stands for compiler version (no library version in its API)
+	unsigned int spirvVersion = 0, spirvRevision = 0;
+	shaderc_get_spv_version(&spirvVersion, &spirvRevision);
+
+	auto key = hashContent((const std::uint8_t*)source.data(), source.size());
+	key = hashContent((const std::uint8_t*)&shaderKind, sizeof(shaderKind), key);
+	key = hashContent((const std::uint8_t*)&options_.optimizationLevel, sizeof(options_.optimizationLevel), key);
+	key = hashContent((const std::uint8_t*)&options_.generateDebugInfo, sizeof(options_.generateDebugInfo), key);
+	key = hashContent((const std::uint8_t*)&spirvVersion, sizeof(spirvVersion), key);
+	key = hashContent((const std::uint8_t*)&spirvRevision, sizeof(spirvRevision), key);
+	key = hashContent((const std::uint8_t*)&cacheVersion, sizeof(cacheVersion), key);
+
+	return key;
+}
+
+bool GLSLCompiler::loadCached(const std::filesystem::path& path, std::vector<std::uint32_t>& code) const {
+	std::error_code error{};
+	auto fileSize = std::filesystem::file_size(path, error);
+	// miss
+	if (error) return false;
+
+	if (fileSize == 0 || fileSize % sizeof(std::uint32_t) != 0) {
+		std::cerr << "[GLSLCompiler] (" << path << ") damaged cache entry, compiling again" << std::endl;
+		return false;
+	}
 
-		std::ofstream shaderSPIRV(shaderSPIRVPath, std::ios::out | std::ios::binary);
-		for (const auto value : compiled) shaderSPIRV.write(reinterpret_cast<const char*>(&value), sizeof(std::uint32_t));
+	std::ifstream ifs(path, std::ios::in | std::ios::binary);
+	code.resize(static_cast<std::size_t>(fileSize / sizeof(std::uint32_t)));
+	ifs.read((char*)code.data(), fileSize);
+
+	// SPIR-V magic number
+	if (!ifs || code[0] != 0x07230203) {
+		std::cerr << "[GLSLCompiler] (" << path << ") damaged cache entry, compiling again" << std::endl;
+		code.clear();
+		return false;
 	}
 
-	// save time stamp
+	return true;
+}
+
+bool GLSLCompiler::storeCached(const std::filesystem::path& path, const std::vector<std::uint32_t>& code) const {
+	std::error_code error{};
+	std::filesystem::create_directories(path.parent_path(), error);
+
+	auto temporaryPath = path;
+	temporaryPath += ".tmp";
+
 	{
-		auto timeStampPath = path.stem();
-		timeStampPath.concat(".stamp");
+		std::ofstream ofs(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		ofs.write((const char*)code.data(), sizeof(std::uint32_t) * code.size());
+		if (!ofs) {
+			std::cerr << "[GLSLCompiler] (" << temporaryPath << ") failed to write file" << std::endl;
+			return false;
+		}
+	}
 
-		std::ofstream timeStamp(timeStampPath, std::ios::out | std::ios::binary);
-		auto compiledTime = std::filesystem::file_time_type::clock::now();
-		timeStamp.write((const char*)&compiledTime, sizeof(std::filesystem::file_time_type));
+	// other process compiling same shader writes same content
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error) {
+		std::cerr << "[GLSLCompiler] (" << path << ") failed to rename file: " << error.message() << std::endl;
+		std::filesystem::remove(temporaryPath, error);
+		return false;
 	}
 
 	return true;
-}
\ No newline at end of file
+}
@@ -2,12 +2,65 @@
 
 #include <shaderc/shaderc.hpp>
 
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
 
+#include "Hash.h"
+
+// GLSL -> SPIR-V ([name].[type].glsl -> [name].[type].spv next to source)
+// compiled SPIR-V is cached by content: [cache directory]/[key].spv
+// - key: hash of preprocessed source (includes expanded, comments and inactive #if blocks dropped), stage, options and shaderc SPIR-V version
+// - hit -> blob is copied to output, only shaderc preprocessor runs
+// - any change of included file, options or compiler -> other key, compiled again
 class GLSLCompiler {
+public:
+	// part of cache key, defaults are shaderc's
+	struct Options {
+		shaderc_optimization_level optimizationLevel = shaderc_optimization_level_zero;
+		bool generateDebugInfo = false;
+	};
+
+private:
+	// bumped when key layout or expansion rules change
+	static constexpr std::uint32_t cacheVersion = 2;
+	// nested includes deeper than this are treated as cycle
+	static constexpr std::uint32_t maxIncludeDepth = 32;
+
+	// #include "..." relative to including file, driven by shaderc preprocessor
+	// (so errors report real file and line, and only active includes are read)
+	class Includer : public shaderc::CompileOptions::IncluderInterface {
+		struct Include {
+			std::string name;
+			std::string content;
+			shaderc_include_result result;
+		};
+
+	public:
+		shaderc_include_result* GetInclude(const char* requested, shaderc_include_type, const char* requesting, std::size_t depth) override;
+		void ReleaseInclude(shaderc_include_result*) override;
+	};
+
+	std::filesystem::path cacheDirectory_;
+	Options options_;
+	// created on first miss, shared by following compiles
+	std::unique_ptr<shaderc::Compiler> compiler_;
+
+	std::uint64_t cacheKey(const std::string& source, shaderc_shader_kind) const;
+	bool loadCached(const std::filesystem::path&, std::vector<std::uint32_t>&) const;
+	bool storeCached(const std::filesystem::path&, const std::vector<std::uint32_t>&) const;
 
 public:
+	explicit GLSLCompiler(const std::filesystem::path& cacheDirectory = "cache/shaders") : cacheDirectory_(cacheDirectory) {}
+
+	void setOptions(const Options& options) { options_ = options; }
+
 	bool compile(const std::filesystem::path&);
 };
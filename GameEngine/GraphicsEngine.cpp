@@ -10,7 +10,7 @@ void GraphicsEngine::createInstance(const char* applicationName, std::uint32_t a
 	appInfo.applicationVersion = applicationVersion;
 	appInfo.pEngineName = engineName.data();
 	appInfo.engineVersion = engineVersion;
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	appInfo.apiVersion = VK_API_VERSION_1_2;
 
 	VkInstanceCreateInfo instInfo{};
 	instInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -51,6 +51,18 @@ void GraphicsEngine::getPhysicalDevice() {
 
 	vkGetPhysicalDeviceProperties(physicalDevice_, &properties_);
 	vkGetPhysicalDeviceMemoryProperties(physicalDevice_, &memoryProperties_);
+	vkGetPhysicalDeviceFeatures(physicalDevice_, &supportedFeatures_);
+
+	supportedFeatures12_ = VkPhysicalDeviceVulkan12Features{};
+	supportedFeatures12_.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	if (properties_.apiVersion >= VK_API_VERSION_1_2) {
+		VkPhysicalDeviceFeatures2 features{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &supportedFeatures12_;
+
+		vkGetPhysicalDeviceFeatures2(physicalDevice_, &features);
+		supportedFeatures12_.pNext = nullptr;
+	}
 }
 
 void GraphicsEngine::getQueueFamilyIndex() {
@@ -74,6 +86,24 @@ void GraphicsEngine::getQueueFamilyIndex() {
 	}
 
 	queueFamilyIndex_ = queueFamilyIndex;
+
+	// transfer only family (DMA engine of discrete GPUs) runs uploads beside rendering
+	transferQueueFamilyIndex_ = queueFamilyIndex_;
+	for (std::uint32_t i = 0; i < numQueueFamilyProperties; ++i) {
+		auto flags = queueFamilyProperties[i].queueFlags;
+		if ((flags & VK_QUEUE_TRANSFER_BIT) != 0 && (flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0) {
+			transferQueueFamilyIndex_ = i;
+			break;
+		}
+	}
+}
+
+bool GraphicsEngine::isBindlessSupported() {
+	// descriptor indexing subset used by bindless.frag
+	return supportedFeatures12_.runtimeDescriptorArray == VK_TRUE
+		&& supportedFeatures12_.descriptorBindingPartiallyBound == VK_TRUE
+		&& supportedFeatures12_.descriptorBindingVariableDescriptorCount == VK_TRUE
+		&& supportedFeatures12_.shaderSampledImageArrayNonUniformIndexing == VK_TRUE;
 }
 
 void GraphicsEngine::createDevice(const std::vector<const char*>& extensions, const std::vector<const char*>& layers) {
@@ -85,27 +115,70 @@ void GraphicsEngine::createDevice(const std::vector<const char*>& extensions, co
 	queueInfo.queueFamilyIndex = queueFamilyIndex_;
 	queueInfo.pQueuePriorities = &queuePriority;
 
+	std::vector<VkDeviceQueueCreateInfo> queueInfos{ queueInfo };
+	if (transferQueueFamilyIndex_ != queueFamilyIndex_) {
+		queueInfo.queueFamilyIndex = transferQueueFamilyIndex_;
+		queueInfos.push_back(queueInfo);
+	}
+
 	VkDeviceCreateInfo deviceInfo{};
 	deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	deviceInfo.queueCreateInfoCount = 1;
-	deviceInfo.pQueueCreateInfos = &queueInfo;
+	deviceInfo.queueCreateInfoCount = static_cast<std::uint32_t>(queueInfos.size());
+	deviceInfo.pQueueCreateInfos = queueInfos.data();
 	deviceInfo.enabledExtensionCount = static_cast<std::uint32_t>(extensions.size());
 	deviceInfo.ppEnabledExtensionNames = extensions.data();
 	deviceInfo.enabledLayerCount = static_cast<std::uint32_t>(layers.size());
 	deviceInfo.ppEnabledLayerNames = layers.data();
 	deviceInfo.pEnabledFeatures = nullptr;
 
+	VkPhysicalDeviceVulkan12Features features12{};
+	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	if (bindless_) {
+		features12.runtimeDescriptorArray = VK_TRUE;
+		features12.descriptorBindingPartiallyBound = VK_TRUE;
+		features12.descriptorBindingVariableDescriptorCount = VK_TRUE;
+		features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	}
+	features12.drawIndirectCount = drawIndirectCount_ ? VK_TRUE : VK_FALSE;
+
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &features12;
+	if (gpuDriven_) {
+		// all draws in one call, firstInstance selects draw record
+		features.features.multiDrawIndirect = VK_TRUE;
+		features.features.drawIndirectFirstInstance = VK_TRUE;
+	}
+
+	// 1.2 feature structure is only known to 1.2 devices
+	if (properties_.apiVersion >= VK_API_VERSION_1_2) {
+		deviceInfo.pNext = &features;
+	}
+
 	VK_CHECK(vkCreateDevice(physicalDevice_, &deviceInfo, allocator, &device_));
 }
 
 void GraphicsEngine::getDeviceQueue() {
 	vkGetDeviceQueue(device_, queueFamilyIndex_, 0, &deviceQueue_);
+	vkGetDeviceQueue(device_, transferQueueFamilyIndex_, 0, &transferQueue_);
+}
+
+VkExtent2D GraphicsEngine::surfaceExtent(const VkSurfaceCapabilitiesKHR& surfaceCapabilities) {
+	// UINT32_MAX -> surface size is defined by swapchain, follow window
+	if (surfaceCapabilities.currentExtent.width != UINT32_MAX) return surfaceCapabilities.currentExtent;
+
+	int width{}, height{};
+	SDL_Vulkan_GetDrawableSize(window_, &width, &height);
+
+	VkExtent2D extent{};
+	extent.width = std::clamp(static_cast<std::uint32_t>(width), surfaceCapabilities.minImageExtent.width, surfaceCapabilities.maxImageExtent.width);
+	extent.height = std::clamp(static_cast<std::uint32_t>(height), surfaceCapabilities.minImageExtent.height, surfaceCapabilities.maxImageExtent.height);
+	return extent;
 }
 
 void GraphicsEngine::createSwapchain() {
 	constexpr VkColorSpaceKHR desiredColorSpace = VK_COLORSPACE_SRGB_NONLINEAR_KHR;
 	constexpr VkSurfaceFormatKHR desiredSurfaceFormat = { desiredFormat, desiredColorSpace };
-	constexpr VkPresentModeKHR desiredPresentMode = VK_PRESENT_MODE_FIFO_KHR;
 
 	VkBool32 surfaceSupported{};
 	vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice_, queueFamilyIndex_, surface_, &surfaceSupported);
@@ -130,15 +203,25 @@ void GraphicsEngine::createSwapchain() {
 	vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice_, surface_, &numPresentModes, nullptr);
 	std::vector<VkPresentModeKHR> presentModes(numPresentModes);
 	vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice_, surface_, &numPresentModes, presentModes.data());
-	if (std::find(presentModes.begin(), presentModes.end(), desiredPresentMode) == presentModes.end()) {
-		std::cerr << "[createSwapchain] physical device does not support desired present mode" << std::endl;
-		std::exit(EXIT_FAILURE);
+	auto presentMode = presentSettings_.presentMode;
+	if (std::find(presentModes.begin(), presentModes.end(), presentMode) == presentModes.end()) {
+		std::cerr << "[createSwapchain] present mode " << presentMode << " is not supported, using FIFO" << std::endl;
+		presentMode = VK_PRESENT_MODE_FIFO_KHR;
 	}
 
 	VkSwapchainCreateInfoKHR swapchainInfo{};
 	swapchainInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
 	swapchainInfo.surface = surface_;
-	swapchainInfo.minImageCount = 2;
+	// one image more than frames in flight, so recording does not wait for display
+	// low latency: double buffered, so image release marks the flip of previous frame
+	auto imageCount = presentSettings_.imageCount;
+	if (imageCount == 0) imageCount = presentSettings_.lowLatency ? 2 : framesInFlight_ + 1;
+	imageCount = std::max(surfaceCapabilities.minImageCount, imageCount);
+	if (surfaceCapabilities.maxImageCount != 0) imageCount = std::min(imageCount, surfaceCapabilities.maxImageCount);
+
+	imageSize_ = surfaceExtent(surfaceCapabilities);
+
+	swapchainInfo.minImageCount = imageCount;
 	swapchainInfo.imageFormat = desiredFormat;
 	swapchainInfo.imageColorSpace = desiredColorSpace;
 	swapchainInfo.imageExtent = imageSize_;
@@ -147,12 +230,81 @@ void GraphicsEngine::createSwapchain() {
 	swapchainInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	swapchainInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	swapchainInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
-	swapchainInfo.presentMode = desiredPresentMode;
+	swapchainInfo.presentMode = presentMode;
 	swapchainInfo.clipped = VK_TRUE;
+	// images of previous swapchain that are still queued for present stay valid until it is destroyed
+	swapchainInfo.oldSwapchain = swapchain_;
 
 	VK_CHECK(vkCreateSwapchainKHR(device_, &swapchainInfo, allocator, &swapchain_));
 }
 
+bool GraphicsEngine::recreateSwapchain() {
+	VkSurfaceCapabilitiesKHR surfaceCapabilities{};
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice_, surface_, &surfaceCapabilities);
+
+	auto extent = surfaceExtent(surfaceCapabilities);
+	if (extent.width == 0 || extent.height == 0) return false;
+
+	// back to back recreation (out of date again before any frame is submitted) never retires pyramids
+	// -> free them after idle once current + new one would not fit in pool
+	auto retiredPyramidCount = std::count_if(retiredSwapchains_.begin(), retiredSwapchains_.end(), [](const RetiredSwapchain& retired) { return retired.hiZPyramid.cullDescriptorSet != VK_NULL_HANDLE; });
+	if (retiredPyramidCount + 2 > hiZPyramidCapacity) {
+		VK_CHECK(vkDeviceWaitIdle(device_));
+		for (auto& retired : retiredSwapchains_) {
+			if (retired.hiZPyramid.cullDescriptorSet == VK_NULL_HANDLE) continue;
+			destroyHiZPyramid(retired.hiZPyramid);
+			retired.hiZPyramid = HiZPyramid{};
+		}
+	}
+
+	// frames already submitted still reference current resources, they go away after those frames retire
+	RetiredSwapchain retired{};
+	retired.frameSerial = frameSerial_;
+	retired.swapchain = swapchain_;
+	retired.imageViews = std::move(defaultImageViews_);
+	retired.renderFinishedSemaphores = std::move(renderFinishedSemaphores_);
+	retired.renderGraph = std::move(renderGraph_);
+	retired.hiZPyramid = std::move(hiZPyramid_);
+	retiredSwapchains_.push_back(std::move(retired));
+
+	defaultImageViews_.clear();
+	renderFinishedSemaphores_.clear();
+
+	// pipelines do not depend on size (viewport / scissor are dynamic, rebuilt render passes stay compatible)
+	createSwapchain();
+	createDefaultImages();
+	createDefaultImageViews();
+	createRenderFinishedSemaphores();
+	buildRenderGraph();
+	if (gpuDriven_) createHiZPyramid();
+
+	swapchainOutdated_ = false;
+
+	std::cout << "[recreateSwapchain] " << imageSize_.width << "x" << imageSize_.height << ", " << defaultImages_.size() << " images" << std::endl;
+
+	return true;
+}
+
+void GraphicsEngine::destroyRetiredSwapchains() {
+	auto retired = retiredSwapchains_.begin();
+	while (retired != retiredSwapchains_.end()) {
+		if (retired->frameSerial > completedFrameSerial_) {
+			++retired;
+			continue;
+		}
+
+		for (auto imageView : retired->imageViews) vkDestroyImageView(device_, imageView, allocator);
+		for (auto semaphore : retired->renderFinishedSemaphores) vkDestroySemaphore(device_, semaphore, allocator);
+		// pyramid views first, its image belongs to graph
+		if (retired->hiZPyramid.cullDescriptorSet != VK_NULL_HANDLE) destroyHiZPyramid(retired->hiZPyramid);
+		retired->renderGraph.destroy();
+		// also releases swapchain images
+		vkDestroySwapchainKHR(device_, retired->swapchain, allocator);
+
+		retired = retiredSwapchains_.erase(retired);
+	}
+}
+
 void GraphicsEngine::createDefaultImages() {
 	std::uint32_t numImages{};
 	VK_CHECK(vkGetSwapchainImagesKHR(device_, swapchain_, &numImages, nullptr));
@@ -186,159 +338,81 @@ void GraphicsEngine::createDefaultImageViews() {
 	defaultImageViews_ = std::move(imageViews);
 }
 
-void GraphicsEngine::createDefaultDepthImage() {
+void GraphicsEngine::buildRenderGraph() {
 	constexpr VkFormatFeatureFlags desiredFeatures = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
 
 	VkFormatProperties formatProperties{};
 	vkGetPhysicalDeviceFormatProperties(physicalDevice_, desiredDepthFormat, &formatProperties);
 
 	if ((formatProperties.optimalTilingFeatures & desiredFeatures) != desiredFeatures) {
-		std::cerr << "[createDefaultDepthImage] failed to find desired format for depth image" << std::endl;
+		std::cerr << "[buildRenderGraph] failed to find desired format for depth image" << std::endl;
 		std::exit(EXIT_FAILURE);
 	}
 
-	VkImageCreateInfo imageInfo{};
-	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	imageInfo.imageType = VK_IMAGE_TYPE_2D;
-	imageInfo.extent.width = imageSize_.width;
-	imageInfo.extent.height = imageSize_.height;
-	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = 1;
-	imageInfo.arrayLayers = 1;
-	imageInfo.format = desiredDepthFormat;
-	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-	
-	VK_CHECK(vkCreateImage(device_, &imageInfo, allocator, &defaultDepthImage_));
+	using Usage = RenderGraph::Usage;
+	using PassType = RenderGraph::PassType;
 
-	VkMemoryRequirements memoryRequirements{};
-	vkGetImageMemoryRequirements(device_, defaultDepthImage_, &memoryRequirements);
-	uint32_t memoryTypeIndex = UINT32_MAX;
-	for (std::uint32_t i = 0; i < memoryProperties_.memoryTypeCount; ++i) {
-		if ((memoryProperties_.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0) {
-			memoryTypeIndex = i;
-			break;
+	auto& graph = renderGraph_;
+	auto& nodes = renderGraphNodes_;
+	graph = RenderGraph{};
+	nodes = RenderGraphNodes{};
+
+	VkClearColorValue clearColor = { 0.8f, 0.8f, 0.8f, 1.0f };
+
+	// variant of swapchain image = currentFrameIndex_
+	nodes.color = graph.importImage("swapchain image", { desiredFormat, imageSize_, 1 }, defaultImages_, defaultImageViews_);
+	graph.present(nodes.color);
+	nodes.depth = graph.createImage("depth", { desiredDepthFormat, imageSize_, 1 });
+
+	if (!gpuDriven_) {
+		// depth prepass, opaque and transparent draws share both attachments, so they stay in one render pass
+		nodes.draw = graph.addPass("forward", PassType::Graphics);
+		graph.attachColor(nodes.draw, nodes.color, VK_ATTACHMENT_LOAD_OP_CLEAR, clearColor);
+		graph.attachDepth(nodes.draw, nodes.depth, VK_ATTACHMENT_LOAD_OP_CLEAR);
+	}
+	else {
+		// without occlusion culling cull.comp still declares pyramid, but never samples it -> 1 texel stands in
+		auto hiZLevels = std::min(static_cast<std::uint32_t>(std::floor(std::log2(std::max(imageSize_.width, imageSize_.height)))) + 1, maxHiZLevels);
+		auto hiZSize = occlusionCulling_ ? imageSize_ : VkExtent2D{ 1, 1 };
+		nodes.hiZ = graph.createImage("hi-z", { VK_FORMAT_R32_SFLOAT, hiZSize, occlusionCulling_ ? hiZLevels : 1 });
+		nodes.indirectDraws = graph.importBuffer("indirect draws", indirectDrawBuffer_.buffer);
+		nodes.visibility = graph.importBuffer("visibility", visibilityBuffer_.buffer);
+		// read by next frame's early cull pass
+		graph.markOutput(nodes.visibility);
+
+		// pyramid is bound to every cull dispatch (only late phase samples it)
+		nodes.earlyCull = graph.addPass(occlusionCulling_ ? "early cull" : "cull", PassType::Compute);
+		graph.read(nodes.earlyCull, nodes.visibility, Usage::StorageRead);
+		graph.read(nodes.earlyCull, nodes.hiZ, Usage::StorageRead);
+		graph.write(nodes.earlyCull, nodes.indirectDraws, Usage::StorageWrite);
+
+		nodes.draw = graph.addPass(occlusionCulling_ ? "early draw" : "draw", PassType::Graphics);
+		graph.read(nodes.draw, nodes.indirectDraws, Usage::IndirectRead);
+		graph.attachColor(nodes.draw, nodes.color, VK_ATTACHMENT_LOAD_OP_CLEAR, clearColor);
+		graph.attachDepth(nodes.draw, nodes.depth, VK_ATTACHMENT_LOAD_OP_CLEAR);
+
+		if (occlusionCulling_) {
+			// last frame's visible set -> Hi-Z of its depth -> draws that became visible
+			nodes.hiZBuild = graph.addPass("hi-z build", PassType::Compute);
+			graph.read(nodes.hiZBuild, nodes.depth, Usage::DepthRead);
+			graph.write(nodes.hiZBuild, nodes.hiZ, Usage::StorageWrite);
+
+			nodes.lateCull = graph.addPass("late cull", PassType::Compute);
+			graph.read(nodes.lateCull, nodes.hiZ, Usage::StorageRead);
+			graph.write(nodes.lateCull, nodes.visibility, Usage::StorageWrite);
+			graph.write(nodes.lateCull, nodes.indirectDraws, Usage::StorageWrite);
+
+			nodes.lateDraw = graph.addPass("late draw", PassType::Graphics);
+			graph.read(nodes.lateDraw, nodes.indirectDraws, Usage::IndirectRead);
+			graph.attachColor(nodes.lateDraw, nodes.color, VK_ATTACHMENT_LOAD_OP_LOAD);
+			graph.attachDepth(nodes.lateDraw, nodes.depth, VK_ATTACHMENT_LOAD_OP_LOAD);
 		}
 	}
-	if (memoryTypeIndex == UINT32_MAX) {
-		std::cerr << "[createDefaultDepthImage] failed to find memory for depth buffer" << std::endl;
+
+	if (!graph.compile(device_, memoryAllocator_)) {
+		std::cerr << "[buildRenderGraph] failed to compile render graph" << std::endl;
 		std::exit(EXIT_FAILURE);
 	}
-
-	VkMemoryAllocateInfo allocateInfo{};
-	allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocateInfo.allocationSize = memoryRequirements.size;
-	allocateInfo.memoryTypeIndex = memoryTypeIndex;
-
-	VK_CHECK(vkAllocateMemory(device_, &allocateInfo, allocator, &defaultDepthImageMemory_));
-	VK_CHECK(vkBindImageMemory(device_, defaultDepthImage_, defaultDepthImageMemory_, 0));
-}
-
-void GraphicsEngine::createDefaultDepthImageView() {
-	VkImageViewCreateInfo imageViewInfo{};
-	imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	imageViewInfo.image = defaultDepthImage_;
-	imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	imageViewInfo.format = VK_FORMAT_D32_SFLOAT;
-	imageViewInfo.components = {
-		VK_COMPONENT_SWIZZLE_R,
-		VK_COMPONENT_SWIZZLE_G,
-		VK_COMPONENT_SWIZZLE_B,
-		VK_COMPONENT_SWIZZLE_A,
-	};
-	imageViewInfo.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
-
-	VK_CHECK(vkCreateImageView(device_, &imageViewInfo, allocator, &defaultDepthImageView_));
-}
-
-void GraphicsEngine::createDefaultRenderPass() {
-	VkAttachmentDescription colorAttachmentDesc{};
-	colorAttachmentDesc.format = desiredFormat;
-	colorAttachmentDesc.samples = VK_SAMPLE_COUNT_1_BIT;
-	colorAttachmentDesc.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	//colorAttachmentDesc.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-	colorAttachmentDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	colorAttachmentDesc.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	colorAttachmentDesc.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-	VkAttachmentDescription depthAttachmentDesc{};
-	depthAttachmentDesc.format = desiredDepthFormat;
-	depthAttachmentDesc.samples = VK_SAMPLE_COUNT_1_BIT;
-	depthAttachmentDesc.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachmentDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	depthAttachmentDesc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	depthAttachmentDesc.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-	std::array<VkAttachmentDescription, 2> attachmentDesc{ colorAttachmentDesc, depthAttachmentDesc };
-
-	VkAttachmentReference colorAttachmentRef{};
-	colorAttachmentRef.attachment = 0;
-	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkAttachmentReference depthAttachmentRef{};
-	depthAttachmentRef.attachment = 1;
-	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-	VkSubpassDescription subpassDesc{};
-	subpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpassDesc.colorAttachmentCount = 1;
-	subpassDesc.pColorAttachments = &colorAttachmentRef;
-	subpassDesc.pDepthStencilAttachment = &depthAttachmentRef;
-
-	VkSubpassDependency colorDependency{};
-	colorDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	colorDependency.dstSubpass = 0;
-	colorDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	colorDependency.srcAccessMask = 0;
-	colorDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	colorDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-	VkSubpassDependency depthDependency{};
-	depthDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	depthDependency.dstSubpass = 0;
-	depthDependency.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-	depthDependency.srcAccessMask = 0;
-	depthDependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-	depthDependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-	std::array<VkSubpassDependency, 2> dependencies{ colorDependency, depthDependency };
-
-	VkRenderPassCreateInfo renderPassInfo{};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.attachmentCount = static_cast<std::uint32_t>(attachmentDesc.size());
-	renderPassInfo.pAttachments = attachmentDesc.data();
-	renderPassInfo.subpassCount = 1;
-	renderPassInfo.pSubpasses = &subpassDesc;
-	renderPassInfo.dependencyCount = static_cast<std::uint32_t>(dependencies.size());
-	renderPassInfo.pDependencies = dependencies.data();
-
-	VK_CHECK(vkCreateRenderPass(device_, &renderPassInfo, allocator, &defaultRenderPass_));
-}
-
-void GraphicsEngine::createDefaultFramebuffers() {
-	std::vector<VkFramebuffer> framebuffers(defaultImageViews_.size());
-
-	for (auto i = 0; i < framebuffers.size(); ++i) {
-		std::array<VkImageView, 2> attachmentViews{};
-		attachmentViews[0] = defaultImageViews_[i];
-		attachmentViews[1] = defaultDepthImageView_;
-
-		VkFramebufferCreateInfo framebufferInfo{};
-		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebufferInfo.renderPass = defaultRenderPass_;
-		framebufferInfo.attachmentCount = static_cast<std::uint32_t>(attachmentViews.size());
-		framebufferInfo.pAttachments = attachmentViews.data();
-		framebufferInfo.width = imageSize_.width;
-		framebufferInfo.height = imageSize_.height;
-		framebufferInfo.layers = 1;
-
-		VK_CHECK(vkCreateFramebuffer(device_, &framebufferInfo, allocator, &framebuffers[i]));
-	}
-
-	defaultFramebuffers_ = std::move(framebuffers);
 }
 
 void GraphicsEngine::createBuffer(std::size_t bufferSize, VkBufferUsageFlags usage, VkBuffer& buffer) {
@@ -352,17 +426,17 @@ void GraphicsEngine::createBuffer(std::size_t bufferSize, VkBufferUsageFlags usa
 	VK_CHECK(vkCreateBuffer(device_, &bufferInfo, allocator, &buffer));
 }
 
-void GraphicsEngine::createImage2D(VkFormat format, const VkExtent3D& imageSize, VkImageUsageFlags usage, VkSampleCountFlagBits sampleCount, VkImage& image) {
+void GraphicsEngine::createImage2D(VkFormat format, const VkExtent3D& imageSize, std::uint32_t mipLevels, std::uint32_t arrayLayers, VkImageCreateFlags flags, VkImageUsageFlags usage, VkSampleCountFlagBits sampleCount, VkImage& image) {
 
 	VkImageCreateInfo imageInfo{};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.flags = flags;
 	imageInfo.imageType = VK_IMAGE_TYPE_2D;
 	imageInfo.extent = imageSize;
-	imageInfo.mipLevels = 1;
-	imageInfo.arrayLayers = 1;
+	imageInfo.mipLevels = mipLevels;
+	imageInfo.arrayLayers = arrayLayers;
 	imageInfo.format = format;
-	// TODO: use VK_IMAGE_TILING_OPTIMAL (staging buffer needed)
-	imageInfo.tiling = VK_IMAGE_TILING_LINEAR;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	imageInfo.usage = usage;
 	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -371,12 +445,12 @@ void GraphicsEngine::createImage2D(VkFormat format, const VkExtent3D& imageSize,
 	VK_CHECK(vkCreateImage(device_, &imageInfo, allocator, &image));
 }
 
-void GraphicsEngine::createImageView2D(const VkImage & image, VkFormat format, const VkImageSubresourceRange & subresorceRange, VkImageView & imageView) {
+void GraphicsEngine::createImageView2D(const VkImage & image, VkImageViewType viewType, VkFormat format, const VkImageSubresourceRange & subresorceRange, VkImageView & imageView) {
 
 	VkImageViewCreateInfo imageViewInfo{};
 	imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	imageViewInfo.image = image;
-	imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	imageViewInfo.viewType = viewType;
 	imageViewInfo.format = format;
 	imageViewInfo.components = {
 		VK_COMPONENT_SWIZZLE_R,
@@ -390,7 +464,7 @@ void GraphicsEngine::createImageView2D(const VkImage & image, VkFormat format, c
 }
 
 template<typename T, std::enable_if_t<std::is_same_v<T, VkBuffer> || std::is_same_v<T, VkImage>, std::nullptr_t>>
-void GraphicsEngine::allocateDeviceMemory(const T& destObject, VkDeviceMemory& deviceMemory, VkMemoryPropertyFlags memoryPropertyFlags) {
+void GraphicsEngine::allocateDeviceMemory(const T& destObject, MemoryAllocator::Allocation& allocation, MemoryAllocator::MemoryUsage usage) {
 
 	VkMemoryRequirements memoryRequirements{};
 	if constexpr (std::is_same_v<T, VkBuffer>) {
@@ -400,47 +474,38 @@ void GraphicsEngine::allocateDeviceMemory(const T& destObject, VkDeviceMemory& d
 		vkGetImageMemoryRequirements(device_, destObject, &memoryRequirements);
 	}
 
-	uint32_t memoryTypeIndex = UINT32_MAX;
-	for (std::uint32_t i = 0; i < memoryProperties_.memoryTypeCount; ++i) {
-		if (memoryProperties_.memoryTypes[i].propertyFlags & memoryPropertyFlags) {
-			memoryTypeIndex = i;
-			break;
-		}
-	}
-	if (memoryTypeIndex == UINT32_MAX) {
-		std::cerr << "[createVertexBuffer] failed to find memory for vertex buffer" << std::endl;
+	// every image is created with optimal tiling
+	auto kind = std::is_same_v<T, VkBuffer> ? MemoryAllocator::ResourceKind::Linear : MemoryAllocator::ResourceKind::Optimal;
+
+	// memory type is chosen from memoryTypeBits by usage (see MemoryAllocator::memoryTypeCandidates)
+	if (!memoryAllocator_.allocate(memoryRequirements, usage, kind, allocation)) {
+		std::cerr << "[allocateDeviceMemory] failed to allocate device memory" << std::endl;
 		std::exit(EXIT_FAILURE);
 	}
-
-	VkMemoryAllocateInfo allocateInfo{};
-	allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocateInfo.allocationSize = memoryRequirements.size;
-	allocateInfo.memoryTypeIndex = memoryTypeIndex;
-
-	VK_CHECK(vkAllocateMemory(device_, &allocateInfo, allocator, &deviceMemory));
 	
 	if constexpr (std::is_same_v<T, VkBuffer>) {
-		VK_CHECK(vkBindBufferMemory(device_, destObject, deviceMemory, 0));
+		VK_CHECK(vkBindBufferMemory(device_, destObject, allocation.memory, allocation.offset));
 	}
 	else if constexpr (std::is_same_v<T, VkImage>) {
-		VK_CHECK(vkBindImageMemory(device_, destObject, deviceMemory, 0));
+		VK_CHECK(vkBindImageMemory(device_, destObject, allocation.memory, allocation.offset));
 	}
 }
 
+void GraphicsEngine::freeDeviceMemory(const MemoryAllocator::Allocation& allocation) {
+	memoryAllocator_.free(allocation);
+}
+
 template<typename T>
 void GraphicsEngine::createVertexBuffer(const std::vector<T>& data, VertexBuffer& buffer) {
 
 	auto bufferSize = sizeof(T) * data.size();
-	createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, buffer.buffer);
-
-	allocateDeviceMemory(buffer.buffer, buffer.memory, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-
-	std::uint8_t* mappedMemory{};
-	VK_CHECK(vkMapMemory(device_, buffer.memory, 0, sizeof(T) * data.size(), 0, reinterpret_cast<void**>(&mappedMemory)));
+	buffer.size = bufferSize;
+	// transfer source: benchmarkMemoryPlacement copies geometry to host visible memory
+	createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, buffer.buffer);
 
-	std::memcpy(mappedMemory, data.data(), sizeof(T) * data.size());
+	allocateDeviceMemory(buffer.buffer, buffer.allocation, MemoryAllocator::MemoryUsage::Static);
 
-	vkUnmapMemory(device_, buffer.memory);
+	uploadBuffer(buffer.buffer, data.data(), bufferSize);
 }
 
 template<typename T, std::enable_if_t<std::is_same_v<T, std::uint16_t> || std::is_same_v<T, std::uint32_t>, std::nullptr_t>>
@@ -456,66 +521,291 @@ void GraphicsEngine::createIndexBuffer(const std::vector<T>& data, IndexBuffer&
 	buffer.size = data.size();
 
 	auto bufferSize = sizeof(T) * data.size();
-	createBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, buffer.buffer);
+	createBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, buffer.buffer);
 
-	allocateDeviceMemory(buffer.buffer, buffer.memory, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	allocateDeviceMemory(buffer.buffer, buffer.allocation, MemoryAllocator::MemoryUsage::Static);
 
-	std::uint8_t* mappedMemory{};
-	VK_CHECK(vkMapMemory(device_, buffer.memory, 0, sizeof(T) * data.size(), 0, reinterpret_cast<void**>(&mappedMemory)));
+	uploadBuffer(buffer.buffer, data.data(), bufferSize);
+}
+
+void GraphicsEngine::createFrameRingBuffer(std::size_t regionSize, FrameRingBuffer& buffer) {
+	// every slice can be bound as uniform or storage buffer
+	buffer.alignment = static_cast<std::size_t>(std::max(properties_.limits.minUniformBufferOffsetAlignment, properties_.limits.minStorageBufferOffsetAlignment));
+	buffer.regionSize = (regionSize + buffer.alignment - 1) / buffer.alignment * buffer.alignment;
+	buffer.regionOffset = 0;
+	buffer.head = 0;
 
-	std::memcpy(mappedMemory, data.data(), sizeof(T) * data.size());
+	createBuffer(buffer.regionSize * maxFramesInFlight, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, buffer.buffer);
 
-	vkUnmapMemory(device_, buffer.memory);
+	allocateDeviceMemory(buffer.buffer, buffer.allocation, MemoryAllocator::MemoryUsage::Dynamic);
+
+	buffer.pointer = buffer.allocation.pointer;
 }
 
-template<typename T>
-void GraphicsEngine::createUniformBuffer(UniformBuffer<T>& buffer) {
+void GraphicsEngine::createStagingBuffer(std::size_t size, StagingBuffer& buffer) {
 
-	createBuffer(sizeof(T), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, buffer.buffer);
+	buffer.size = size;
+	buffer.head = 0;
+	buffer.tail = 0;
+
+	createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, buffer.buffer);
 
-	allocateDeviceMemory(buffer.buffer, buffer.memory, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	allocateDeviceMemory(buffer.buffer, buffer.allocation, MemoryAllocator::MemoryUsage::Upload);
 
-	VK_CHECK(vkMapMemory(device_, buffer.memory, 0, sizeof(T), 0, reinterpret_cast<void**>(&buffer.pointer)));
+	buffer.pointer = buffer.allocation.pointer;
 }
 
-template<typename T>
-void GraphicsEngine::createConstantUnifromBuffer(const T& data, UniformBuffer<T>& buffer) {
+void GraphicsEngine::destroyStagingBuffer(StagingBuffer& buffer) {
+	vkDestroyBuffer(device_, buffer.buffer, allocator);
+	freeDeviceMemory(buffer.allocation);
+
+	buffer = StagingBuffer{};
+}
+
+bool GraphicsEngine::isMipmapGenerationSupported(VkFormat format) {
+	// mip levels are generated by linear blits
+	constexpr VkFormatFeatureFlags desiredFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+	VkFormatProperties formatProperties{};
+	vkGetPhysicalDeviceFormatProperties(physicalDevice_, format, &formatProperties);
 
-	createBuffer(sizeof(T), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, buffer.buffer);
+	return (formatProperties.optimalTilingFeatures & desiredFeatures) == desiredFeatures;
+}
+
+void GraphicsEngine::createTexture(const TexImage& image, std::size_t bufferOffset, Texture& texture) {
+
+	// only base level is given -> generate full chain (down to 1x1)
+	bool generateMips = image.mipLevels == 1 && isMipmapGenerationSupported(image.format);
+	if (generateMips) {
+		texture.mipLevels = static_cast<std::uint32_t>(std::floor(std::log2(std::max(image.size.width, image.size.height)))) + 1;
+	}
+	else {
+		texture.mipLevels = image.mipLevels;
+	}
+	generateMips = generateMips && texture.mipLevels > 1;
+
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	if (generateMips) usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+	// all layers (or faces) are uploaded, but material slots are sampler2D / texture2D
+	// -> view is 2D of layer 0 (cube or array views would not match shaders, cube array also needs imageCubeArray)
+	if (image.arrayLayers > 1) {
+		std::cout << "[createTexture] " << (image.cube ? "cubemap" : "array") << " texture with " << image.arrayLayers << " layers is sampled as 2D layer 0" << std::endl;
+	}
+
+	createImage2D(image.format, image.size, texture.mipLevels, image.arrayLayers, 0, usage, VK_SAMPLE_COUNT_1_BIT, texture.image);
+	allocateDeviceMemory(texture.image, texture.allocation, MemoryAllocator::MemoryUsage::Static);
+	createImageView2D(texture.image, VK_IMAGE_VIEW_TYPE_2D, image.format, { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, 1 }, texture.view);
+
+	// copy is recorded later with the other pending uploads (see flushUploads)
+	TextureUpload upload{};
+	upload.image = texture.image;
+	upload.size = image.size;
+	upload.mipLevels = texture.mipLevels;
+	upload.arrayLayers = image.arrayLayers;
+	upload.generateMips = generateMips;
+
+	// one region per stored subresource, all pointing into the same staged block
+	upload.regions.resize(image.subresourceOffsets.size());
+	for (std::uint32_t layer = 0; layer < image.arrayLayers; ++layer) {
+		for (std::uint32_t level = 0; level < image.mipLevels; ++level) {
+			auto& region = upload.regions[layer * image.mipLevels + level];
+			region.bufferOffset = bufferOffset + image.subresourceOffsets[layer * image.mipLevels + level];
+			// tightly packed rows (driver handles row pitch of optimal image)
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, layer, 1 };
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = { std::max(1u, image.size.width >> level), std::max(1u, image.size.height >> level), 1 };
+		}
+	}
 
-	allocateDeviceMemory(buffer.buffer, buffer.memory, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	pendingTextureUploads_.push_back(std::move(upload));
+}
 
-	std::uint8_t* mappedMemory{};
-	VK_CHECK(vkMapMemory(device_, buffer.memory, 0, sizeof(T), 0, reinterpret_cast<void**>(&mappedMemory)));
+bool GraphicsEngine::stageDDS(const std::filesystem::path& path, TexImage& image, std::uint64_t& contentHash, std::size_t& bufferOffset) {
+	// DDS payload (all mips, layers and faces) goes from file straight into staging ring
+	bool staged = false;
+	auto allocate = [&](std::size_t size) {
+		bufferOffset = reserveStagingData(size);
+		staged = true;
+		return stagingBuffer_.pointer + bufferOffset;
+	};
 
-	std::memcpy(mappedMemory, &data, sizeof(T));
+	TexLoader loader{};
+	if (!loader.readDDS(path, image, contentHash, allocate)) {
+		if (staged) stagingBuffer_.head = bufferOffset;
+		return false;
+	}
 
-	vkUnmapMemory(device_, buffer.memory);
+	return true;
 }
 
-void GraphicsEngine::createStorageBuffer(std::size_t size, StorageBuffer& buffer) {
+std::filesystem::path GraphicsEngine::cookedTexturePath(std::uint64_t contentHash) {
+	// keyed by source content (and encoder mode), so renamed / moved sources still hit
+	std::stringstream name{};
+	name << std::hex << std::setw(16) << std::setfill('0') << contentHash << std::dec << ".v" << cookedTextureVersion << (textureCompression_ == TextureCompression::Quality ? ".bc7.dds" : ".bc1bc3.dds");
 
-	buffer.size = size;
+	return std::filesystem::path(textureCacheDirectory) / name.str();
+}
+
+bool GraphicsEngine::loadTexture(const std::filesystem::path& path, Texture& texture) {
+	auto& cache = TextureCache<Texture>::instance();
+	auto canonicalPath = TextureCache<Texture>::canonicalKey(path);
+
+	// same path already resident
+	if (cache.acquire(canonicalPath, texture)) return true;
+
+	TexLoader loader{};
+	TexImage image{};
+	std::uint64_t contentHash{};
+	std::size_t bufferOffset{};
+
+	if (path.extension() == ".dds") {
+		if (!stageDDS(path, image, contentHash, bufferOffset)) return false;
+
+		// same content already resident under another path -> give staged range back
+		if (cache.acquire(canonicalPath, contentHash, texture)) {
+			stagingBuffer_.head = bufferOffset;
+			return true;
+		}
+	}
+	else {
+		std::vector<std::uint8_t> fileData{};
+		if (!loader.read(path, fileData)) return false;
+
+		// same content already resident under another path
+		contentHash = TextureCache<Texture>::hash(fileData);
+		if (cache.acquire(canonicalPath, contentHash, texture)) return true;
+
+		auto cookedPath = cookedTexturePath(contentHash);
+		std::uint64_t cookedHash{};
+
+		// cooked by earlier run -> compressed blocks are loaded like any other DDS
+		if (textureCompression_ != TextureCompression::None && std::filesystem::exists(cookedPath) && stageDDS(cookedPath, image, cookedHash, bufferOffset)) {
+			std::cout << "[loadTexture] (" << path << ") using cooked texture " << cookedPath << std::endl;
+		}
+		else {
+			if (!loader.decode(path, fileData, image)) return false;
+
+			if (textureCompression_ != TextureCompression::None) {
+				TexEncoder encoder{};
+				TexImage encoded{};
+				auto mode = textureCompression_ == TextureCompression::Quality ? TexEncoder::Mode::Quality : TexEncoder::Mode::Fast;
+
+				// on failure raw RGBA8 is uploaded as before
+				if (encoder.encode(image, mode, encoded)) {
+					std::error_code error{};
+					std::filesystem::create_directories(cookedPath.parent_path(), error);
 
-	createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, buffer.buffer);
+					DDSLoader writer{};
+					writer.write(cookedPath, encoded);
 
-	allocateDeviceMemory(buffer.buffer, buffer.memory, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+					image = std::move(encoded);
+				}
+			}
 
-	VK_CHECK(vkMapMemory(device_, buffer.memory, 0, size, 0, reinterpret_cast<void**>(&buffer.pointer)));
+			bufferOffset = stageData(image.data.data(), sizeof(std::uint8_t) * image.data.size());
+		}
+	}
+
+	createTexture(image, bufferOffset, texture);
+	texture.contentHash = contentHash;
+	texture.opaque = image.opaque;
+
+	cache.insert(canonicalPath, contentHash, texture, [this](const Texture& texture) { destroyTexture(texture); });
+
+	return true;
+}
+
+void GraphicsEngine::releaseTexture(const Texture& texture) {
+	TextureCache<Texture>::instance().release(texture.contentHash, [this](const Texture& texture) { destroyTexture(texture); });
+}
+
+void GraphicsEngine::destroyTexture(const Texture& texture) {
+	// image may still be target of pending or in flight copy
+	waitUploads(flushUploads());
+
+	vkDestroyImageView(device_, texture.view, allocator);
+	vkDestroyImage(device_, texture.image, allocator);
+	freeDeviceMemory(texture.allocation);
 }
 
-void GraphicsEngine::createTexture(const std::vector<std::uint8_t>& data, VkFormat format, const VkExtent3D& size, Texture& texture) {
+void GraphicsEngine::loadModel(const std::filesystem::path& path, std::vector<PMX_Vertex>& vertices, std::vector<std::uint32_t>& indices, bool demoPose) {
+	PMXLoader loader{};
+	PMXData modelData{};
+	loader.load(path, modelData);
+
+	// model local indices are rebased onto merged lists
+	auto textureBase = static_cast<std::int32_t>(textures_.size());
+	auto boneBase = static_cast<std::int32_t>(bones_.size());
+	auto vertexBase = static_cast<std::uint32_t>(vertices.size());
+	auto indexBase = static_cast<std::uint32_t>(indices.size());
+
+	textures_.resize(textures_.size() + modelData.texturePaths.size());
+	for (auto i = 0; i < modelData.texturePaths.size(); ++i) {
+		std::cout << modelData.texturePaths[i] << std::endl;
+		if (loadTexture(modelData.texturePaths[i], textures_[textureBase + i])) {
+			std::cout << "success" << std::endl;
+			maxTextureMipLevels_ = std::max(maxTextureMipLevels_, textures_[textureBase + i].mipLevels);
+		}
+		else {
+			std::cout << "failure" << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+	}
+
+	/*
+	for (auto i = 0; i < modelData.vertices.size(); ++i) {
+		std::cout << "vertices #" << i << std::endl;
+		std::cout << "bone index 1: " << modelData.vertices[i].boneIndices.x << ", 2: " << modelData.vertices[i].boneIndices.y << ", 3: " << modelData.vertices[i].boneIndices.z << ", 4: " << modelData.vertices[i].boneIndices.w << std::endl;
+		std::cout << "bone weight 1: " << modelData.vertices[i].boneWeights.x << ", 2: " << modelData.vertices[i].boneWeights.y << ", 3: " << modelData.vertices[i].boneWeights.z << ", 4: " << modelData.vertices[i].boneWeights.w << std::endl;
+	}
+	*/
+
+	std::vector<Bone> bones(modelData.bones.size(), Bone{ glm::mat4(1.0f) });
 
-	createImage2D(format, size, VK_IMAGE_USAGE_SAMPLED_BIT, VK_SAMPLE_COUNT_1_BIT, texture.image);
-	allocateDeviceMemory(texture.image, texture.memory, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-	createImageView2D(texture.image, format, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }, texture.view);
+	// demo pose (arms of built-in model)
+	//bones[0].matrix = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	if (demoPose && bones.size() > 60) {
+		bones[41].matrix = glm::rotate(glm::mat4(1.0f), glm::radians(-70.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		bones[42].matrix = glm::rotate(glm::mat4(1.0f), glm::radians(-140.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		bones[60].matrix = glm::rotate(glm::mat4(1.0f), glm::radians(-35.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	}
+	for (auto i = 0; i < bones.size(); ++i) {
+		auto localMatrix = glm::translate(glm::mat4(1.0f), -modelData.bones[i].position);
+		auto globalMatrix = glm::translate(glm::mat4(1.0f), modelData.bones[i].position);
+		if (modelData.bones[i].parentIndex == -1) bones[i].matrix = globalMatrix * bones[i].matrix * localMatrix;
+		else bones[i].matrix = globalMatrix * bones[i].matrix * localMatrix * bones[modelData.bones[i].parentIndex].matrix;
+	}
+	bones_.insert(bones_.end(), bones.begin(), bones.end());
 
-	std::uint8_t* mappedMemory{};
-	VK_CHECK(vkMapMemory(device_, texture.memory, 0, sizeof(std::uint8_t) * data.size(), 0, reinterpret_cast<void**>(&mappedMemory)));
+	//for (const auto& bone : modelData.bones) std::cout << "bone #" << bone.index << ", parent: " << bone.parentIndex << std::endl;
 
-	std::memcpy(mappedMemory, data.data(), sizeof(std::uint8_t) * data.size());
+	// -1 marks unused bone slot (BDEF1 / BDEF2), shaders test for it
+	for (auto vertex : modelData.vertices) {
+		for (auto j = 0; j < 4; ++j) {
+			if (vertex.boneIndices[j] >= 0) vertex.boneIndices[j] += boneBase;
+		}
+		vertices.push_back(vertex);
+	}
 
-	vkUnmapMemory(device_, texture.memory);
+	std::visit([&](const auto& indexData) {
+		for (auto index : indexData) indices.push_back(vertexBase + index);
+	}, modelData.indices);
+
+	models_.push_back(ModelRange{ static_cast<std::uint32_t>(materials_.size()), static_cast<std::uint32_t>(modelData.materials.size()) });
+	for (auto material : modelData.materials) {
+		material.indexOffset += indexBase;
+		if (material.textureIndex >= 0) material.textureIndex += textureBase;
+		if (material.sphereIndex >= 0) material.sphereIndex += textureBase;
+		if (material.toonIndex >= 0) material.toonIndex += textureBase;
+		materials_.push_back(material);
+
+		// fragment alpha is texture alpha (times diffuse alpha)
+		bool textureAlpha = material.textureIndex >= 0 && !textures_[material.textureIndex].opaque;
+		transparentMaterials_.push_back(material.diffuse.a < 1.0f || textureAlpha);
+	}
 }
 
 void GraphicsEngine::createTextureSampler() {
@@ -535,7 +825,7 @@ void GraphicsEngine::createTextureSampler() {
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = 0.0f;
+	samplerInfo.maxLod = static_cast<float>(maxTextureMipLevels_);
 
 	VK_CHECK(vkCreateSampler(device_, &samplerInfo, allocator, &textureSampler_));
 }
@@ -557,67 +847,49 @@ void GraphicsEngine::createToonSampler() {
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = 0.0f;
+	samplerInfo.maxLod = static_cast<float>(maxTextureMipLevels_);
 
 	VK_CHECK(vkCreateSampler(device_, &samplerInfo, allocator, &toonSampler_));
 }
 
-void GraphicsEngine::createShaderModule(const char* vertexSPIRVPath, const char* fragmentSPIRVPath) {
-	{
-		std::ifstream file(vertexSPIRVPath, std::ios::in | std::ios::binary);
-		if (file.fail()) {
-			std::cerr << "[createShaderModule]: failed to read a file: " << vertexSPIRVPath << std::endl;
-			std::exit(EXIT_FAILURE);
-		}
-
-		file.seekg(0, std::ios_base::end);
-		std::size_t fileSize = file.tellg();
-		file.seekg(0, std::ios_base::beg);
-
-		std::vector<uint8_t> bin(fileSize);
-		file.read(reinterpret_cast<char*>(bin.data()), sizeof(std::uint8_t) * fileSize);
-
-		VkShaderModuleCreateInfo shaderInfo{};
-		shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		shaderInfo.codeSize = bin.size();
-		shaderInfo.pCode = reinterpret_cast<std::uint32_t*>(bin.data());
-
-		VK_CHECK(vkCreateShaderModule(device_, &shaderInfo, allocator, &vertexShaderModule_));
+void GraphicsEngine::loadShaderModule(const char* SPIRVPath, VkShaderModule& shaderModule) {
+	std::ifstream file(SPIRVPath, std::ios::in | std::ios::binary);
+	if (file.fail()) {
+		std::cerr << "[loadShaderModule]: failed to read a file: " << SPIRVPath << std::endl;
+		std::exit(EXIT_FAILURE);
 	}
 
-	{
-		std::ifstream file(fragmentSPIRVPath, std::ios::in | std::ios::binary);
-		if (file.fail()) {
-			std::cerr << "[createShaderModule]: failed to read a file: " << fragmentSPIRVPath << std::endl;
-			std::exit(EXIT_FAILURE);
-		}
+	file.seekg(0, std::ios_base::end);
+	std::size_t fileSize = file.tellg();
+	file.seekg(0, std::ios_base::beg);
 
-		file.seekg(0, std::ios_base::end);
-		std::size_t fileSize = file.tellg();
-		file.seekg(0, std::ios_base::beg);
+	std::vector<uint8_t> bin(fileSize);
+	file.read(reinterpret_cast<char*>(bin.data()), sizeof(std::uint8_t) * fileSize);
 
-		std::vector<uint8_t> bin(fileSize);
-		file.read(reinterpret_cast<char*>(bin.data()), sizeof(std::uint8_t) * fileSize);
+	VkShaderModuleCreateInfo shaderInfo{};
+	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderInfo.codeSize = bin.size();
+	shaderInfo.pCode = reinterpret_cast<std::uint32_t*>(bin.data());
 
-		VkShaderModuleCreateInfo shaderInfo{};
-		shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		shaderInfo.codeSize = bin.size();
-		shaderInfo.pCode = reinterpret_cast<std::uint32_t*>(bin.data());
+	VK_CHECK(vkCreateShaderModule(device_, &shaderInfo, allocator, &shaderModule));
+}
 
-		VK_CHECK(vkCreateShaderModule(device_, &shaderInfo, allocator, &fragmentShaderModule_));
-	}
+void GraphicsEngine::createShaderModule(const char* vertexSPIRVPath, const char* fragmentSPIRVPath) {
+	loadShaderModule(vertexSPIRVPath, vertexShaderModule_);
+	loadShaderModule(fragmentSPIRVPath, fragmentShaderModule_);
 }
 
 void GraphicsEngine::createDefaultDescriptorSetLayout() {
+	// per-frame data lives in frame ring -> dynamic offsets select this frame's slices
 	VkDescriptorSetLayoutBinding transformLayoutBinding{};
 	transformLayoutBinding.binding = 0;
-	transformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	transformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	transformLayoutBinding.descriptorCount = 1;
 	transformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
 	VkDescriptorSetLayoutBinding materialLayoutBinding{};
 	materialLayoutBinding.binding = 1;
-	materialLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	materialLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	materialLayoutBinding.descriptorCount = 1;
 	materialLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
@@ -641,11 +913,17 @@ void GraphicsEngine::createDefaultDescriptorSetLayout() {
 
 	VkDescriptorSetLayoutBinding boneLayoutBinding{};
 	boneLayoutBinding.binding = 5;
-	boneLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	boneLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
 	boneLayoutBinding.descriptorCount = 1;
 	boneLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-	std::array<VkDescriptorSetLayoutBinding, 6> bindings{ transformLayoutBinding, materialLayoutBinding, textureLayoutBinding, sphereLayoutBinding, toonLayoutBinding, boneLayoutBinding };
+	VkDescriptorSetLayoutBinding instanceLayoutBinding{};
+	instanceLayoutBinding.binding = 6;
+	instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	instanceLayoutBinding.descriptorCount = 1;
+	instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	std::array<VkDescriptorSetLayoutBinding, 7> bindings{ transformLayoutBinding, materialLayoutBinding, textureLayoutBinding, sphereLayoutBinding, toonLayoutBinding, boneLayoutBinding, instanceLayoutBinding };
 
 	VkDescriptorSetLayoutCreateInfo layoutInfo{};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -657,30 +935,34 @@ void GraphicsEngine::createDefaultDescriptorSetLayout() {
 
 void GraphicsEngine::createDefaultDescriptorPool(std::uint32_t descriptorSetCount) {
 	VkDescriptorPoolSize transformPoolSize{};
-	transformPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	transformPoolSize.descriptorCount = 1;
+	transformPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	transformPoolSize.descriptorCount = descriptorSetCount;
 
 	VkDescriptorPoolSize materialPoolSize{};
-	materialPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	materialPoolSize.descriptorCount = 1;
+	materialPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	materialPoolSize.descriptorCount = descriptorSetCount;
 
 	VkDescriptorPoolSize texturePoolSize{};
 	texturePoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	texturePoolSize.descriptorCount = 1;
+	texturePoolSize.descriptorCount = descriptorSetCount;
 
 	VkDescriptorPoolSize spherePoolSize{};
 	spherePoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	spherePoolSize.descriptorCount = 1;
+	spherePoolSize.descriptorCount = descriptorSetCount;
 
 	VkDescriptorPoolSize toonPoolSize{};
 	toonPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	toonPoolSize.descriptorCount = 1;
+	toonPoolSize.descriptorCount = descriptorSetCount;
 
 	VkDescriptorPoolSize bonePoolSize{};
-	bonePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	bonePoolSize.descriptorCount = 1;
+	bonePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	bonePoolSize.descriptorCount = descriptorSetCount;
+
+	VkDescriptorPoolSize instancePoolSize{};
+	instancePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	instancePoolSize.descriptorCount = descriptorSetCount;
 
-	std::array<VkDescriptorPoolSize, 6> poolSizes{ transformPoolSize, materialPoolSize, texturePoolSize, spherePoolSize, toonPoolSize, bonePoolSize };
+	std::array<VkDescriptorPoolSize, 7> poolSizes{ transformPoolSize, materialPoolSize, texturePoolSize, spherePoolSize, toonPoolSize, bonePoolSize, instancePoolSize };
 
 	VkDescriptorPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -691,7 +973,7 @@ void GraphicsEngine::createDefaultDescriptorPool(std::uint32_t descriptorSetCoun
 	VK_CHECK(vkCreateDescriptorPool(device_, &poolInfo, allocator, &defaultDescriptorPool_));
 }
 
-void GraphicsEngine::createDefaultDescriptorSets(const UniformBuffer<MaterialBufferObject>& materialBuffer, const Texture& materialTexture, const Texture& sphereTexture, const Texture& toonTexture, VkDescriptorSet& descriptorSet) {
+void GraphicsEngine::createDefaultDescriptorSets(const Texture& materialTexture, const Texture& sphereTexture, const Texture& toonTexture, VkDescriptorSet& descriptorSet) {
 	VkDescriptorSetLayout layout = defaultDescriptorSetLayout_;
 
 	VkDescriptorSetAllocateInfo allocateInfo{};
@@ -702,13 +984,14 @@ void GraphicsEngine::createDefaultDescriptorSets(const UniformBuffer<MaterialBuf
 
 	VK_CHECK(vkAllocateDescriptorSets(device_, &allocateInfo, &descriptorSet));
 
+	// offsets are given at bind time (see bindDefaultDescriptorSet)
 	VkDescriptorBufferInfo transformBufferInfo{};
-	transformBufferInfo.buffer = transformBuffer_.buffer;
+	transformBufferInfo.buffer = frameRingBuffer_.buffer;
 	transformBufferInfo.offset = 0;
-	transformBufferInfo.range = sizeof(decltype(transformBuffer_)::type);
+	transformBufferInfo.range = sizeof(TransformBufferObject);
 
 	VkDescriptorBufferInfo materialBufferInfo{};
-	materialBufferInfo.buffer = materialBuffer.buffer;
+	materialBufferInfo.buffer = frameRingBuffer_.buffer;
 	materialBufferInfo.offset = 0;
 	materialBufferInfo.range = sizeof(MaterialBufferObject);
 
@@ -728,16 +1011,21 @@ void GraphicsEngine::createDefaultDescriptorSets(const UniformBuffer<MaterialBuf
 	toonInfo.sampler = toonSampler_;
 
 	VkDescriptorBufferInfo boneBufferInfo{};
-	boneBufferInfo.buffer = boneBuffer_.buffer;
+	boneBufferInfo.buffer = frameRingBuffer_.buffer;
 	boneBufferInfo.offset = 0;
-	boneBufferInfo.range = boneBuffer_.size;
+	boneBufferInfo.range = sizeof(Bone) * bones_.size() * bonePaletteCount_;
+
+	VkDescriptorBufferInfo instanceBufferInfo{};
+	instanceBufferInfo.buffer = frameRingBuffer_.buffer;
+	instanceBufferInfo.offset = 0;
+	instanceBufferInfo.range = sizeof(InstanceRecord) * instanceRecordCount();
 
 	VkWriteDescriptorSet descriptorTransformWrite{};
 	descriptorTransformWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 	descriptorTransformWrite.dstSet = descriptorSet;
 	descriptorTransformWrite.dstBinding = 0;
 	descriptorTransformWrite.dstArrayElement = 0;
-	descriptorTransformWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descriptorTransformWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	descriptorTransformWrite.descriptorCount = 1;
 	descriptorTransformWrite.pBufferInfo = &transformBufferInfo;
 
@@ -746,7 +1034,7 @@ void GraphicsEngine::createDefaultDescriptorSets(const UniformBuffer<MaterialBuf
 	descriptorMaterialWrite.dstSet = descriptorSet;
 	descriptorMaterialWrite.dstBinding = 1;
 	descriptorMaterialWrite.dstArrayElement = 0;
-	descriptorMaterialWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descriptorMaterialWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	descriptorMaterialWrite.descriptorCount = 1;
 	descriptorMaterialWrite.pBufferInfo = &materialBufferInfo;
 
@@ -782,93 +1070,735 @@ void GraphicsEngine::createDefaultDescriptorSets(const UniformBuffer<MaterialBuf
 	descriptorBoneWrite.dstSet = descriptorSet;
 	descriptorBoneWrite.dstBinding = 5;
 	descriptorBoneWrite.dstArrayElement = 0;
-	descriptorBoneWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorBoneWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
 	descriptorBoneWrite.descriptorCount = 1;
 	descriptorBoneWrite.pBufferInfo = &boneBufferInfo;
 
-	std::array<VkWriteDescriptorSet, 6> descriptorWrites{ descriptorTransformWrite, descriptorMaterialWrite, descriptorTextureWrite, descriptorSphereWrite, descriptorToonWrite, descriptorBoneWrite };
+	VkWriteDescriptorSet descriptorInstanceWrite{};
+	descriptorInstanceWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorInstanceWrite.dstSet = descriptorSet;
+	descriptorInstanceWrite.dstBinding = 6;
+	descriptorInstanceWrite.dstArrayElement = 0;
+	descriptorInstanceWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	descriptorInstanceWrite.descriptorCount = 1;
+	descriptorInstanceWrite.pBufferInfo = &instanceBufferInfo;
+
+	std::array<VkWriteDescriptorSet, 7> descriptorWrites{ descriptorTransformWrite, descriptorMaterialWrite, descriptorTextureWrite, descriptorSphereWrite, descriptorToonWrite, descriptorBoneWrite, descriptorInstanceWrite };
 
 	vkUpdateDescriptorSets(device_, static_cast<std::uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
 
-void GraphicsEngine::createDefaultPipelineLayout() {
-	VkPipelineLayoutCreateInfo layoutInfo{};
-	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	layoutInfo.setLayoutCount = 1;
-	layoutInfo.pSetLayouts = &defaultDescriptorSetLayout_;
+void GraphicsEngine::createMaterialBuffer() {
+	// unused texture slots point at texture 0 (never sampled, flag is off)
+	auto textureSlot = [](std::int32_t index) { return index >= 0 ? static_cast<std::uint32_t>(index) : 0u; };
 
-	VK_CHECK(vkCreatePipelineLayout(device_, &layoutInfo, allocator, &defaultPipelineLayout_));
+	std::vector<MaterialRecord> records(materials_.size());
+	for (auto i = 0; i < materials_.size(); ++i) {
+		records[i] = MaterialRecord{
+			materials_[i].diffuse,
+			materials_[i].specular,
+			materials_[i].specCoef,
+			materials_[i].ambient,
+			materials_[i].textureIndex >= 0,
+			sphereMode(materials_[i]),
+			materials_[i].toonIndex >= 0,
+			textureSlot(materials_[i].textureIndex),
+			textureSlot(materials_[i].sphereIndex),
+			textureSlot(materials_[i].toonIndex),
+		};
+	}
+
+	materialBuffer_.size = sizeof(MaterialRecord) * records.size();
+	createBuffer(materialBuffer_.size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, materialBuffer_.buffer);
+
+	allocateDeviceMemory(materialBuffer_.buffer, materialBuffer_.allocation, MemoryAllocator::MemoryUsage::Static);
+
+	uploadBuffer(materialBuffer_.buffer, records.data(), materialBuffer_.size);
 }
 
-void GraphicsEngine::createDefaultGraphicsPipeline() {
-	std::array<VkPipelineShaderStageCreateInfo, 2> stageInfo{};
-	stageInfo[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	stageInfo[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-	stageInfo[0].module = vertexShaderModule_;
-	stageInfo[0].pName = "main";
-	stageInfo[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	stageInfo[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	stageInfo[1].module = fragmentShaderModule_;
-	stageInfo[1].pName = "main";
+void GraphicsEngine::createBindlessDescriptorSetLayout() {
+	// transform (0), bones (5) and instances (6) as in default layout, so basic.vert is shared
+	VkDescriptorSetLayoutBinding transformLayoutBinding{};
+	transformLayoutBinding.binding = 0;
+	transformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	transformLayoutBinding.descriptorCount = 1;
+	transformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-	std::array<VkVertexInputBindingDescription, 1> inputBindingDesc = {
-	VkVertexInputBindingDescription{0, sizeof(PMX_Vertex), VK_VERTEX_INPUT_RATE_VERTEX},
-	};
+	VkDescriptorSetLayoutBinding materialLayoutBinding{};
+	materialLayoutBinding.binding = 1;
+	materialLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	materialLayoutBinding.descriptorCount = 1;
+	materialLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-	std::array<VkVertexInputAttributeDescription, 10> inputAttributeDesc = {
-		VkVertexInputAttributeDescription{0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(PMX_Vertex, position)},
-		VkVertexInputAttributeDescription{1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(PMX_Vertex, normal)},
-		VkVertexInputAttributeDescription{2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(PMX_Vertex, uv)},
-		VkVertexInputAttributeDescription{3, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(PMX_Vertex, additionalUV[0])},
-		VkVertexInputAttributeDescription{4, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(PMX_Vertex, additionalUV[1])},
-		VkVertexInputAttributeDescription{5, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(PMX_Vertex, additionalUV[2])},
-		VkVertexInputAttributeDescription{6, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(PMX_Vertex, additionalUV[3])},
-		VkVertexInputAttributeDescription{7, 0, VK_FORMAT_R32G32B32A32_SINT, offsetof(PMX_Vertex, boneIndices)},
-		VkVertexInputAttributeDescription{8, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(PMX_Vertex, boneWeights)},
-		VkVertexInputAttributeDescription{9, 0, VK_FORMAT_R32_SFLOAT, offsetof(PMX_Vertex, edgeMult)},
-	};
+	VkDescriptorSetLayoutBinding boneLayoutBinding{};
+	boneLayoutBinding.binding = 5;
+	boneLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	boneLayoutBinding.descriptorCount = 1;
+	boneLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = static_cast<std::uint32_t>(inputBindingDesc.size());
-	vertexInputInfo.pVertexBindingDescriptions = inputBindingDesc.data();
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<std::uint32_t>(inputAttributeDesc.size());
-	vertexInputInfo.pVertexAttributeDescriptions = inputAttributeDesc.data();
+	VkDescriptorSetLayoutBinding instanceLayoutBinding{};
+	instanceLayoutBinding.binding = 6;
+	instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	instanceLayoutBinding.descriptorCount = 1;
+	instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-	VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo{};
-	inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	VkDescriptorSetLayoutBinding samplerLayoutBinding{};
+	samplerLayoutBinding.binding = 7;
+	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	samplerLayoutBinding.descriptorCount = 2;
+	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-	VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(imageSize_.width), static_cast<float>(imageSize_.height), 0.0f, 1.0f };
-	VkRect2D scissor = { {0, 0}, imageSize_ };
+	// variable count binding must have highest binding number
+	VkDescriptorSetLayoutBinding textureLayoutBinding{};
+	textureLayoutBinding.binding = 8;
+	textureLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	textureLayoutBinding.descriptorCount = std::min(maxBindlessTextures, properties_.limits.maxPerStageDescriptorSampledImages);
+	textureLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-	VkPipelineViewportStateCreateInfo viewportInfo{};
-	viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportInfo.viewportCount = 1;
-	viewportInfo.pViewports = &viewport;
-	viewportInfo.scissorCount = 1;
-	viewportInfo.pScissors = &scissor;
+	std::array<VkDescriptorSetLayoutBinding, 6> bindings{ transformLayoutBinding, materialLayoutBinding, boneLayoutBinding, instanceLayoutBinding, samplerLayoutBinding, textureLayoutBinding };
+	std::array<VkDescriptorBindingFlags, 6> bindingFlags{ 0, 0, 0, 0, 0, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT };
 
-	VkPipelineRasterizationStateCreateInfo rasterizationInfo{};
-	rasterizationInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizationInfo.depthClampEnable = VK_FALSE;
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsInfo.bindingCount = static_cast<std::uint32_t>(bindingFlags.size());
+	bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.bindingCount = static_cast<std::uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	VK_CHECK(vkCreateDescriptorSetLayout(device_, &layoutInfo, allocator, &defaultDescriptorSetLayout_));
+}
+
+void GraphicsEngine::createBindlessDescriptorPool() {
+	VkDescriptorPoolSize uniformPoolSize{};
+	uniformPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	uniformPoolSize.descriptorCount = 1;
+
+	VkDescriptorPoolSize storagePoolSize{};
+	storagePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	storagePoolSize.descriptorCount = 1;
+
+	VkDescriptorPoolSize dynamicStoragePoolSize{};
+	dynamicStoragePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	dynamicStoragePoolSize.descriptorCount = 2;
+
+	VkDescriptorPoolSize samplerPoolSize{};
+	samplerPoolSize.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+	samplerPoolSize.descriptorCount = 2;
+
+	VkDescriptorPoolSize texturePoolSize{};
+	texturePoolSize.type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	// zero sized pool entry is invalid, scene without textures still reserves one
+	texturePoolSize.descriptorCount = std::max<std::uint32_t>(static_cast<std::uint32_t>(textures_.size()), 1);
+
+	std::array<VkDescriptorPoolSize, 5> poolSizes{ uniformPoolSize, storagePoolSize, dynamicStoragePoolSize, samplerPoolSize, texturePoolSize };
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<std::uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = 1;
+
+	VK_CHECK(vkCreateDescriptorPool(device_, &poolInfo, allocator, &defaultDescriptorPool_));
+}
+
+void GraphicsEngine::createBindlessDescriptorSet() {
+	VkDescriptorSetLayout layout = defaultDescriptorSetLayout_;
+	auto textureCount = static_cast<std::uint32_t>(textures_.size());
+
+	VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo{};
+	variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+	variableCountInfo.descriptorSetCount = 1;
+	variableCountInfo.pDescriptorCounts = &textureCount;
+
+	VkDescriptorSetAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.pNext = &variableCountInfo;
+	allocateInfo.descriptorPool = defaultDescriptorPool_;
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &layout;
+
+	VK_CHECK(vkAllocateDescriptorSets(device_, &allocateInfo, &bindlessDescriptorSet_));
+
+	// offsets are given at bind time (see bindBindlessDescriptorSet)
+	VkDescriptorBufferInfo transformBufferInfo{};
+	transformBufferInfo.buffer = frameRingBuffer_.buffer;
+	transformBufferInfo.offset = 0;
+	transformBufferInfo.range = sizeof(TransformBufferObject);
+
+	VkDescriptorBufferInfo materialBufferInfo{};
+	materialBufferInfo.buffer = materialBuffer_.buffer;
+	materialBufferInfo.offset = 0;
+	materialBufferInfo.range = materialBuffer_.size;
+
+	VkDescriptorBufferInfo boneBufferInfo{};
+	boneBufferInfo.buffer = frameRingBuffer_.buffer;
+	boneBufferInfo.offset = 0;
+	boneBufferInfo.range = sizeof(Bone) * bones_.size() * bonePaletteCount_;
+
+	VkDescriptorBufferInfo instanceBufferInfo{};
+	instanceBufferInfo.buffer = frameRingBuffer_.buffer;
+	instanceBufferInfo.offset = 0;
+	instanceBufferInfo.range = sizeof(InstanceRecord) * instanceRecordCount();
+
+	// same order as samplers[] of bindless.frag
+	std::array<VkDescriptorImageInfo, 2> samplerInfos{};
+	samplerInfos[0].sampler = textureSampler_;
+	samplerInfos[1].sampler = toonSampler_;
+
+	std::vector<VkDescriptorImageInfo> textureInfos(textureCount);
+	for (std::uint32_t i = 0; i < textureCount; ++i) {
+		textureInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		textureInfos[i].imageView = textures_[i].view;
+		textureInfos[i].sampler = VK_NULL_HANDLE;
+	}
+
+	VkWriteDescriptorSet descriptorTransformWrite{};
+	descriptorTransformWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorTransformWrite.dstSet = bindlessDescriptorSet_;
+	descriptorTransformWrite.dstBinding = 0;
+	descriptorTransformWrite.dstArrayElement = 0;
+	descriptorTransformWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	descriptorTransformWrite.descriptorCount = 1;
+	descriptorTransformWrite.pBufferInfo = &transformBufferInfo;
+
+	VkWriteDescriptorSet descriptorMaterialWrite{};
+	descriptorMaterialWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorMaterialWrite.dstSet = bindlessDescriptorSet_;
+	descriptorMaterialWrite.dstBinding = 1;
+	descriptorMaterialWrite.dstArrayElement = 0;
+	descriptorMaterialWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorMaterialWrite.descriptorCount = 1;
+	descriptorMaterialWrite.pBufferInfo = &materialBufferInfo;
+
+	VkWriteDescriptorSet descriptorBoneWrite{};
+	descriptorBoneWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorBoneWrite.dstSet = bindlessDescriptorSet_;
+	descriptorBoneWrite.dstBinding = 5;
+	descriptorBoneWrite.dstArrayElement = 0;
+	descriptorBoneWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	descriptorBoneWrite.descriptorCount = 1;
+	descriptorBoneWrite.pBufferInfo = &boneBufferInfo;
+
+	VkWriteDescriptorSet descriptorInstanceWrite{};
+	descriptorInstanceWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorInstanceWrite.dstSet = bindlessDescriptorSet_;
+	descriptorInstanceWrite.dstBinding = 6;
+	descriptorInstanceWrite.dstArrayElement = 0;
+	descriptorInstanceWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	descriptorInstanceWrite.descriptorCount = 1;
+	descriptorInstanceWrite.pBufferInfo = &instanceBufferInfo;
+
+	VkWriteDescriptorSet descriptorSamplerWrite{};
+	descriptorSamplerWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorSamplerWrite.dstSet = bindlessDescriptorSet_;
+	descriptorSamplerWrite.dstBinding = 7;
+	descriptorSamplerWrite.dstArrayElement = 0;
+	descriptorSamplerWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	descriptorSamplerWrite.descriptorCount = static_cast<std::uint32_t>(samplerInfos.size());
+	descriptorSamplerWrite.pImageInfo = samplerInfos.data();
+
+	VkWriteDescriptorSet descriptorTextureWrite{};
+	descriptorTextureWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorTextureWrite.dstSet = bindlessDescriptorSet_;
+	descriptorTextureWrite.dstBinding = 8;
+	descriptorTextureWrite.dstArrayElement = 0;
+	descriptorTextureWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	descriptorTextureWrite.descriptorCount = textureCount;
+	descriptorTextureWrite.pImageInfo = textureInfos.data();
+
+	std::array<VkWriteDescriptorSet, 6> descriptorWrites{ descriptorTransformWrite, descriptorMaterialWrite, descriptorBoneWrite, descriptorInstanceWrite, descriptorSamplerWrite, descriptorTextureWrite };
+
+	// texture write is last, empty write is invalid
+	auto writeCount = static_cast<std::uint32_t>(descriptorWrites.size()) - (textureCount == 0 ? 1 : 0);
+	vkUpdateDescriptorSets(device_, writeCount, descriptorWrites.data(), 0, nullptr);
+}
+
+void GraphicsEngine::computeMaterialBounds(const std::vector<PMX_Vertex>& vertices, const PMX_Indices& indices) {
+	// bones are posed once at load time, so spheres enclose skinned positions (same blend as basic.vert)
+	std::vector<glm::vec3> positions(vertices.size());
+	for (auto i = 0; i < vertices.size(); ++i) {
+		const auto& vertex = vertices[i];
+		auto position = glm::vec4(vertex.position, 1.0f);
+		glm::vec4 skinned{};
+		if (vertex.boneIndices.y == -1) {
+			skinned = bones_[vertex.boneIndices.x].matrix * position;
+		}
+		else if (vertex.boneIndices.z == -1) {
+			skinned = bones_[vertex.boneIndices.x].matrix * position * vertex.boneWeights.x;
+			skinned += bones_[vertex.boneIndices.y].matrix * position * (1.0f - vertex.boneWeights.x);
+		}
+		else {
+			for (auto j = 0; j < 4; ++j) skinned += bones_[vertex.boneIndices[j]].matrix * position * vertex.boneWeights[j];
+		}
+		positions[i] = glm::vec3(skinned);
+	}
+
+	materialBounds_.resize(materials_.size());
+	std::visit([&](const auto& indexData) {
+		for (auto i = 0; i < materials_.size(); ++i) {
+			auto begin = indexData.begin() + materials_[i].indexOffset;
+			auto end = begin + materials_[i].indexCount;
+			if (begin == end) {
+				materialBounds_[i] = glm::vec4(0.0f);
+				continue;
+			}
+
+			auto minimum = positions[*begin];
+			auto maximum = minimum;
+			for (auto index = begin; index != end; ++index) {
+				minimum = glm::min(minimum, positions[*index]);
+				maximum = glm::max(maximum, positions[*index]);
+			}
+
+			auto center = (minimum + maximum) * 0.5f;
+			float radius = 0.0f;
+			for (auto index = begin; index != end; ++index) radius = std::max(radius, glm::length(positions[*index] - center));
+
+			materialBounds_[i] = glm::vec4(center, radius);
+		}
+	}, indices);
+}
+
+void GraphicsEngine::createIndirectDrawBuffer() {
+	auto alignment = static_cast<std::size_t>(properties_.limits.minStorageBufferOffsetAlignment);
+
+	// region: [early, late draw count][early commands][late commands], counts and commands are bound at their own aligned offsets
+	indirectDrawBuffer_.commandOffset = (sizeof(std::uint32_t) * 2 + alignment - 1) / alignment * alignment;
+	indirectDrawBuffer_.regionSize = (indirectDrawBuffer_.commandOffset + sizeof(VkDrawIndexedIndirectCommand) * indirectDrawCapacity_ * 2 + alignment - 1) / alignment * alignment;
+
+	createBuffer(indirectDrawBuffer_.regionSize * maxFramesInFlight, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, indirectDrawBuffer_.buffer);
+
+	allocateDeviceMemory(indirectDrawBuffer_.buffer, indirectDrawBuffer_.allocation, MemoryAllocator::MemoryUsage::Static);
+}
+
+void GraphicsEngine::createIndirectDescriptorSetLayout() {
+	// everything is per frame (frame ring / indirect draw buffer region) -> dynamic offsets
+	VkDescriptorSetLayoutBinding parameterLayoutBinding{};
+	parameterLayoutBinding.binding = 0;
+	parameterLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	parameterLayoutBinding.descriptorCount = 1;
+	parameterLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutBinding recordLayoutBinding{};
+	recordLayoutBinding.binding = 1;
+	recordLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	recordLayoutBinding.descriptorCount = 1;
+	recordLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+
+	VkDescriptorSetLayoutBinding commandLayoutBinding{};
+	commandLayoutBinding.binding = 2;
+	commandLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	commandLayoutBinding.descriptorCount = 1;
+	commandLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutBinding countLayoutBinding{};
+	countLayoutBinding.binding = 3;
+	countLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	countLayoutBinding.descriptorCount = 1;
+	countLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	// persistent across frames
+	VkDescriptorSetLayoutBinding visibilityLayoutBinding{};
+	visibilityLayoutBinding.binding = 4;
+	visibilityLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	visibilityLayoutBinding.descriptorCount = 1;
+	visibilityLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	std::array<VkDescriptorSetLayoutBinding, 5> bindings{ parameterLayoutBinding, recordLayoutBinding, commandLayoutBinding, countLayoutBinding, visibilityLayoutBinding };
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<std::uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	VK_CHECK(vkCreateDescriptorSetLayout(device_, &layoutInfo, allocator, &indirectDescriptorSetLayout_));
+}
+
+void GraphicsEngine::createIndirectDescriptorPool() {
+	VkDescriptorPoolSize uniformPoolSize{};
+	uniformPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	uniformPoolSize.descriptorCount = 1;
+
+	VkDescriptorPoolSize storagePoolSize{};
+	storagePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	storagePoolSize.descriptorCount = 3;
+
+	VkDescriptorPoolSize visibilityPoolSize{};
+	visibilityPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	visibilityPoolSize.descriptorCount = 1;
+
+	std::array<VkDescriptorPoolSize, 3> poolSizes{ uniformPoolSize, storagePoolSize, visibilityPoolSize };
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<std::uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = 1;
+
+	VK_CHECK(vkCreateDescriptorPool(device_, &poolInfo, allocator, &indirectDescriptorPool_));
+}
+
+void GraphicsEngine::createIndirectDescriptorSet() {
+	VkDescriptorSetLayout layout = indirectDescriptorSetLayout_;
+
+	VkDescriptorSetAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = indirectDescriptorPool_;
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &layout;
+
+	VK_CHECK(vkAllocateDescriptorSets(device_, &allocateInfo, &indirectDescriptorSet_));
+
+	// offsets are given at bind time (see indirectDynamicOffsets)
+	VkDescriptorBufferInfo parameterBufferInfo{};
+	parameterBufferInfo.buffer = frameRingBuffer_.buffer;
+	parameterBufferInfo.offset = 0;
+	parameterBufferInfo.range = sizeof(CullParameters);
+
+	VkDescriptorBufferInfo recordBufferInfo{};
+	recordBufferInfo.buffer = frameRingBuffer_.buffer;
+	recordBufferInfo.offset = 0;
+	recordBufferInfo.range = sizeof(DrawRecord) * indirectDrawCapacity_;
+
+	VkDescriptorBufferInfo commandBufferInfo{};
+	commandBufferInfo.buffer = indirectDrawBuffer_.buffer;
+	commandBufferInfo.offset = 0;
+	commandBufferInfo.range = sizeof(VkDrawIndexedIndirectCommand) * indirectDrawCapacity_ * 2;
+
+	VkDescriptorBufferInfo countBufferInfo{};
+	countBufferInfo.buffer = indirectDrawBuffer_.buffer;
+	countBufferInfo.offset = 0;
+	countBufferInfo.range = sizeof(std::uint32_t) * 2;
+
+	VkDescriptorBufferInfo visibilityBufferInfo{};
+	visibilityBufferInfo.buffer = visibilityBuffer_.buffer;
+	visibilityBufferInfo.offset = 0;
+	visibilityBufferInfo.range = visibilityBuffer_.size;
+
+	std::array<VkDescriptorBufferInfo, 5> bufferInfos{ parameterBufferInfo, recordBufferInfo, commandBufferInfo, countBufferInfo, visibilityBufferInfo };
+	std::array<VkDescriptorType, 5> descriptorTypes{
+		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+	};
+
+	std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
+	for (std::uint32_t i = 0; i < descriptorWrites.size(); ++i) {
+		descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[i].dstSet = indirectDescriptorSet_;
+		descriptorWrites[i].dstBinding = i;
+		descriptorWrites[i].dstArrayElement = 0;
+		descriptorWrites[i].descriptorType = descriptorTypes[i];
+		descriptorWrites[i].descriptorCount = 1;
+		descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets(device_, static_cast<std::uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+void GraphicsEngine::createVisibilityBuffer() {
+	// nothing visible before first frame: early pass draws nothing, late pass tests everything
+	std::vector<std::uint32_t> visibility(indirectDrawCapacity_, 0);
+
+	visibilityBuffer_.size = sizeof(std::uint32_t) * visibility.size();
+	createBuffer(visibilityBuffer_.size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, visibilityBuffer_.buffer);
+
+	allocateDeviceMemory(visibilityBuffer_.buffer, visibilityBuffer_.allocation, MemoryAllocator::MemoryUsage::Static);
+
+	uploadBuffer(visibilityBuffer_.buffer, visibility.data(), visibilityBuffer_.size);
+}
+
+void GraphicsEngine::createHiZSampler() {
+	// only texelFetch is used, sampler is required by combined image sampler descriptors
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.anisotropyEnable = VK_FALSE;
+	samplerInfo.maxAnisotropy = 1.0f;
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.mipLodBias = 0.0f;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = static_cast<float>(maxHiZLevels);
+
+	VK_CHECK(vkCreateSampler(device_, &samplerInfo, allocator, &hiZSampler_));
+}
+
+void GraphicsEngine::createHiZDescriptorSetLayouts() {
+	VkDescriptorSetLayoutBinding sourceLayoutBinding{};
+	sourceLayoutBinding.binding = 0;
+	sourceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	sourceLayoutBinding.descriptorCount = 1;
+	sourceLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutBinding destinationLayoutBinding{};
+	destinationLayoutBinding.binding = 1;
+	destinationLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	destinationLayoutBinding.descriptorCount = 1;
+	destinationLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{ sourceLayoutBinding, destinationLayoutBinding };
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<std::uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	VK_CHECK(vkCreateDescriptorSetLayout(device_, &layoutInfo, allocator, &hiZBuildDescriptorSetLayout_));
+
+	// cull pass only samples whole pyramid
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &sourceLayoutBinding;
+
+	VK_CHECK(vkCreateDescriptorSetLayout(device_, &layoutInfo, allocator, &hiZCullDescriptorSetLayout_));
+}
+
+void GraphicsEngine::createHiZDescriptorPool() {
+	constexpr std::uint32_t pyramidCount = hiZPyramidCapacity;
+
+	VkDescriptorPoolSize samplerPoolSize{};
+	samplerPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	samplerPoolSize.descriptorCount = (maxHiZLevels + 1) * pyramidCount;
+
+	VkDescriptorPoolSize storagePoolSize{};
+	storagePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	storagePoolSize.descriptorCount = maxHiZLevels * pyramidCount;
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes{ samplerPoolSize, storagePoolSize };
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	poolInfo.poolSizeCount = static_cast<std::uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = (maxHiZLevels + 1) * pyramidCount;
+
+	VK_CHECK(vkCreateDescriptorPool(device_, &poolInfo, allocator, &hiZDescriptorPool_));
+}
+
+void GraphicsEngine::createHiZPyramid() {
+	auto& pyramid = hiZPyramid_;
+	const auto& desc = renderGraph_.imageDesc(renderGraphNodes_.hiZ);
+	auto image = renderGraph_.image(renderGraphNodes_.hiZ);
+	pyramid.size = desc.size;
+	pyramid.mipLevels = desc.mipLevels;
+
+	// without occlusion culling only cull set exists (bound, never sampled), depth is not sampleable then
+	auto buildLevels = occlusionCulling_ ? pyramid.mipLevels : 0;
+
+	pyramid.mipViews.resize(buildLevels);
+	for (std::uint32_t level = 0; level < buildLevels; ++level) {
+		createImageView2D(image, VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R32_SFLOAT, { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 }, pyramid.mipViews[level]);
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(buildLevels, hiZBuildDescriptorSetLayout_);
+	layouts.push_back(hiZCullDescriptorSetLayout_);
+
+	VkDescriptorSetAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = hiZDescriptorPool_;
+	allocateInfo.descriptorSetCount = static_cast<std::uint32_t>(layouts.size());
+	allocateInfo.pSetLayouts = layouts.data();
+
+	std::vector<VkDescriptorSet> descriptorSets(layouts.size());
+	VK_CHECK(vkAllocateDescriptorSets(device_, &allocateInfo, descriptorSets.data()));
+	pyramid.cullDescriptorSet = descriptorSets.back();
+	descriptorSets.pop_back();
+	pyramid.buildDescriptorSets = std::move(descriptorSets);
+
+	// layouts render graph puts them in: pyramid GENERAL (storage usages), depth read only (DepthRead)
+	std::vector<VkDescriptorImageInfo> sourceInfos(buildLevels + 1);
+	std::vector<VkDescriptorImageInfo> destinationInfos(buildLevels);
+	std::vector<VkWriteDescriptorSet> descriptorWrites{};
+	for (std::uint32_t level = 0; level < buildLevels; ++level) {
+		sourceInfos[level].imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+		sourceInfos[level].imageView = level == 0 ? renderGraph_.imageView(renderGraphNodes_.depth) : pyramid.mipViews[level - 1];
+		sourceInfos[level].sampler = hiZSampler_;
+
+		destinationInfos[level].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		destinationInfos[level].imageView = pyramid.mipViews[level];
+		destinationInfos[level].sampler = VK_NULL_HANDLE;
+
+		VkWriteDescriptorSet sourceWrite{};
+		sourceWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		sourceWrite.dstSet = pyramid.buildDescriptorSets[level];
+		sourceWrite.dstBinding = 0;
+		sourceWrite.dstArrayElement = 0;
+		sourceWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		sourceWrite.descriptorCount = 1;
+		sourceWrite.pImageInfo = &sourceInfos[level];
+		descriptorWrites.push_back(sourceWrite);
+
+		VkWriteDescriptorSet destinationWrite{};
+		destinationWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		destinationWrite.dstSet = pyramid.buildDescriptorSets[level];
+		destinationWrite.dstBinding = 1;
+		destinationWrite.dstArrayElement = 0;
+		destinationWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		destinationWrite.descriptorCount = 1;
+		destinationWrite.pImageInfo = &destinationInfos[level];
+		descriptorWrites.push_back(destinationWrite);
+	}
+
+	sourceInfos.back().imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	sourceInfos.back().imageView = renderGraph_.imageView(renderGraphNodes_.hiZ);
+	sourceInfos.back().sampler = hiZSampler_;
+
+	VkWriteDescriptorSet cullWrite{};
+	cullWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	cullWrite.dstSet = pyramid.cullDescriptorSet;
+	cullWrite.dstBinding = 0;
+	cullWrite.dstArrayElement = 0;
+	cullWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	cullWrite.descriptorCount = 1;
+	cullWrite.pImageInfo = &sourceInfos.back();
+	descriptorWrites.push_back(cullWrite);
+
+	vkUpdateDescriptorSets(device_, static_cast<std::uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+void GraphicsEngine::destroyHiZPyramid(const HiZPyramid& pyramid) {
+	std::vector<VkDescriptorSet> descriptorSets(pyramid.buildDescriptorSets);
+	descriptorSets.push_back(pyramid.cullDescriptorSet);
+	VK_CHECK(vkFreeDescriptorSets(device_, hiZDescriptorPool_, static_cast<std::uint32_t>(descriptorSets.size()), descriptorSets.data()));
+
+	for (auto imageView : pyramid.mipViews) vkDestroyImageView(device_, imageView, allocator);
+}
+
+void GraphicsEngine::createDefaultPipelineLayout() {
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &defaultDescriptorSetLayout_;
+
+	// bindless: material index per draw
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(std::uint32_t);
+
+	if (bindless_) {
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushConstantRange;
+	}
+
+	VK_CHECK(vkCreatePipelineLayout(device_, &layoutInfo, allocator, &defaultPipelineLayout_));
+}
+
+GraphicsPipelineDesc GraphicsEngine::pipelineDesc(VkShaderModule vertexShaderModule, VkShaderModule fragmentShaderModule, VkPipelineLayout pipelineLayout, const PipelineState& state) {
+	GraphicsPipelineDesc desc{};
+	desc.vertexShader = vertexShaderModule;
+	desc.fragmentShader = fragmentShaderModule;
+	desc.layout = pipelineLayout;
+	desc.colorFormat = desiredFormat;
+	desc.depthFormat = desiredDepthFormat;
+	desc.samples = VK_SAMPLE_COUNT_1_BIT;
+	desc.cullMode = VK_CULL_MODE_NONE;
+	desc.depthCompareOp = state.depthCompareOp;
+	desc.depthWrite = state.depthWrite;
+	desc.blend = state.blend;
+
+	return desc;
+}
+
+VkResult GraphicsEngine::createGraphicsPipeline(const GraphicsPipelineDesc& desc, VkRenderPass renderPass, VkPipeline& pipeline) {
+	std::array<VkPipelineShaderStageCreateInfo, 2> stageInfo{};
+	stageInfo[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stageInfo[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	stageInfo[0].module = desc.vertexShader;
+	stageInfo[0].pName = "main";
+	stageInfo[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stageInfo[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	stageInfo[1].module = desc.fragmentShader;
+	stageInfo[1].pName = "main";
+
+	std::array<VkSpecializationMapEntry, std::tuple_size_v<decltype(desc.specialization)>> specializationEntries{};
+	for (std::uint32_t i = 0; i < desc.specializationCount; ++i) {
+		specializationEntries[i].constantID = i;
+		specializationEntries[i].offset = sizeof(std::uint32_t) * i;
+		specializationEntries[i].size = sizeof(std::uint32_t);
+	}
+
+	VkSpecializationInfo specializationInfo{};
+	specializationInfo.mapEntryCount = desc.specializationCount;
+	specializationInfo.pMapEntries = specializationEntries.data();
+	specializationInfo.dataSize = sizeof(std::uint32_t) * desc.specializationCount;
+	specializationInfo.pData = desc.specialization.data();
+	if (desc.specializationCount != 0) stageInfo[1].pSpecializationInfo = &specializationInfo;
+
+	std::array<VkVertexInputBindingDescription, 1> inputBindingDesc = {
+	VkVertexInputBindingDescription{0, sizeof(PMX_Vertex), VK_VERTEX_INPUT_RATE_VERTEX},
+	};
+
+	std::array<VkVertexInputAttributeDescription, 10> inputAttributeDesc = {
+		VkVertexInputAttributeDescription{0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(PMX_Vertex, position)},
+		VkVertexInputAttributeDescription{1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(PMX_Vertex, normal)},
+		VkVertexInputAttributeDescription{2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(PMX_Vertex, uv)},
+		VkVertexInputAttributeDescription{3, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(PMX_Vertex, additionalUV[0])},
+		VkVertexInputAttributeDescription{4, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(PMX_Vertex, additionalUV[1])},
+		VkVertexInputAttributeDescription{5, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(PMX_Vertex, additionalUV[2])},
+		VkVertexInputAttributeDescription{6, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(PMX_Vertex, additionalUV[3])},
+		VkVertexInputAttributeDescription{7, 0, VK_FORMAT_R32G32B32A32_SINT, offsetof(PMX_Vertex, boneIndices)},
+		VkVertexInputAttributeDescription{8, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(PMX_Vertex, boneWeights)},
+		VkVertexInputAttributeDescription{9, 0, VK_FORMAT_R32_SFLOAT, offsetof(PMX_Vertex, edgeMult)},
+	};
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<std::uint32_t>(inputBindingDesc.size());
+	vertexInputInfo.pVertexBindingDescriptions = inputBindingDesc.data();
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<std::uint32_t>(inputAttributeDesc.size());
+	vertexInputInfo.pVertexAttributeDescriptions = inputAttributeDesc.data();
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo{};
+	inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	// viewport and scissor are dynamic (see setViewport), so resize does not rebuild pipeline
+	VkPipelineViewportStateCreateInfo viewportInfo{};
+	viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportInfo.viewportCount = 1;
+	viewportInfo.pViewports = nullptr;
+	viewportInfo.scissorCount = 1;
+	viewportInfo.pScissors = nullptr;
+
+	VkPipelineRasterizationStateCreateInfo rasterizationInfo{};
+	rasterizationInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizationInfo.depthClampEnable = VK_FALSE;
 	rasterizationInfo.rasterizerDiscardEnable = VK_FALSE;
 	rasterizationInfo.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
+	// PMX faces are clockwise in its left handed space, counter clockwise as seen through our camera
+	rasterizationInfo.cullMode = desc.cullMode;
 	rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 	rasterizationInfo.depthBiasEnable = VK_FALSE;
 	rasterizationInfo.lineWidth = 1.0f;
 
 	VkPipelineMultisampleStateCreateInfo multisampleInfo{};
 	multisampleInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	multisampleInfo.rasterizationSamples = desc.samples;
 	multisampleInfo.sampleShadingEnable = VK_FALSE;
 	multisampleInfo.alphaToCoverageEnable = VK_FALSE;
 	multisampleInfo.alphaToOneEnable = VK_FALSE;
 
+	// depth only -> vertex stage alone, color attachment untouched
+	bool depthOnly = desc.fragmentShader == VK_NULL_HANDLE;
+
 	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-	colorBlendAttachment.blendEnable = VK_TRUE;
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_A_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_R_BIT;
+	colorBlendAttachment.blendEnable = desc.blend;
+	colorBlendAttachment.colorWriteMask = depthOnly ? 0 : VK_COLOR_COMPONENT_A_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_R_BIT;
 	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
 	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
 	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
@@ -885,21 +1815,23 @@ void GraphicsEngine::createDefaultGraphicsPipeline() {
 	VkPipelineDepthStencilStateCreateInfo depthStencilInfo{};
 	depthStencilInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 	depthStencilInfo.depthTestEnable = VK_TRUE;
-	depthStencilInfo.depthWriteEnable = VK_TRUE;
-	depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+	depthStencilInfo.depthWriteEnable = desc.depthWrite;
+	depthStencilInfo.depthCompareOp = desc.depthCompareOp;
 	depthStencilInfo.depthBoundsTestEnable = VK_FALSE;
 	depthStencilInfo.minDepthBounds = 0.0f;
 	depthStencilInfo.maxDepthBounds = 1.0f;
 	depthStencilInfo.stencilTestEnable = VK_FALSE;
 
+	std::array<VkDynamicState, 2> dynamicStates{ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
 	VkPipelineDynamicStateCreateInfo dynamicInfo{};
 	dynamicInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicInfo.dynamicStateCount = 0;
-	dynamicInfo.pDynamicStates = nullptr;
+	dynamicInfo.dynamicStateCount = static_cast<std::uint32_t>(dynamicStates.size());
+	dynamicInfo.pDynamicStates = dynamicStates.data();
 
 	VkGraphicsPipelineCreateInfo graphicsPipelineInfo{};
 	graphicsPipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	graphicsPipelineInfo.stageCount = static_cast<std::uint32_t>(stageInfo.size());
+	graphicsPipelineInfo.stageCount = depthOnly ? 1 : static_cast<std::uint32_t>(stageInfo.size());
 	graphicsPipelineInfo.pStages = stageInfo.data();
 	graphicsPipelineInfo.pVertexInputState = &vertexInputInfo;
 	graphicsPipelineInfo.pInputAssemblyState = &inputAssemblyInfo;
@@ -909,135 +1841,928 @@ void GraphicsEngine::createDefaultGraphicsPipeline() {
 	graphicsPipelineInfo.pColorBlendState = &colorBlendInfo;
 	graphicsPipelineInfo.pDepthStencilState = &depthStencilInfo;
 	graphicsPipelineInfo.pDynamicState = &dynamicInfo;
-	graphicsPipelineInfo.layout = defaultPipelineLayout_;
-	graphicsPipelineInfo.renderPass = defaultRenderPass_;
+	graphicsPipelineInfo.layout = desc.layout;
+	// compatible with render graph's passes (same attachment formats), so they survive graph rebuilds
+	graphicsPipelineInfo.renderPass = renderPass;
 	graphicsPipelineInfo.subpass = 0;
 
-	VK_CHECK(vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &graphicsPipelineInfo, allocator, &defaultGraphicsPipeline_));
+	return pipelineCache_.createGraphicsPipeline(graphicsPipelineInfo, pipeline);
 }
 
-void GraphicsEngine::createCommandPool() {
-	VkCommandPoolCreateInfo commandPoolInfo{};
-	commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	commandPoolInfo.queueFamilyIndex = queueFamilyIndex_;
-	commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+std::uint32_t GraphicsEngine::sphereMode(const PMX_Material& material) {
+	// PMX: 0 none, 1 multiply, 2 add, 3 sub texture (additional uv, not supported)
+	if (material.sphereIndex < 0 || material.sphereMode > 2) return 0;
 
-	VK_CHECK(vkCreateCommandPool(device_, &commandPoolInfo, allocator, &commandPool_));
+	return material.sphereMode;
 }
 
-void GraphicsEngine::createCommandBuffer() {
-	VkCommandBufferAllocateInfo commandBufferInfo{};
-	commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	commandBufferInfo.commandPool = commandPool_;
-	commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	commandBufferInfo.commandBufferCount = 1;
+std::uint32_t GraphicsEngine::materialFeatures(const PMX_Material& material) {
+	std::uint32_t features = sphereMode(material) << sphereModeShift;
+	if (material.textureIndex >= 0) features |= textureFeature;
+	if (material.toonIndex >= 0) features |= toonFeature;
 
-	VK_CHECK(vkAllocateCommandBuffers(device_, &commandBufferInfo, &commandBuffer_));
+	return features;
 }
 
-void GraphicsEngine::createFence() {
-	VkFenceCreateInfo fenceInfo{};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-
-	VK_CHECK(vkCreateFence(device_, &fenceInfo, allocator, &fence_));
+void GraphicsEngine::buildForwardPasses() {
+	forwardPasses_.clear();
+	if (depthPrepass_) {
+		// prepass leaves nearest opaque depth, shading pass runs fragment shader once per pixel
+		forwardPasses_.push_back(ForwardPass{ RenderQueue::Pass::Depth, PipelineState{ VK_COMPARE_OP_LESS, VK_TRUE, VK_FALSE } });
+		forwardPasses_.push_back(ForwardPass{ RenderQueue::Pass::Opaque, PipelineState{ VK_COMPARE_OP_EQUAL, VK_FALSE, VK_FALSE } });
+	}
+	else {
+		forwardPasses_.push_back(ForwardPass{ RenderQueue::Pass::Opaque, PipelineState{ VK_COMPARE_OP_LESS, VK_TRUE, VK_FALSE } });
+	}
+	// sorted back to front, tested against opaque depth but not written (later layers stay visible)
+	forwardPasses_.push_back(ForwardPass{ RenderQueue::Pass::Transparent, PipelineState{ VK_COMPARE_OP_LESS, VK_FALSE, VK_TRUE } });
 }
 
-void GraphicsEngine::acquireNextImage() {
-	VK_CHECK(vkAcquireNextImageKHR(device_, swapchain_, UINT64_MAX, VK_NULL_HANDLE, fence_, &currentFrameIndex_));
-	VK_CHECK(vkWaitForFences(device_, 1, &fence_, VK_TRUE, UINT64_MAX));
-	VK_CHECK(vkResetFences(device_, 1, &fence_));
+void GraphicsEngine::createForwardPipelines() {
+	for (auto& pipelines : passPipelines_) pipelines.fill(PipelineManager::invalidId);
+	materialPipelines_.assign(materials_.size(), PipelineManager::invalidId);
+	for (const auto& forwardPass : forwardPasses_) {
+		bool depthOnly = forwardPass.pass == RenderQueue::Pass::Depth;
+
+		// generic variant draws every material correctly, first frame waits for it
+		auto desc = pipelineDesc(depthOnly ? depthVertexShaderModule_ : vertexShaderModule_, depthOnly ? VK_NULL_HANDLE : fragmentShaderModule_, defaultPipelineLayout_, forwardPass.state);
+		auto generic = pipelineManager_.request(desc);
+		if (!pipelineManager_.isReady(generic)) {
+			std::cerr << "[createForwardPipelines] failed to create generic pipeline" << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		passPipelines_[static_cast<std::uint32_t>(forwardPass.pass)][0] = generic;
+
+		if (depthOnly) {
+			desc.cullMode = VK_CULL_MODE_BACK_BIT;
+			passPipelines_[static_cast<std::uint32_t>(forwardPass.pass)][1] = pipelineManager_.request(desc, generic);
+			continue;
+		}
+
+		// minimal variant per material, materials with same features and cull mode share it
+		desc.specializationCount = 1;
+		for (auto i = 0; i < materials_.size(); ++i) {
+			auto pass = transparentMaterials_[i] ? RenderQueue::Pass::Transparent : RenderQueue::Pass::Opaque;
+			if (pass != forwardPass.pass) continue;
+
+			desc.cullMode = (materials_[i].flags & doubleSidedFlag) ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+			desc.specialization[0] = materialFeatures(materials_[i]);
+			materialPipelines_[i] = pipelineManager_.request(desc, generic);
+		}
+	}
 }
 
-void GraphicsEngine::beginCommand() {
-	VkCommandBufferInheritanceInfo inheritanceInfo{};
-	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
-	inheritanceInfo.framebuffer = defaultFramebuffers_[currentFrameIndex_];
+void GraphicsEngine::createIndirectPipelineLayout() {
+	// set 0: bindless set (transform, materials, textures, bones), set 1: draw records
+	std::array<VkDescriptorSetLayout, 2> setLayouts{ defaultDescriptorSetLayout_, indirectDescriptorSetLayout_ };
+
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = static_cast<std::uint32_t>(setLayouts.size());
+	layoutInfo.pSetLayouts = setLayouts.data();
+
+	VK_CHECK(vkCreatePipelineLayout(device_, &layoutInfo, allocator, &indirectPipelineLayout_));
+}
+
+void GraphicsEngine::createCullPipeline() {
+	// set 0: indirect set, set 1: Hi-Z, push constant: phase
+	std::array<VkDescriptorSetLayout, 2> setLayouts{ indirectDescriptorSetLayout_, hiZCullDescriptorSetLayout_ };
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(std::uint32_t);
+
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = static_cast<std::uint32_t>(setLayouts.size());
+	layoutInfo.pSetLayouts = setLayouts.data();
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	VK_CHECK(vkCreatePipelineLayout(device_, &layoutInfo, allocator, &cullPipelineLayout_));
+
+	VkPipelineShaderStageCreateInfo stageInfo{};
+	stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	stageInfo.module = cullShaderModule_;
+	stageInfo.pName = "main";
+
+	// maxDraws: stride between early and late command arrays
+	VkSpecializationMapEntry specializationEntry{ 0, 0, sizeof(std::uint32_t) };
+
+	VkSpecializationInfo specializationInfo{};
+	specializationInfo.mapEntryCount = 1;
+	specializationInfo.pMapEntries = &specializationEntry;
+	specializationInfo.dataSize = sizeof(std::uint32_t);
+	specializationInfo.pData = &indirectDrawCapacity_;
+	stageInfo.pSpecializationInfo = &specializationInfo;
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = stageInfo;
+	pipelineInfo.layout = cullPipelineLayout_;
+
+	VK_CHECK(pipelineCache_.createComputePipeline(pipelineInfo, cullPipeline_));
+}
+
+void GraphicsEngine::createHiZPipeline() {
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &hiZBuildDescriptorSetLayout_;
+
+	VK_CHECK(vkCreatePipelineLayout(device_, &layoutInfo, allocator, &hiZPipelineLayout_));
+
+	VkPipelineShaderStageCreateInfo stageInfo{};
+	stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	stageInfo.module = hiZShaderModule_;
+	stageInfo.pName = "main";
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = stageInfo;
+	pipelineInfo.layout = hiZPipelineLayout_;
+
+	VK_CHECK(pipelineCache_.createComputePipeline(pipelineInfo, hiZPipeline_));
+}
+
+void GraphicsEngine::createCommandPool() {
+	VkCommandPoolCreateInfo commandPoolInfo{};
+	commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolInfo.queueFamilyIndex = queueFamilyIndex_;
+	commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	VK_CHECK(vkCreateCommandPool(device_, &commandPoolInfo, allocator, &commandPool_));
+}
+
+void GraphicsEngine::createCommandBuffer() {
+	VkCommandBufferAllocateInfo commandBufferInfo{};
+	commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	commandBufferInfo.commandPool = commandPool_;
+	commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferInfo.commandBufferCount = 1;
+
+	VK_CHECK(vkAllocateCommandBuffers(device_, &commandBufferInfo, &commandBuffer_));
+}
+
+void GraphicsEngine::createFrames() {
+	for (std::uint32_t i = 0; i < framesInFlight_; ++i) {
+		auto& frame = frames_[i];
+
+		// whole pool is reset at frame begin
+		VkCommandPoolCreateInfo commandPoolInfo{};
+		commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		commandPoolInfo.queueFamilyIndex = queueFamilyIndex_;
+		commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		VK_CHECK(vkCreateCommandPool(device_, &commandPoolInfo, allocator, &frame.commandPool));
+
+		VkCommandBufferAllocateInfo commandBufferInfo{};
+		commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBufferInfo.commandPool = frame.commandPool;
+		commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferInfo.commandBufferCount = 1;
+
+		VK_CHECK(vkAllocateCommandBuffers(device_, &commandBufferInfo, &frame.commandBuffer));
+
+		// first wait on each frame returns immediately
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+		VK_CHECK(vkCreateFence(device_, &fenceInfo, allocator, &frame.fence));
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		VK_CHECK(vkCreateSemaphore(device_, &semaphoreInfo, allocator, &frame.imageAvailableSemaphore));
+
+		frame.timestampQueryPool = VK_NULL_HANDLE;
+		frame.timestampsWritten = false;
+		if (properties_.limits.timestampComputeAndGraphics) {
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = 2;
+
+			VK_CHECK(vkCreateQueryPool(device_, &queryPoolInfo, allocator, &frame.timestampQueryPool));
+		}
+	}
+
+	frameIndex_ = 0;
+	resetFrameTimings();
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	VK_CHECK(vkCreateFence(device_, &fenceInfo, allocator, &framePacing_.acquireFence));
+
+	framePacing_.refreshMilliseconds = 0.0;
+	framePacing_.cpuMilliseconds = 0.0;
+	framePacing_.gpuMilliseconds = 0.0;
+	framePacing_.imageAcquired = false;
+	inputSampleTime_ = std::chrono::steady_clock::now();
+}
+
+void GraphicsEngine::createRecordCommandBuffers() {
+	// only grows, pools of unused threads stay empty
+	for (std::uint32_t i = 0; i < framesInFlight_; ++i) {
+		auto& frame = frames_[i];
 
+		while (frame.recordCommandPools.size() < recordThreadCount_) {
+			VkCommandPoolCreateInfo commandPoolInfo{};
+			commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			commandPoolInfo.queueFamilyIndex = queueFamilyIndex_;
+			commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+			VkCommandPool commandPool{};
+			VK_CHECK(vkCreateCommandPool(device_, &commandPoolInfo, allocator, &commandPool));
+
+			VkCommandBufferAllocateInfo commandBufferInfo{};
+			commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			commandBufferInfo.commandPool = commandPool;
+			commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			commandBufferInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer{};
+			VK_CHECK(vkAllocateCommandBuffers(device_, &commandBufferInfo, &commandBuffer));
+
+			frame.recordCommandPools.push_back(commandPool);
+			frame.secondaryCommandBuffers.push_back(commandBuffer);
+		}
+	}
+}
+
+void GraphicsEngine::applyRecordThreads(std::uint32_t count) {
+	recordThreadCount_ = std::clamp(count, 1u, maxRecordThreads);
+
+	// one worker per record slice, main thread is one of them
+	if (!jobSystem_ || jobSystem_->threadCount() != recordThreadCount_) {
+		jobSystem_ = std::make_unique<JobSystem>(recordThreadCount_);
+	}
+
+	if (recordThreadCount_ > 1) createRecordCommandBuffers();
+}
+
+void GraphicsEngine::calibrateTimestamps() {
+	if (!properties_.limits.timestampComputeAndGraphics) return;
+
+	// timestamp of an otherwise idle queue ~ time the CPU sees it complete (error is wake up latency)
+	auto queryPool = frames_[0].timestampQueryPool;
+	submitCommandsOnce([&]() {
+		vkCmdResetQueryPool(commandBuffer_, queryPool, 0, 2);
+		vkCmdWriteTimestamp(commandBuffer_, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 0);
+	});
+	timestampCalibration_.cpuTime = std::chrono::steady_clock::now();
+
+	VK_CHECK(vkGetQueryPoolResults(device_, queryPool, 0, 1, sizeof(std::uint64_t), &timestampCalibration_.gpuTimestamp, sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+}
+
+void GraphicsEngine::createRenderFinishedSemaphores() {
+	// present of image i waits on semaphore i, which is signaled again only after image i is re-acquired
+	renderFinishedSemaphores_.resize(defaultImages_.size());
+	for (auto& semaphore : renderFinishedSemaphores_) {
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		VK_CHECK(vkCreateSemaphore(device_, &semaphoreInfo, allocator, &semaphore));
+	}
+}
+
+void GraphicsEngine::createUploadCommandPool() {
+	VkCommandPoolCreateInfo commandPoolInfo{};
+	commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolInfo.queueFamilyIndex = transferQueueFamilyIndex_;
+	commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	VK_CHECK(vkCreateCommandPool(device_, &commandPoolInfo, allocator, &uploadCommandPool_));
+
+	uploadSerial_ = 0;
+	completedUploadSerial_ = 0;
+}
+
+void GraphicsEngine::createUploadBatch(UploadBatch& batch) {
+	VkCommandBufferAllocateInfo commandBufferInfo{};
+	commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	commandBufferInfo.commandPool = uploadCommandPool_;
+	commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferInfo.commandBufferCount = 1;
+
+	VK_CHECK(vkAllocateCommandBuffers(device_, &commandBufferInfo, &batch.transferCommandBuffer));
+
+	batch.graphicsCommandBuffer = VK_NULL_HANDLE;
+	batch.transferSemaphore = VK_NULL_HANDLE;
+	if (transferQueueFamilyIndex_ != queueFamilyIndex_) {
+		commandBufferInfo.commandPool = commandPool_;
+		VK_CHECK(vkAllocateCommandBuffers(device_, &commandBufferInfo, &batch.graphicsCommandBuffer));
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		VK_CHECK(vkCreateSemaphore(device_, &semaphoreInfo, allocator, &batch.transferSemaphore));
+	}
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	VK_CHECK(vkCreateFence(device_, &fenceInfo, allocator, &batch.fence));
+}
+
+bool GraphicsEngine::acquireNextImage() {
+	// already acquired by paceFrame
+	if (framePacing_.imageAcquired) {
+		framePacing_.imageAcquired = false;
+		return true;
+	}
+
+	for (;;) {
+		if (swapchainOutdated_ && !recreateSwapchain()) return false;
+
+		// GPU waits for image (imageAvailableSemaphore), CPU does not
+		auto result = vkAcquireNextImageKHR(device_, swapchain_, UINT64_MAX, frames_[frameIndex_].imageAvailableSemaphore, VK_NULL_HANDLE, &currentFrameIndex_);
+
+		// nothing acquired, semaphore stays unsignaled
+		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+			swapchainOutdated_ = true;
+			continue;
+		}
+
+		// image is acquired (semaphore will signal) and still presentable, recreate after this frame
+		if (result == VK_SUBOPTIMAL_KHR) swapchainOutdated_ = true;
+		else if (result != VK_SUCCESS) {
+			// device / surface lost or timeout -> no image, waiting on semaphore would hang
+			std::cerr << "[acquireNextImage] failed to acquire swapchain image. error code: " << result << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+
+		return true;
+	}
+}
+
+void GraphicsEngine::beginCommand() {
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.pInheritanceInfo = &inheritanceInfo;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-	VK_CHECK(vkBeginCommandBuffer(commandBuffer_, &beginInfo));
+	VK_CHECK(vkBeginCommandBuffer(frames_[frameIndex_].commandBuffer, &beginInfo));
 }
 
 void GraphicsEngine::endCommand() {
-	vkEndCommandBuffer(commandBuffer_);
+	vkEndCommandBuffer(frames_[frameIndex_].commandBuffer);
 }
 
 void GraphicsEngine::submitCommands() {
-	VkPipelineStageFlags waitStageFlags = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	auto& frame = frames_[frameIndex_];
+
+	// only color output has to wait for presentation engine to release image
+	VkPipelineStageFlags waitStageFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.pWaitSemaphores = &frame.imageAvailableSemaphore;
+	submitInfo.pWaitDstStageMask = &waitStageFlags;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &frame.commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &renderFinishedSemaphores_[currentFrameIndex_];
+
+	VK_CHECK(vkQueueSubmit(deviceQueue_, 1, &submitInfo, frame.fence));
+}
+
+template<typename Func>
+void GraphicsEngine::submitCommandsOnce(Func func) {
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VK_CHECK(vkBeginCommandBuffer(commandBuffer_, &beginInfo));
+
+	func();
 
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer_;
-	submitInfo.pWaitDstStageMask = &waitStageFlags;
 
-	VK_CHECK(vkQueueSubmit(deviceQueue_, 1, &submitInfo, fence_));
+	VK_CHECK(vkQueueSubmit(deviceQueue_, 1, &submitInfo, VK_NULL_HANDLE));
+	VK_CHECK(vkQueueWaitIdle(deviceQueue_));
+
+	VK_CHECK(vkResetCommandBuffer(commandBuffer_, 0));
+}
+
+void GraphicsEngine::present() {
+	VkPresentInfoKHR presentInfo{};
+	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	presentInfo.waitSemaphoreCount = 1;
+	presentInfo.pWaitSemaphores = &renderFinishedSemaphores_[currentFrameIndex_];
+	presentInfo.swapchainCount = 1;
+	presentInfo.pSwapchains = &swapchain_;
+	presentInfo.pImageIndices = &currentFrameIndex_;
+
+	auto result = vkQueuePresentKHR(deviceQueue_, &presentInfo);
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) swapchainOutdated_ = true;
+	else if (result != VK_SUCCESS) {
+		std::cerr << "[present] failed to present swapchain image. error code: " << result << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+}
+
+std::size_t GraphicsEngine::reserveStagingData(std::size_t size) {
+	// buffer offset must be multiple of texel block size (4 for RGBA8, 8 or 16 for BCn)
+	auto alignment = std::max<std::size_t>(static_cast<std::size_t>(properties_.limits.optimalBufferCopyOffsetAlignment), 16);
+
+	for (;;) {
+		// nothing references ring -> restart at front
+		if (uploadBatches_.empty() && pendingTextureUploads_.empty() && pendingBufferUploads_.empty()) {
+			stagingBuffer_.head = 0;
+			stagingBuffer_.tail = 0;
+		}
+
+		auto offset = (stagingBuffer_.head + alignment - 1) / alignment * alignment;
+
+		// head never catches up with tail (head == tail means empty)
+		if (stagingBuffer_.head >= stagingBuffer_.tail) {
+			if (offset + size <= stagingBuffer_.size) {
+				stagingBuffer_.head = offset + size;
+				return offset;
+			}
+			// rest of ring is skipped, wrap around
+			if (size < stagingBuffer_.tail) {
+				stagingBuffer_.head = size;
+				return 0;
+			}
+		}
+		else if (offset + size < stagingBuffer_.tail) {
+			stagingBuffer_.head = offset + size;
+			return offset;
+		}
+
+		// no room: wait for oldest batch, or put pending copies in flight first
+		if (!uploadBatches_.empty()) {
+			retireUploads(true);
+		}
+		else if (!pendingTextureUploads_.empty() || !pendingBufferUploads_.empty()) {
+			flushUploads();
+		}
+		else {
+			// single upload larger than whole ring
+			destroyStagingBuffer(stagingBuffer_);
+			createStagingBuffer(size, stagingBuffer_);
+		}
+	}
+}
+
+std::size_t GraphicsEngine::stageData(const void* data, std::size_t size) {
+	auto offset = reserveStagingData(size);
+	std::memcpy(stagingBuffer_.pointer + offset, data, size);
+
+	return offset;
+}
+
+void GraphicsEngine::uploadBuffer(VkBuffer buffer, const void* data, std::size_t size) {
+	BufferUpload upload{};
+	upload.buffer = buffer;
+	upload.region.srcOffset = stageData(data, size);
+	upload.region.dstOffset = 0;
+	upload.region.size = size;
+
+	pendingBufferUploads_.push_back(upload);
+}
+
+std::uint64_t GraphicsEngine::flushUploads() {
+	retireUploads(false);
+
+	// everything already in flight
+	if (pendingTextureUploads_.empty() && pendingBufferUploads_.empty()) {
+		return uploadSerial_;
+	}
+
+	UploadBatch batch{};
+	if (freeUploadBatches_.empty()) {
+		createUploadBatch(batch);
+	}
+	else {
+		batch = freeUploadBatches_.back();
+		freeUploadBatches_.pop_back();
+	}
+
+	// dedicated transfer family: copies on transfer queue, buffers and images change owner afterwards
+	bool dedicatedTransfer = transferQueueFamilyIndex_ != queueFamilyIndex_;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	auto commandBuffer = batch.transferCommandBuffer;
+	VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+	auto imageBarrier = [](const TextureUpload& upload, std::uint32_t baseLevel, std::uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = upload.image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, upload.arrayLayers };
+		return barrier;
+	};
+
+	auto bufferBarrier = [](const BufferUpload& upload, VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = upload.buffer;
+		barrier.offset = upload.region.dstOffset;
+		barrier.size = upload.region.size;
+		return barrier;
+	};
+
+	// compute: culling reads and writes uploaded buffers (visibility), indirect: draw arguments
+	constexpr VkAccessFlags bufferReadAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	constexpr VkPipelineStageFlags bufferReadStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+	std::vector<VkImageMemoryBarrier> barriers{};
+	barriers.reserve(pendingTextureUploads_.size() * 2);
+	std::vector<VkBufferMemoryBarrier> bufferBarriers{};
+
+	// UNDEFINED -> TRANSFER_DST (all images in one barrier batch)
+	for (const auto& upload : pendingTextureUploads_) {
+		barriers.push_back(imageBarrier(upload, 0, upload.mipLevels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT));
+	}
+	if (!barriers.empty()) {
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<std::uint32_t>(barriers.size()), barriers.data());
+	}
+
+	for (const auto& upload : pendingBufferUploads_) {
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer_.buffer, upload.buffer, 1, &upload.region);
+	}
+
+	// whole subresources are copied, so any minImageTransferGranularity of transfer family is satisfied
+	std::uint32_t maxGeneratedLevels = 0;
+	for (const auto& upload : pendingTextureUploads_) {
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer_.buffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<std::uint32_t>(upload.regions.size()), upload.regions.data());
+		if (upload.generateMips) maxGeneratedLevels = std::max(maxGeneratedLevels, upload.mipLevels);
+	}
+
+	if (dedicatedTransfer) {
+		// release (transfer queue) and acquire (graphics queue) barriers must match
+		// images stay TRANSFER_DST, blits and final layouts are recorded on graphics queue
+		barriers.clear();
+		for (const auto& upload : pendingTextureUploads_) {
+			auto barrier = imageBarrier(upload, 0, upload.mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, 0);
+			barrier.srcQueueFamilyIndex = transferQueueFamilyIndex_;
+			barrier.dstQueueFamilyIndex = queueFamilyIndex_;
+			barriers.push_back(barrier);
+		}
+		for (const auto& upload : pendingBufferUploads_) {
+			auto barrier = bufferBarrier(upload, VK_ACCESS_TRANSFER_WRITE_BIT, 0);
+			barrier.srcQueueFamilyIndex = transferQueueFamilyIndex_;
+			barrier.dstQueueFamilyIndex = queueFamilyIndex_;
+			bufferBarriers.push_back(barrier);
+		}
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, static_cast<std::uint32_t>(bufferBarriers.size()), bufferBarriers.data(), static_cast<std::uint32_t>(barriers.size()), barriers.data());
+
+		VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+		commandBuffer = batch.graphicsCommandBuffer;
+		VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+		for (auto& barrier : barriers) {
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		}
+		// buffers are ready for drawing right after acquire
+		for (auto& barrier : bufferBarriers) {
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = bufferReadAccess;
+		}
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | bufferReadStages, 0, 0, nullptr, static_cast<std::uint32_t>(bufferBarriers.size()), bufferBarriers.data(), static_cast<std::uint32_t>(barriers.size()), barriers.data());
+	}
+
+	// mip generation: level i - 1 (TRANSFER_SRC) -> level i (TRANSFER_DST)
+	// processed level by level across all images so barriers are batched
+	for (std::uint32_t level = 1; level < maxGeneratedLevels; ++level) {
+		barriers.clear();
+		for (const auto& upload : pendingTextureUploads_) {
+			if (!upload.generateMips || level >= upload.mipLevels) continue;
+			barriers.push_back(imageBarrier(upload, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT));
+		}
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<std::uint32_t>(barriers.size()), barriers.data());
+
+		for (const auto& upload : pendingTextureUploads_) {
+			if (!upload.generateMips || level >= upload.mipLevels) continue;
+
+			VkImageBlit blit{};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, upload.arrayLayers };
+			blit.srcOffsets[1] = { static_cast<std::int32_t>(std::max(1u, upload.size.width >> (level - 1))), static_cast<std::int32_t>(std::max(1u, upload.size.height >> (level - 1))), 1 };
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, upload.arrayLayers };
+			blit.dstOffsets[1] = { static_cast<std::int32_t>(std::max(1u, upload.size.width >> level)), static_cast<std::int32_t>(std::max(1u, upload.size.height >> level)), 1 };
+
+			vkCmdBlitImage(commandBuffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+		}
+	}
+
+	// -> SHADER_READ_ONLY
+	// generated chains: levels [0, n - 1) are TRANSFER_SRC, last level is TRANSFER_DST
+	barriers.clear();
+	for (const auto& upload : pendingTextureUploads_) {
+		if (upload.generateMips) {
+			barriers.push_back(imageBarrier(upload, 0, upload.mipLevels - 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT));
+			barriers.push_back(imageBarrier(upload, upload.mipLevels - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+		}
+		else {
+			barriers.push_back(imageBarrier(upload, 0, upload.mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+		}
+	}
+
+	// buffers: copies -> vertex input / uniform / compute reads (done by acquire barrier on dedicated transfer family)
+	VkMemoryBarrier memoryBarrier{};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = bufferReadAccess;
+
+	std::uint32_t memoryBarrierCount = !dedicatedTransfer && !pendingBufferUploads_.empty() ? 1 : 0;
+	if (memoryBarrierCount != 0 || !barriers.empty()) {
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, bufferReadStages, 0, memoryBarrierCount, &memoryBarrier, 0, nullptr, static_cast<std::uint32_t>(barriers.size()), barriers.data());
+	}
+
+	VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+	// same queue as draw submits -> later frames are ordered after these barriers, no CPU wait
+	if (dedicatedTransfer) {
+		VkSubmitInfo transferSubmitInfo{};
+		transferSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		transferSubmitInfo.commandBufferCount = 1;
+		transferSubmitInfo.pCommandBuffers = &batch.transferCommandBuffer;
+		transferSubmitInfo.signalSemaphoreCount = 1;
+		transferSubmitInfo.pSignalSemaphores = &batch.transferSemaphore;
+
+		VK_CHECK(vkQueueSubmit(transferQueue_, 1, &transferSubmitInfo, VK_NULL_HANDLE));
+
+		VkPipelineStageFlags waitStageFlags = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+		VkSubmitInfo graphicsSubmitInfo{};
+		graphicsSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		graphicsSubmitInfo.waitSemaphoreCount = 1;
+		graphicsSubmitInfo.pWaitSemaphores = &batch.transferSemaphore;
+		graphicsSubmitInfo.pWaitDstStageMask = &waitStageFlags;
+		graphicsSubmitInfo.commandBufferCount = 1;
+		graphicsSubmitInfo.pCommandBuffers = &batch.graphicsCommandBuffer;
+
+		VK_CHECK(vkQueueSubmit(deviceQueue_, 1, &graphicsSubmitInfo, batch.fence));
+	}
+	else {
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.transferCommandBuffer;
+
+		VK_CHECK(vkQueueSubmit(deviceQueue_, 1, &submitInfo, batch.fence));
+	}
+
+	batch.serial = ++uploadSerial_;
+	batch.stagingEnd = stagingBuffer_.head;
+
+	uploadBatches_.push_back(batch);
+
+	pendingTextureUploads_.clear();
+	pendingBufferUploads_.clear();
+
+	return batch.serial;
+}
+
+void GraphicsEngine::retireUploads(bool waitOldest) {
+	// batches complete in submission order, staging is given back from tail
+	while (!uploadBatches_.empty()) {
+		auto& batch = uploadBatches_.front();
+
+		if (waitOldest) {
+			VK_CHECK(vkWaitForFences(device_, 1, &batch.fence, VK_TRUE, UINT64_MAX));
+			waitOldest = false;
+		}
+		else if (vkGetFenceStatus(device_, batch.fence) != VK_SUCCESS) {
+			break;
+		}
+
+		VK_CHECK(vkResetFences(device_, 1, &batch.fence));
+		VK_CHECK(vkResetCommandBuffer(batch.transferCommandBuffer, 0));
+		if (batch.graphicsCommandBuffer != VK_NULL_HANDLE) {
+			VK_CHECK(vkResetCommandBuffer(batch.graphicsCommandBuffer, 0));
+		}
+
+		stagingBuffer_.tail = batch.stagingEnd;
+		completedUploadSerial_ = batch.serial;
+
+		freeUploadBatches_.push_back(batch);
+		uploadBatches_.pop_front();
+	}
+}
+
+void GraphicsEngine::waitUploads(std::uint64_t serial) {
+	while (completedUploadSerial_ < serial && !uploadBatches_.empty()) {
+		retireUploads(true);
+	}
+}
+
+bool GraphicsEngine::beginFrame() {
+	auto& frame = frames_[frameIndex_];
+	frame.inputSampleTime = inputSampleTime_;
+
+	// CPU runs at most framesInFlight_ frames ahead of GPU
+	auto waitBeginTime = std::chrono::steady_clock::now();
+	VK_CHECK(vkWaitForFences(device_, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+	frameCpuBeginTime_ = std::chrono::steady_clock::now();
+	frameTimings_.waitMilliseconds += std::chrono::duration<double, std::milli>(frameCpuBeginTime_ - waitBeginTime).count();
+
+	completedFrameSerial_ = std::max(completedFrameSerial_, frame.serial);
+	destroyRetiredSwapchains();
+
+	readFrameTimestamps(frame);
+
+	VK_CHECK(vkResetCommandPool(device_, frame.commandPool, 0));
+	for (auto commandPool : frame.recordCommandPools) {
+		VK_CHECK(vkResetCommandPool(device_, commandPool, 0));
+	}
+
+	// uploads requested since last frame go out as one batch, finished batches give staging back
+	flushUploads();
+
+	// fence stays signaled, so skipped frame slot is reused as is
+	if (!acquireNextImage()) return false;
+
+	beginCommand();
+	if (frame.timestampQueryPool != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(frame.commandBuffer, frame.timestampQueryPool, 0, 2);
+		vkCmdWriteTimestamp(frame.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.timestampQueryPool, 0);
+	}
+
+	return true;
+}
+
+void GraphicsEngine::endFrame() {
+	auto& frame = frames_[frameIndex_];
+
+	if (frame.timestampQueryPool != VK_NULL_HANDLE) {
+		vkCmdWriteTimestamp(frame.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampQueryPool, 1);
+		frame.timestampsWritten = true;
+	}
+	endCommand();
+
+	// reset right before submit, so an early return never leaves fence unsignaled
+	VK_CHECK(vkResetFences(device_, 1, &frame.fence));
+	frame.serial = ++frameSerial_;
+	submitCommands();
+
+	present();
+
+	auto cpuMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameCpuBeginTime_).count();
+	frameTimings_.cpuMilliseconds += cpuMilliseconds;
+	++frameTimings_.frameCount;
+
+	framePacing_.cpuMilliseconds += (cpuMilliseconds - framePacing_.cpuMilliseconds) * 0.1;
+
+	frameIndex_ = (frameIndex_ + 1) % framesInFlight_;
+}
+
+void GraphicsEngine::waitFrames() {
+	for (std::uint32_t i = 0; i < framesInFlight_; ++i) {
+		VK_CHECK(vkWaitForFences(device_, 1, &frames_[i].fence, VK_TRUE, UINT64_MAX));
+		completedFrameSerial_ = std::max(completedFrameSerial_, frames_[i].serial);
+		readFrameTimestamps(frames_[i]);
+	}
+}
+
+void GraphicsEngine::readFrameTimestamps(Frame& frame) {
+	// fence has signaled, so results are available without waiting
+	if (!frame.timestampsWritten) return;
+	frame.timestampsWritten = false;
+
+	std::array<std::uint64_t, 2> timestamps{};
+	if (vkGetQueryPoolResults(device_, frame.timestampQueryPool, 0, 2, sizeof(timestamps), timestamps.data(), sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) return;
+
+	auto period = static_cast<double>(properties_.limits.timestampPeriod);
+	auto gpuMilliseconds = (timestamps[1] - timestamps[0]) * period * 1e-6;
+	frameTimings_.gpuMilliseconds += gpuMilliseconds;
+	++frameTimings_.gpuFrameCount;
+
+	framePacing_.gpuMilliseconds += (gpuMilliseconds - framePacing_.gpuMilliseconds) * 0.1;
+
+	// end of GPU work on CPU clock -> time since input was sampled
+	auto endOffset = std::chrono::nanoseconds(static_cast<std::int64_t>((static_cast<std::int64_t>(timestamps[1] - timestampCalibration_.gpuTimestamp)) * period));
+	auto latencyMilliseconds = std::chrono::duration<double, std::milli>(timestampCalibration_.cpuTime + endOffset - frame.inputSampleTime).count();
+	frameTimings_.latencyMilliseconds += latencyMilliseconds;
+	frameTimings_.maxLatencyMilliseconds = std::max(frameTimings_.maxLatencyMilliseconds, latencyMilliseconds);
 }
 
-template<typename Func>
-void GraphicsEngine::submitCommandsOnce(Func func) {
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+void GraphicsEngine::paceFrame() {
+	if (!presentSettings_.lowLatency) {
+		inputSampleTime_ = std::chrono::steady_clock::now();
+		return;
+	}
 
-	VK_CHECK(vkBeginCommandBuffer(commandBuffer_, &beginInfo));
+	// nothing queued on GPU, input sampled below is shown by the very next frame
+	waitFrames();
 
-	func();
+	destroyRetiredSwapchains();
+	if (swapchainOutdated_ && !recreateSwapchain()) {
+		// e.g. minimized, next latency sample must not start from stale time
+		inputSampleTime_ = std::chrono::steady_clock::now();
+		return;
+	}
 
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer_;
+	// with 2 images, acquire completes when previous frame flips to screen (start of refresh)
+	auto result = vkAcquireNextImageKHR(device_, swapchain_, UINT64_MAX, frames_[frameIndex_].imageAvailableSemaphore, framePacing_.acquireFence, &currentFrameIndex_);
+	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+		// beginFrame recreates and acquires without pacing
+		swapchainOutdated_ = true;
+		inputSampleTime_ = std::chrono::steady_clock::now();
+		return;
+	}
+	if (result == VK_SUBOPTIMAL_KHR) swapchainOutdated_ = true;
+	else if (result != VK_SUCCESS) {
+		std::cerr << "[paceFrame] failed to acquire swapchain image. error code: " << result << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
 
-	VK_CHECK(vkQueueSubmit(deviceQueue_, 1, &submitInfo, VK_NULL_HANDLE));
-	VK_CHECK(vkQueueWaitIdle(deviceQueue_));
+	VK_CHECK(vkWaitForFences(device_, 1, &framePacing_.acquireFence, VK_TRUE, UINT64_MAX));
+	VK_CHECK(vkResetFences(device_, 1, &framePacing_.acquireFence));
+	framePacing_.imageAcquired = true;
 
-	VK_CHECK(vkResetCommandBuffer(commandBuffer_, 0));
-}
+	auto releaseTime = std::chrono::steady_clock::now();
+	auto interval = std::chrono::duration<double, std::milli>(releaseTime - framePacing_.imageReleaseTime).count();
+	framePacing_.imageReleaseTime = releaseTime;
 
-void GraphicsEngine::present() {
-	VkPresentInfoKHR presentInfo{};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = &swapchain_;
-	presentInfo.pImageIndices = &currentFrameIndex_;
+	// refresh period: ignore hitches (missed refresh, window moves, first frame)
+	if (framePacing_.refreshMilliseconds == 0.0) framePacing_.refreshMilliseconds = interval;
+	else if (interval < framePacing_.refreshMilliseconds * 1.5) framePacing_.refreshMilliseconds += (interval - framePacing_.refreshMilliseconds) * 0.05;
 
-	VK_CHECK(vkQueuePresentKHR(deviceQueue_, &presentInfo));
-}
+	// sleep away the part of refresh that frame does not need, keeping 1 ms (and 20 %) margin
+	auto budget = presentSettings_.targetLatencyMilliseconds;
+	if (budget <= 0.0) budget = (framePacing_.cpuMilliseconds + framePacing_.gpuMilliseconds) * 1.2 + 1.0;
+
+	auto sleepMilliseconds = framePacing_.refreshMilliseconds - budget;
+	if (sleepMilliseconds > 0.0 && framePacing_.gpuMilliseconds > 0.0) {
+		std::this_thread::sleep_until(releaseTime + std::chrono::duration<double, std::milli>(sleepMilliseconds));
+	}
 
-VkResult GraphicsEngine::waitFence() {
-	return vkWaitForFences(device_, 1, &fence_, VK_TRUE, UINT64_MAX);
+	inputSampleTime_ = std::chrono::steady_clock::now();
 }
 
-void GraphicsEngine::resetFence() {
-	vkResetFences(device_, 1, &fence_);
+void GraphicsEngine::resetFrameTimings() {
+	frameTimings_ = FrameTimings{};
+	frameTimings_.beginTime = std::chrono::steady_clock::now();
+	frameTimings_.maxLatencyMilliseconds = 0.0;
 }
 
-void GraphicsEngine::beginRenderPass() {
-	VkClearValue colorClearValue{}, depthClearValue{};
-	colorClearValue.color = { 0.8f, 0.8f, 0.8f, 1.0f };
-	depthClearValue.depthStencil = { 1.0f, 0 };
+void GraphicsEngine::printFrameTimings() {
+	if (frameTimings_.frameCount == 0) return;
 
-	std::array<VkClearValue, 2> clearValues{ colorClearValue, depthClearValue };
+	// frame < cpu + gpu -> CPU recorded next frame while GPU was busy
+	auto frameMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameTimings_.beginTime).count() / frameTimings_.frameCount;
+	auto cpuMilliseconds = frameTimings_.cpuMilliseconds / frameTimings_.frameCount;
+	auto waitMilliseconds = frameTimings_.waitMilliseconds / frameTimings_.frameCount;
 
-	VkRenderPassBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	beginInfo.framebuffer = defaultFramebuffers_[currentFrameIndex_];
-	beginInfo.renderPass = defaultRenderPass_;
-	beginInfo.renderArea.extent = imageSize_;
-	beginInfo.clearValueCount = static_cast<std::uint32_t>(clearValues.size());
-	beginInfo.pClearValues = clearValues.data();
+	auto flags = std::cout.flags();
+	auto precision = std::cout.precision();
 
-	vkCmdBeginRenderPass(commandBuffer_, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	std::cout << std::fixed << std::setprecision(3) << "[frame] " << framesInFlight_ << " in flight: frame " << frameMilliseconds << " ms, cpu " << cpuMilliseconds << " ms (record " << frameTimings_.recordMilliseconds / frameTimings_.frameCount << " ms on " << recordThreadCount_ << " threads), fence wait " << waitMilliseconds << " ms";
+	if (frameTimings_.gpuFrameCount != 0) {
+		std::cout << ", gpu " << frameTimings_.gpuMilliseconds / frameTimings_.gpuFrameCount << " ms";
+		std::cout << ", input to GPU done " << frameTimings_.latencyMilliseconds / frameTimings_.gpuFrameCount << " ms (max " << frameTimings_.maxLatencyMilliseconds << " ms)";
+	}
+	if (presentSettings_.lowLatency) {
+		std::cout << ", refresh " << framePacing_.refreshMilliseconds << " ms";
+	}
+	if (frameTimings_.drawCount != 0) {
+		std::cout << std::setprecision(1) << ", per frame " << static_cast<double>(frameTimings_.drawCount) / frameTimings_.frameCount << " draws / " << static_cast<double>(frameTimings_.pipelineChanges) / frameTimings_.frameCount << " pipeline binds / " << static_cast<double>(frameTimings_.materialChanges) / frameTimings_.frameCount << " material binds";
+	}
+	std::cout << std::endl;
+
+	std::cout.flags(flags);
+	std::cout.precision(precision);
 }
 
-void GraphicsEngine::endRenderPass() {
-	vkCmdEndRenderPass(commandBuffer_);
+void GraphicsEngine::setViewport(VkCommandBuffer commandBuffer) {
+	VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(imageSize_.width), static_cast<float>(imageSize_.height), 0.0f, 1.0f };
+	VkRect2D scissor = { {0, 0}, imageSize_ };
+
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 }
 
-void GraphicsEngine::initialize(SDL_Window* window, const char* applicationName, std::uint32_t applicationVersion, const VkExtent2D& imageSize) {
+void GraphicsEngine::initialize(SDL_Window* window, const char* applicationName, std::uint32_t applicationVersion, const VkExtent2D& imageSize, const PresentSettings& presentSettings) {
+	presentSettings_ = presentSettings;
+	window_ = window;
+
 	imageSize_.width = imageSize.width;
 	imageSize_.height = imageSize.height;
 
@@ -1055,174 +2780,894 @@ void GraphicsEngine::initialize(SDL_Window* window, const char* applicationName,
 	getPhysicalDevice();
 	getQueueFamilyIndex();
 
+	if (bindless_ && !isBindlessSupported()) {
+		std::cerr << "[initialize] descriptor indexing is not supported, falling back to per-material descriptor sets" << std::endl;
+		bindless_ = false;
+	}
+	if (gpuDriven_ && !(bindless_ && supportedFeatures_.multiDrawIndirect == VK_TRUE && supportedFeatures_.drawIndirectFirstInstance == VK_TRUE)) {
+		std::cerr << "[initialize] GPU-driven drawing requires bindless materials and multi draw indirect, falling back to CPU recorded draws" << std::endl;
+		gpuDriven_ = false;
+	}
+	// bones, instances (set 0) + draw records, commands, draw count (set 1)
+	if (gpuDriven_ && properties_.limits.maxDescriptorSetStorageBuffersDynamic < 5) {
+		std::cerr << "[initialize] too few dynamic storage buffers for GPU-driven drawing, falling back to CPU recorded draws" << std::endl;
+		gpuDriven_ = false;
+	}
+	drawIndirectCount_ = gpuDriven_ && supportedFeatures12_.drawIndirectCount == VK_TRUE;
+
 	std::vector<const char*> deviceExtensions{ "VK_KHR_swapchain" };
 	std::vector<const char*> deviceLayers{};
 
 	createDevice(deviceExtensions, deviceLayers);
 	getDeviceQueue();
 
+	memoryAllocator_.initialize(device_, properties_, memoryProperties_);
+	if (!pipelineCache_.initialize(device_, properties_, pipelineCachePath, loadPipelineCache_)) {
+		std::cerr << "[initialize] pipelines are created without pipeline cache" << std::endl;
+	}
+	pipelineManager_.initialize(device_, [this](const GraphicsPipelineDesc& desc, VkRenderPass renderPass, VkPipeline& pipeline) { return createGraphicsPipeline(desc, renderPass, pipeline); }, pipelineCompileThreads);
+
 	createSwapchain();
 
 	createCommandPool();
 	createCommandBuffer();
-	createFence();
+	createFrames();
+	applyRecordThreads(recordThreadCount_);
+	calibrateTimestamps();
+
+	createUploadCommandPool();
+	createStagingBuffer(stagingBufferSize, stagingBuffer_);
 
 	createDefaultImages();
 	createDefaultImageViews();
-	createDefaultDepthImage();
-	createDefaultDepthImageView();
-	createDefaultRenderPass();
-	createDefaultFramebuffers();
-
-	PMXLoader loader{};
-	PMXData modelData{};
-	loader.load("assets\\Tdaσ~N@JKStyle\\Tdaσ~N@JKStyle.pmx", modelData);
+	createRenderFinishedSemaphores();
 
-	textures_.resize(modelData.texturePaths.size());
-	for (auto i = 0; i < textures_.size(); ++i) {
-		std::cout << modelData.texturePaths[i] << std::endl;
-		TexLoader loader{};
-		VkExtent3D imageSize{};
-		VkFormat imageFormat{};
-		std::vector<std::uint8_t> imageData{};
-		if (loader.load(modelData.texturePaths[i], imageSize, imageFormat, imageData)) {
-			std::cout << "success" << std::endl;
-			createTexture(imageData, imageFormat, imageSize, textures_[i]);
-		}
-		else {
-			std::cout << "failure" << std::endl;
-			std::exit(EXIT_FAILURE);
-		}
+	// built-in model when no scene is given
+	auto builtInScene = scene_.empty();
+	if (builtInScene) {
+		scene_.addObject(scene_.addModel("assets\\Tdaσ~N@JKStyle\\Tdaσ~N@JKStyle.pmx"), glm::mat4(1.0f));
 	}
 
-	/*
-	for (auto i = 0; i < modelData.vertices.size(); ++i) {
-		std::cout << "vertices #" << i << std::endl;
-		std::cout << "bone index 1: " << modelData.vertices[i].boneIndices.x << ", 2: " << modelData.vertices[i].boneIndices.y << ", 3: " << modelData.vertices[i].boneIndices.z << ", 4: " << modelData.vertices[i].boneIndices.w << std::endl;
-		std::cout << "bone weight 1: " << modelData.vertices[i].boneWeights.x << ", 2: " << modelData.vertices[i].boneWeights.y << ", 3: " << modelData.vertices[i].boneWeights.z << ", 4: " << modelData.vertices[i].boneWeights.w << std::endl;
+	maxTextureMipLevels_ = 1;
+	std::vector<PMX_Vertex> vertices{};
+	std::vector<std::uint32_t> mergedIndices{};
+	for (const auto& path : scene_.models()) {
+		loadModel(path, vertices, mergedIndices, builtInScene);
 	}
-	*/
-
-	bones_.resize(modelData.bones.size(), Bone{ glm::mat4(1.0f) });
 
-	//bones_[0].matrix = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-	bones_[41].matrix = glm::rotate(glm::mat4(1.0f), glm::radians(-70.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	bones_[42].matrix = glm::rotate(glm::mat4(1.0f), glm::radians(-140.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	bones_[60].matrix = glm::rotate(glm::mat4(1.0f), glm::radians(-35.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	for (auto i = 0; i < bones_.size(); ++i) {
-		auto localMatrix = glm::translate(glm::mat4(1.0f), -modelData.bones[i].position);
-		auto globalMatrix = glm::translate(glm::mat4(1.0f), modelData.bones[i].position);
-		if (modelData.bones[i].parentIndex == -1) bones_[i].matrix = globalMatrix * bones_[i].matrix * localMatrix;
-		else bones_[i].matrix = globalMatrix * bones_[i].matrix * localMatrix * bones_[modelData.bones[i].parentIndex].matrix;
+	// boneless scene still binds bone buffer, zero sized range is invalid
+	if (bones_.empty()) bones_.push_back(Bone{ glm::mat4(1.0f) });
+
+	// textureless scene: missing texture / sphere / toon slots fall back to textures_[0], so it has to exist (1x1 white)
+	if (textures_.empty()) {
+		TexImage image{};
+		image.size = { 1, 1, 1 };
+		image.format = VK_FORMAT_R8G8B8A8_UNORM;
+		image.mipLevels = 1;
+		image.arrayLayers = 1;
+		image.opaque = true;
+		image.subresourceOffsets = { 0 };
+		image.data = { 255, 255, 255, 255 };
+
+		Texture texture{};
+		createTexture(image, stageData(image.data.data(), sizeof(std::uint8_t) * image.data.size()), texture);
+		texture.opaque = true;
+		textures_.push_back(texture);
 	}
 
-	createStorageBuffer(sizeof(Bone) * bones_.size(), boneBuffer_);
+	std::cout << "unique textures: " << TextureCache<Texture>::instance().size() << " / " << textures_.size() << std::endl;
 
-	std::memcpy(boneBuffer_.pointer, bones_.data(), sizeof(Bone) * bones_.size());
+	auto transparentCount = std::count(transparentMaterials_.begin(), transparentMaterials_.end(), true);
+	std::cout << "materials: " << materials_.size() - transparentCount << " opaque, " << transparentCount << " transparent" << std::endl;
 
-	//for (const auto& bone : modelData.bones) std::cout << "bone #" << bone.index << ", parent: " << bone.parentIndex << std::endl;
+	// material index has to fit its sort key field
+	if (materials_.size() > (1ull << RenderQueue::materialBits)) {
+		std::cerr << "[initialize] " << materials_.size() << " materials exceed sort key limit of " << (1ull << RenderQueue::materialBits) << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+
+	sceneDrawCount_ = 0;
+	scenePacketCount_ = 0;
+	for (const auto& object : scene_.objects()) {
+		if (object.model >= models_.size()) {
+			std::cerr << "[initialize] scene object references model " << object.model << " of " << models_.size() << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		const auto& range = models_[object.model];
+		sceneDrawCount_ += range.materialCount;
+		scenePacketCount_ += range.materialCount;
+		if (depthPrepass_) {
+			scenePacketCount_ += static_cast<std::uint32_t>(std::count(transparentMaterials_.begin() + range.firstMaterial, transparentMaterials_.begin() + range.firstMaterial + range.materialCount, false));
+		}
+	}
+	std::cout << "scene: " << models_.size() << " models, " << scene_.objects().size() << " objects, " << sceneDrawCount_ << " material draws" << std::endl;
 
-	materialBuffers_.resize(modelData.materials.size());
+	bonePaletteCount_ = std::min(bonePaletteCount_, instanceCount_);
+	// every instance gets own draw records on GPU-driven path
+	indirectDrawCapacity_ = std::max(sceneDrawCount_ * instanceCount_ * maxIndirectRepeatCount, 1u);
 
-	materials_ = std::move(modelData.materials);
+	// merged indices are absolute, 16 bit whenever vertex count allows
+	PMX_Indices indices{};
+	if (vertices.size() <= 65536) indices = std::vector<std::uint16_t>(mergedIndices.begin(), mergedIndices.end());
+	else indices = std::move(mergedIndices);
 
-	createVertexBuffer(modelData.vertices, vertexBuffer_);
+	createVertexBuffer(vertices, vertexBuffer_);
+	// GPU culling and render queue depth
+	computeMaterialBounds(vertices, indices);
 
-	if (std::holds_alternative<std::vector<std::uint16_t>>(modelData.indices)) {
-		createIndexBuffer(std::get<std::vector<std::uint16_t>>(modelData.indices), indexBuffer_);
+	if (std::holds_alternative<std::vector<std::uint16_t>>(indices)) {
+		createIndexBuffer(std::get<std::vector<std::uint16_t>>(indices), indexBuffer_);
 	}
-	else if (std::holds_alternative<std::vector<std::uint32_t>>(modelData.indices)) {
-		createIndexBuffer(std::get<std::vector<std::uint32_t>>(modelData.indices), indexBuffer_);
+	else if (std::holds_alternative<std::vector<std::uint32_t>>(indices)) {
+		createIndexBuffer(std::get<std::vector<std::uint32_t>>(indices), indexBuffer_);
 	}
 	else {
 		std::cerr << "index data has invalid type" << std::endl;
 		std::exit(EXIT_FAILURE);
 	}
 
-	createShaderModule("basic.vert.spv", "basic.frag.spv");
+	// every texture has to fit in bindless array
+	if (bindless_ && textures_.size() > std::min(maxBindlessTextures, properties_.limits.maxPerStageDescriptorSampledImages)) {
+		std::cerr << "[initialize] " << textures_.size() << " textures exceed bindless array, falling back to per-material descriptor sets" << std::endl;
+		bindless_ = false;
+		gpuDriven_ = false;
+		drawIndirectCount_ = false;
+	}
+
+	createShaderModule("basic.vert.spv", bindless_ ? "bindless.frag.spv" : "basic.frag.spv");
+	if (depthPrepass_) loadShaderModule("depth.vert.spv", depthVertexShaderModule_);
+	if (gpuDriven_) {
+		loadShaderModule("indirect.vert.spv", indirectVertexShaderModule_);
+		loadShaderModule("indirect.frag.spv", indirectFragmentShaderModule_);
+		loadShaderModule("cull.comp.spv", cullShaderModule_);
+		loadShaderModule("hiz.comp.spv", hiZShaderModule_);
+	}
 
-	createUniformBuffer(transformBuffer_);
+	createFrameRingBuffer(frameDataSize(), frameRingBuffer_);
 
 	createTextureSampler();
 	createToonSampler();
 
-	defaultDescriptorSets_.resize(materials_.size());
+	if (bindless_) {
+		// one set for all materials: textures in one array, material parameters in one storage buffer
+		createMaterialBuffer();
+		createBindlessDescriptorSetLayout();
+		createBindlessDescriptorPool();
+		createBindlessDescriptorSet();
+	}
+	else {
+		defaultDescriptorSets_.resize(materials_.size());
+
+		createDefaultDescriptorSetLayout();
+		createDefaultDescriptorPool(static_cast<std::uint32_t>(materials_.size()));
+		materialParameters_.resize(materials_.size());
+		for (auto i = 0; i < materials_.size(); ++i) {
+
+			materialParameters_[i] = MaterialBufferObject{
+				materials_[i].diffuse,
+				materials_[i].specular,
+				materials_[i].specCoef,
+				materials_[i].ambient,
+				materials_[i].textureIndex >= 0,
+				sphereMode(materials_[i]),
+				materials_[i].toonIndex >= 0,
+			};
+
+			auto& texture = materials_[i].textureIndex != -1 ? textures_[materials_[i].textureIndex] : textures_[0];
+			auto& sphere = materials_[i].sphereIndex != -1 ? textures_[materials_[i].sphereIndex] : textures_[0];
+			auto& toon = materials_[i].toonIndex != -1 ? textures_[materials_[i].toonIndex] : textures_[0];
+
+			createDefaultDescriptorSets(texture, sphere, toon, defaultDescriptorSets_[i]);
+		}
+	}
+	std::cout << "material binding: " << (bindless_ ? "bindless (1 descriptor set)" : "per-material descriptor sets") << std::endl;
+
+	if (gpuDriven_) {
+		createIndirectDrawBuffer();
+		createVisibilityBuffer();
+		createIndirectDescriptorSetLayout();
+		createIndirectDescriptorPool();
+		createIndirectDescriptorSet();
+
+		createHiZSampler();
+		createHiZDescriptorSetLayouts();
+		createHiZDescriptorPool();
+	}
+
+	// needs indirect / visibility buffers and Hi-Z layouts, pipelines below need its render passes
+	buildRenderGraph();
+	if (gpuDriven_) createHiZPyramid();
+	renderGraph_.printStatistics();
 
-	createDefaultDescriptorSetLayout();
-	createDefaultDescriptorPool(static_cast<std::uint32_t>(materials_.size()));
-	for (auto i = 0; i < materials_.size(); ++i) {
+	std::cout << "draw submission: " << (gpuDriven_ ? (drawIndirectCount_ ? "GPU culled, indirect count" : "GPU culled, indirect") : "CPU recorded") << std::endl;
+	if (gpuDriven_) std::cout << "indirect draw capacity: " << indirectDrawCapacity_ << " (" << maxIndirectRepeatCount << " scene repeats)" << std::endl;
+	std::cout << "instances: " << instanceCount_ << " (" << bonePaletteCount_ << " bone palettes)" << std::endl;
+	if (gpuDriven_) std::cout << "occlusion culling: " << (occlusionCulling_ ? "two phase Hi-Z" : "off") << std::endl;
 
-		MaterialBufferObject bufferObject{
-			materials_[i].diffuse,
-			materials_[i].specular,
-			materials_[i].specCoef,
-			materials_[i].ambient,
-			materials_[i].textureIndex >= 0,
-			materials_[i].sphereIndex >= 0,
-			materials_[i].toonIndex >= 0,
-		};
-		createConstantUnifromBuffer(bufferObject, materialBuffers_[i]);
+	createDefaultPipelineLayout();
+	buildForwardPasses();
+	createForwardPipelines();
+	if (!gpuDriven_) {
+		std::cout << "forward passes:";
+		for (const auto& forwardPass : forwardPasses_) {
+			const char* names[] = { "depth prepass", "opaque", "transparent" };
+			std::cout << (&forwardPass == &forwardPasses_.front() ? " " : " -> ") << names[static_cast<std::uint32_t>(forwardPass.pass)];
+		}
+		std::cout << std::endl;
+	}
+	if (gpuDriven_) {
+		createIndirectPipelineLayout();
+		// all materials in one pipeline (blended, depth written), occlusion passes rely on its depth
+		// cull mode is per pipeline, so one call for every material draws both faces
+		auto indirectPipeline = pipelineManager_.request(pipelineDesc(indirectVertexShaderModule_, indirectFragmentShaderModule_, indirectPipelineLayout_, PipelineState{ VK_COMPARE_OP_LESS, VK_TRUE, VK_TRUE }));
+		indirectGraphicsPipeline_ = pipelineManager_.pipeline(indirectPipeline);
+		if (indirectGraphicsPipeline_ == VK_NULL_HANDLE) {
+			std::cerr << "[initialize] failed to create indirect pipeline" << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		createCullPipeline();
+		createHiZPipeline();
+	}
+	// compare with --cold-pipelines to see what cache saves (background variants may still be compiling)
+	pipelineCache_.printStatistics();
+	pipelineManager_.printStatistics();
+
+	// textures and geometry in one submission, first frame is ordered after it on graphics queue
+	flushUploads();
+
+	memoryAllocator_.printStatistics();
+}
 
-		auto& texture = materials_[i].textureIndex != -1 ? textures_[materials_[i].textureIndex] : textures_[0];
-		auto& sphere = materials_[i].sphereIndex != -1 ? textures_[materials_[i].sphereIndex] : textures_[0];
-		auto& toon = materials_[i].toonIndex != -1 ? textures_[materials_[i].toonIndex] : textures_[0];
+void GraphicsEngine::savePipelineCache() {
+	// variants still compiling in background would be missing from next run's cache
+	pipelineManager_.waitIdle();
+	if (pipelineCache_.save()) std::cout << "[savePipelineCache] saved to " << pipelineCachePath << std::endl;
+}
+
+void GraphicsEngine::beginFrameData(std::uint32_t frameIndex) {
+	// region was last used by this frame slot, whose fence has been waited in beginFrame
+	frameRingBuffer_.regionOffset = frameRingBuffer_.regionSize * frameIndex;
+	frameRingBuffer_.head = 0;
+}
 
-		createDefaultDescriptorSets(materialBuffers_[i], texture, sphere, toon, defaultDescriptorSets_[i]);
+std::size_t GraphicsEngine::frameDataSize() const {
+	// same allocations as reserveFrameData, each starts at aligned offset
+	auto alignment = static_cast<std::size_t>(std::max(properties_.limits.minUniformBufferOffsetAlignment, properties_.limits.minStorageBufferOffsetAlignment));
+	auto aligned = [alignment](std::size_t size) { return (size + alignment - 1) / alignment * alignment; };
+
+	auto size = aligned(sizeof(TransformBufferObject));
+	size += aligned(sizeof(Bone) * bones_.size() * bonePaletteCount_);
+	size += aligned(sizeof(InstanceRecord) * instanceRecordCount());
+	// bindless materials live in materialBuffer_, only per-material sets take parameters from ring
+	if (!bindless_) size += aligned(sizeof(MaterialBufferObject)) * materials_.size();
+	if (gpuDriven_) {
+		size += aligned(sizeof(CullParameters));
+		size += aligned(sizeof(DrawRecord) * indirectDrawCapacity_);
 	}
 
-	createDefaultPipelineLayout();
-	createDefaultGraphicsPipeline();
+	return size;
+}
+
+std::uint32_t GraphicsEngine::allocateFrameData(std::size_t size, std::uint8_t*& pointer) {
+	auto offset = (frameRingBuffer_.head + frameRingBuffer_.alignment - 1) / frameRingBuffer_.alignment * frameRingBuffer_.alignment;
+	if (offset + size > frameRingBuffer_.regionSize) {
+		std::cerr << "[allocateFrameData] frame ring region overflow (" << offset + size << " / " << frameRingBuffer_.regionSize << " bytes)" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	frameRingBuffer_.head = offset + size;
 
-	acquireNextImage();
+	offset += frameRingBuffer_.regionOffset;
+	pointer = frameRingBuffer_.pointer + offset;
+
+	return static_cast<std::uint32_t>(offset);
 }
 
-void GraphicsEngine::draw() {
-	std::size_t offset = 0;
+void GraphicsEngine::reserveFrameData() {
+	beginFrameData(frameIndex_);
 
-	auto model = glm::rotate(glm::mat4(1.0f), glm::radians(static_cast<float>(frame_)), glm::vec3(0.0f, 1.0f, 0.0f));
-	++frame_;
+	// regions are carved out up front, so frame tasks fill them (and record their offsets) in parallel
+	frameDataOffsets_.transform = allocateFrameData(sizeof(TransformBufferObject), frameDataPointers_.transform);
+	frameDataOffsets_.bones = allocateFrameData(sizeof(Bone) * bones_.size() * bonePaletteCount_, frameDataPointers_.bones);
+	frameDataOffsets_.instances = allocateFrameData(sizeof(InstanceRecord) * instanceRecordCount(), frameDataPointers_.instances);
+
+	// materials are packed at aligned stride so each one is addressed by a dynamic offset
+	auto stride = (sizeof(MaterialBufferObject) + frameRingBuffer_.alignment - 1) / frameRingBuffer_.alignment * frameRingBuffer_.alignment;
+	frameDataOffsets_.materials = allocateFrameData(stride * materialParameters_.size(), frameDataPointers_.materials);
+	frameDataOffsets_.materialStride = static_cast<std::uint32_t>(stride);
 
+	// draw records are bound with fixed range, so full capacity is reserved
+	if (gpuDriven_) {
+		frameDataOffsets_.cullParameters = allocateFrameData(sizeof(CullParameters), frameDataPointers_.cullParameters);
+		frameDataOffsets_.drawRecords = allocateFrameData(sizeof(DrawRecord) * indirectDrawCapacity_, frameDataPointers_.drawRecords);
+	}
+}
+
+glm::mat4 GraphicsEngine::modelMatrix(std::uint32_t frame) {
+	return glm::rotate(glm::mat4(1.0f), glm::radians(static_cast<float>(frame)), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+glm::mat4 GraphicsEngine::instanceMatrix(std::uint32_t frame, std::uint32_t object, std::uint32_t instance) {
+	// square grid, centered on x and growing away from camera
+	constexpr float spacing = 12.0f;
+	auto columns = static_cast<std::uint32_t>(std::ceil(std::sqrt(static_cast<float>(instanceCount_))));
+	auto column = instance % columns;
+	auto row = instance / columns;
+
+	auto offset = glm::vec3((column - (columns - 1) * 0.5f) * spacing, 0.0f, row * spacing);
+
+	return glm::translate(glm::mat4(1.0f), offset) * scene_.objects()[object].transform * modelMatrix(frame);
+}
+
+std::uint32_t GraphicsEngine::instanceBoneOffset(std::uint32_t instance) {
+	return static_cast<std::uint32_t>(instance % bonePaletteCount_ * bones_.size());
+}
+
+void GraphicsEngine::cameraMatrices(glm::mat4& view, glm::mat4& projection) {
 	float cameraLength = 30.0f;
-	auto view = glm::lookAt(glm::vec3(0.0f, 10.0f, -cameraLength), glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	view = glm::lookAt(glm::vec3(0.0f, 10.0f, -cameraLength), glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
-	auto projection = glm::perspective(glm::radians(45.0f), static_cast<float>(imageSize_.width) / imageSize_.height, 0.1f, 100.0f);
+	projection = glm::perspective(glm::radians(45.0f), static_cast<float>(imageSize_.width) / imageSize_.height, nearPlane, farPlane);
 	projection[1][1] *= -1;
+}
+
+void GraphicsEngine::writeTransform(std::uint32_t frame) {
+	auto model = modelMatrix(frame);
+
+	glm::mat4 view{}, projection{};
+	cameraMatrices(view, projection);
 
 	auto normalMatrix = glm::transpose(glm::inverse(model));
 
 	TransformBufferObject transformBufferObject{ model, view, projection, normalMatrix };
 
-	std::memcpy(transformBuffer_.pointer, &transformBufferObject, sizeof(decltype(transformBufferObject)));
+	std::memcpy(frameDataPointers_.transform, &transformBufferObject, sizeof(TransformBufferObject));
+}
 
-	beginCommand();
-	beginRenderPass();
+void GraphicsEngine::writeDrawRecords(std::uint32_t frame, std::uint32_t repeatCount) {
+	glm::mat4 view{}, projection{};
+	cameraMatrices(view, projection);
 
-	vkCmdBindPipeline(commandBuffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, defaultGraphicsPipeline_);
-	vkCmdBindVertexBuffers(commandBuffer_, 0, 1, &vertexBuffer_.buffer, &offset);
-	vkCmdBindIndexBuffer(commandBuffer_, indexBuffer_.buffer, 0, indexBuffer_.indexType);
-	for (auto i = 0; i < materials_.size(); ++i) {
-		vkCmdBindDescriptorSets(commandBuffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, defaultPipelineLayout_, 0, 1, &defaultDescriptorSets_[i], 0, nullptr);
-		vkCmdDrawIndexed(commandBuffer_, materials_[i].indexCount, 1, materials_[i].indexOffset, 0, 0);
+	// frustum planes from rows of clip matrix (Gribb / Hartmann), in world space
+	auto clip = projection * view;
+	auto row = [&clip](int i) { return glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]); };
+
+	CullParameters parameters{};
+	parameters.viewProjection = clip;
+	for (auto i = 0; i < 3; ++i) {
+		parameters.frustumPlanes[i * 2 + 0] = row(3) + row(i);
+		parameters.frustumPlanes[i * 2 + 1] = row(3) - row(i);
+	}
+	for (auto& plane : parameters.frustumPlanes) plane /= glm::length(glm::vec3(plane));
+	parameters.drawCount = repeatCount * instanceCount_ * sceneDrawCount_;
+	parameters.compact = drawIndirectCount_ ? 1 : 0;
+	parameters.occlusion = occlusionCulling_ ? 1 : 0;
+
+	std::memcpy(frameDataPointers_.cullParameters, &parameters, sizeof(CullParameters));
+
+	// one record per material of every instance, so each instance is culled on its own
+	auto pointer = frameDataPointers_.drawRecords;
+	for (std::uint32_t repeat = 0; repeat < repeatCount; ++repeat) {
+		for (std::uint32_t object = 0; object < scene_.objects().size(); ++object) {
+			const auto& range = models_[scene_.objects()[object].model];
+			for (std::uint32_t instance = 0; instance < instanceCount_; ++instance) {
+				auto model = instanceMatrix(frame, object, instance);
+				auto boneOffset = instanceBoneOffset(instance);
+				for (auto i = range.firstMaterial; i < range.firstMaterial + range.materialCount; ++i) {
+					DrawRecord record{
+						model,
+						materialBounds_[i],
+						i,
+						materials_[i].indexCount,
+						materials_[i].indexOffset,
+						0,
+						boneOffset,
+					};
+					std::memcpy(pointer, &record, sizeof(DrawRecord));
+					pointer += sizeof(DrawRecord);
+				}
+			}
+		}
 	}
+}
 
-	endRenderPass();
-	endCommand();
+void GraphicsEngine::writeBones() {
+	// pose is built once at load time, so every palette holds it; animated instances only fill their own palette
+	auto paletteSize = sizeof(Bone) * bones_.size();
+	for (std::uint32_t palette = 0; palette < bonePaletteCount_; ++palette) {
+		std::memcpy(frameDataPointers_.bones + paletteSize * palette, bones_.data(), paletteSize);
+	}
+}
 
-	submitCommands();
+void GraphicsEngine::writeInstances(std::uint32_t frame) {
+	auto pointer = frameDataPointers_.instances;
+	for (std::uint32_t object = 0; object < scene_.objects().size(); ++object) {
+		for (std::uint32_t instance = 0; instance < instanceCount_; ++instance) {
+			auto model = instanceMatrix(frame, object, instance);
+			InstanceRecord record{
+				model,
+				glm::transpose(glm::inverse(model)),
+				instanceBoneOffset(instance),
+			};
+			std::memcpy(pointer, &record, sizeof(InstanceRecord));
+			pointer += sizeof(InstanceRecord);
+		}
+	}
+}
 
-	switch (waitFence()) {
-	case VK_SUCCESS:
-		break;
-	case VK_TIMEOUT:
-		std::cerr << "[draw] command execution timed out" << std::endl;
-		std::exit(EXIT_FAILURE);
-		break;
-	default:
-		break;
+void GraphicsEngine::buildRenderQueue(std::uint32_t frame) {
+	glm::mat4 view{}, projection{};
+	cameraMatrices(view, projection);
+
+	renderQueue_.clear();
+	for (std::uint32_t object = 0; object < scene_.objects().size(); ++object) {
+		const auto& range = models_[scene_.objects()[object].model];
+		// instances share draws, first one stands for all of them
+		auto modelView = view * instanceMatrix(frame, object, 0);
+		for (auto i = range.firstMaterial; i < range.firstMaterial + range.materialCount; ++i) {
+			auto center = modelView * glm::vec4(glm::vec3(materialBounds_[i]), 1.0f);
+			auto depth = (-center.z - nearPlane) / (farPlane - nearPlane);
+			auto pass = transparentMaterials_[i] ? RenderQueue::Pass::Transparent : RenderQueue::Pass::Opaque;
+			auto variant = (materials_[i].flags & doubleSidedFlag) ? 0 : 1;
+			auto pipeline = materialPipelines_[i];
+
+			// opaque material is drawn twice: depth only, then shaded
+			if (pass == RenderQueue::Pass::Opaque && depthPrepass_) {
+				auto depthPipeline = passPipelines_[static_cast<std::uint32_t>(RenderQueue::Pass::Depth)][variant];
+
+				// both passes have to cover same faces for EQUAL test -> variants switch as one pair, generic pair until both are compiled
+				if (!pipelineManager_.isReady(depthPipeline) || !pipelineManager_.isReady(pipeline)) {
+					depthPipeline = passPipelines_[static_cast<std::uint32_t>(RenderQueue::Pass::Depth)][0];
+					pipeline = passPipelines_[static_cast<std::uint32_t>(pass)][0];
+				}
+
+				renderQueue_.push(DrawPacket{ RenderQueue::makeKey(RenderQueue::Pass::Depth, depthPipeline, i, depth), depthPipeline, i, object, static_cast<std::uint32_t>(RenderQueue::Pass::Depth) });
+			}
+
+			renderQueue_.push(DrawPacket{ RenderQueue::makeKey(pass, pipeline, i, depth), pipeline, i, object, static_cast<std::uint32_t>(pass) });
+		}
 	}
-	resetFence();
+	renderQueue_.sort();
+}
 
-	present();
+void GraphicsEngine::writeMaterials() {
+	auto pointer = frameDataPointers_.materials;
+	for (const auto& parameter : materialParameters_) {
+		std::memcpy(pointer, &parameter, sizeof(MaterialBufferObject));
+		pointer += frameDataOffsets_.materialStride;
+	}
+}
+
+void GraphicsEngine::bindDefaultDescriptorSet(VkCommandBuffer commandBuffer, std::uint32_t materialIndex) {
+	// in binding order: transform (0), material (1), bones (5), instances (6)
+	std::array<std::uint32_t, 4> dynamicOffsets{
+		frameDataOffsets_.transform,
+		frameDataOffsets_.materials + frameDataOffsets_.materialStride * materialIndex,
+		frameDataOffsets_.bones,
+		frameDataOffsets_.instances,
+	};
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, defaultPipelineLayout_, 0, 1, &defaultDescriptorSets_[materialIndex], static_cast<std::uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+}
+
+void GraphicsEngine::bindBindlessDescriptorSet(VkCommandBuffer commandBuffer) {
+	// in binding order: transform (0), bones (5), instances (6)
+	std::array<std::uint32_t, 3> dynamicOffsets{
+		frameDataOffsets_.transform,
+		frameDataOffsets_.bones,
+		frameDataOffsets_.instances,
+	};
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, defaultPipelineLayout_, 0, 1, &bindlessDescriptorSet_, static_cast<std::uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+}
+
+RenderQueue::StateChanges GraphicsEngine::recordDrawItems(VkCommandBuffer commandBuffer, VkBuffer vertexBuffer, VkBuffer indexBuffer, std::uint32_t begin, std::uint32_t end) {
+	VkDeviceSize offset = 0;
+
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexBuffer_.indexType);
+	// depth prepass reads only transform, bones and instances, any material's set provides them
+	if (bindless_) bindBindlessDescriptorSet(commandBuffer);
+	else bindDefaultDescriptorSet(commandBuffer, 0);
+
+	// packets are sorted by state, so only changes are bound
+	const auto& packets = renderQueue_.packets();
+	auto pipeline = UINT32_MAX;
+	auto material = UINT32_MAX;
+	RenderQueue::StateChanges stateChanges{};
+	for (auto item = begin; item < end; ++item) {
+		const auto& packet = packets[item % packets.size()];
+		if (packet.pipeline != pipeline) {
+			pipeline = packet.pipeline;
+			// pass generic variant while specialized one is still compiling
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineManager_.pipeline(pipeline));
+			++stateChanges.pipelines;
+		}
+		if (packet.material != material && packet.pass != static_cast<std::uint32_t>(RenderQueue::Pass::Depth)) {
+			material = packet.material;
+			if (bindless_) vkCmdPushConstants(commandBuffer, defaultPipelineLayout_, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(std::uint32_t), &material);
+			else bindDefaultDescriptorSet(commandBuffer, material);
+			++stateChanges.materials;
+		}
+		// whole crowd of object in one draw, instances are told apart by gl_InstanceIndex
+		vkCmdDrawIndexed(commandBuffer, materials_[packet.material].indexCount, instanceCount_, materials_[packet.material].indexOffset, 0, packet.object * instanceCount_);
+	}
+
+	return stateChanges;
+}
+
+void GraphicsEngine::recordDrawSlice(std::uint32_t slice, std::uint32_t sliceCount, VkBuffer vertexBuffer, VkBuffer indexBuffer, std::uint32_t itemCount) {
+	auto commandBuffer = frames_[frameIndex_].secondaryCommandBuffers[slice];
+
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = renderGraph_.renderPass(renderGraphNodes_.draw);
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = renderGraph_.framebuffer(renderGraphNodes_.draw, currentFrameIndex_);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	// contiguous slices, executed in slice order -> same draw order as inline recording
+	VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+	setViewport(commandBuffer);
+	sliceStateChanges_[slice] = recordDrawItems(commandBuffer, vertexBuffer, indexBuffer, itemCount * slice / sliceCount, itemCount * (slice + 1) / sliceCount);
+	VK_CHECK(vkEndCommandBuffer(commandBuffer));
+}
+
+std::array<std::uint32_t, 4> GraphicsEngine::indirectDynamicOffsets() {
+	auto regionOffset = static_cast<std::uint32_t>(indirectDrawBuffer_.regionSize * frameIndex_);
+
+	return {
+		frameDataOffsets_.cullParameters,
+		frameDataOffsets_.drawRecords,
+		regionOffset + static_cast<std::uint32_t>(indirectDrawBuffer_.commandOffset),
+		regionOffset,
+	};
+}
+
+void GraphicsEngine::recordCulling(VkCommandBuffer commandBuffer, std::uint32_t drawCount, std::uint32_t phase) {
+	if (phase == 0) {
+		// region was last read by this frame slot, whose fence has been waited in beginFrame
+		auto regionOffset = indirectDrawBuffer_.regionSize * frameIndex_;
+		vkCmdFillBuffer(commandBuffer, indirectDrawBuffer_.buffer, regionOffset, sizeof(std::uint32_t) * 2, 0);
+
+		// reset happens inside cull pass, so render graph does not see it (visibility and Hi-Z barriers come from graph)
+		VkMemoryBarrier clearBarrier{};
+		clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	auto dynamicOffsets = indirectDynamicOffsets();
+	std::array<VkDescriptorSet, 2> descriptorSets{ indirectDescriptorSet_, hiZPyramid_.cullDescriptorSet };
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline_);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout_, 0, static_cast<std::uint32_t>(descriptorSets.size()), descriptorSets.data(), static_cast<std::uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+	vkCmdPushConstants(commandBuffer, cullPipelineLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(std::uint32_t), &phase);
+	vkCmdDispatch(commandBuffer, (drawCount + cullGroupSize - 1) / cullGroupSize, 1, 1);
+}
+
+void GraphicsEngine::recordHiZBuild(VkCommandBuffer commandBuffer) {
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, hiZPipeline_);
+
+	// level 0 copies depth, each further level is max of level below
+	for (std::uint32_t level = 0; level < hiZPyramid_.mipLevels; ++level) {
+		auto width = std::max(hiZPyramid_.size.width >> level, 1u);
+		auto height = std::max(hiZPyramid_.size.height >> level, 1u);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, hiZPipelineLayout_, 0, 1, &hiZPyramid_.buildDescriptorSets[level], 0, nullptr);
+		vkCmdDispatch(commandBuffer, (width + hiZGroupSize - 1) / hiZGroupSize, (height + hiZGroupSize - 1) / hiZGroupSize, 1);
+
+		// next level reads this one, render graph only orders whole passes
+		VkMemoryBarrier levelBarrier{};
+		levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+	}
+}
+
+void GraphicsEngine::recordIndirectDraws(VkCommandBuffer commandBuffer, VkBuffer vertexBuffer, VkBuffer indexBuffer, std::uint32_t drawCount, std::uint32_t phase) {
+	VkDeviceSize offset = 0;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirectGraphicsPipeline_);
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexBuffer_.indexType);
+
+	// set 0: transform (0), bones (5), instances (6, unused), set 1: indirect set
+	auto indirectOffsets = indirectDynamicOffsets();
+	std::array<std::uint32_t, 7> dynamicOffsets{
+		frameDataOffsets_.transform,
+		frameDataOffsets_.bones,
+		frameDataOffsets_.instances,
+		indirectOffsets[0],
+		indirectOffsets[1],
+		indirectOffsets[2],
+		indirectOffsets[3],
+	};
+	std::array<VkDescriptorSet, 2> descriptorSets{ bindlessDescriptorSet_, indirectDescriptorSet_ };
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirectPipelineLayout_, 0, static_cast<std::uint32_t>(descriptorSets.size()), descriptorSets.data(), static_cast<std::uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+
+	// whole pass in one call, CPU cost does not depend on draw count
+	auto countOffset = indirectDrawBuffer_.regionSize * frameIndex_ + sizeof(std::uint32_t) * phase;
+	auto commandOffset = indirectDrawBuffer_.regionSize * frameIndex_ + indirectDrawBuffer_.commandOffset + sizeof(VkDrawIndexedIndirectCommand) * indirectDrawCapacity_ * phase;
+	if (drawIndirectCount_) {
+		vkCmdDrawIndexedIndirectCount(commandBuffer, indirectDrawBuffer_.buffer, commandOffset, indirectDrawBuffer_.buffer, countOffset, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+	}
+	else {
+		vkCmdDrawIndexedIndirect(commandBuffer, indirectDrawBuffer_.buffer, commandOffset, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
+
+void GraphicsEngine::drawFrame(std::uint32_t frame, VkBuffer vertexBuffer, VkBuffer indexBuffer, std::uint32_t repeatCount) {
+	auto& frameResources = frames_[frameIndex_];
+	// CPU recorded items are render queue packets (depth prepass draws included)
+	auto itemCount = repeatCount * scenePacketCount_;
+	auto sliceCount = std::min(recordThreadCount_, itemCount);
+	// GPU-driven path has no instanced draws, every instance gets own (culled) draw records
+	auto indirectDrawCount = repeatCount * sceneDrawCount_ * instanceCount_;
+
+	// buffers hold maxIndirectRepeatCount repeats of scene, heavier benchmark frames draw fewer copies
+	if (gpuDriven_ && indirectDrawCount > indirectDrawCapacity_) {
+		repeatCount = maxIndirectRepeatCount;
+		indirectDrawCount = repeatCount * sceneDrawCount_ * instanceCount_;
+	}
+
+	auto graphBeginTime = std::chrono::steady_clock::now();
+
+	// recording only needs offsets, so data tasks and record tasks run side by side; all meet at submit
+	reserveFrameData();
+
+	auto& graph = frameGraph_;
+	graph.clear();
+
+	std::vector<TaskGraph::TaskId> submitDependencies{};
+	submitDependencies.push_back(graph.add("transform", [this, frame]() { writeTransform(frame); }));
+	submitDependencies.push_back(graph.add("bones", [this]() { writeBones(); }));
+	submitDependencies.push_back(graph.add("instances", [this, frame]() { writeInstances(frame); }));
+	// bindless material records are static
+	if (!bindless_) submitDependencies.push_back(graph.add("materials", [this]() { writeMaterials(); }));
+
+	if (gpuDriven_) {
+		// record only references draw records, so it runs beside the task filling them
+		submitDependencies.push_back(graph.add("draw records", [this, frame, repeatCount]() { writeDrawRecords(frame, repeatCount); }));
+		submitDependencies.push_back(graph.add("record", [&]() {
+			// pass bodies only, barriers and render passes come from render graph
+			const auto& nodes = renderGraphNodes_;
+			renderGraph_.setRecord(nodes.earlyCull, [&](VkCommandBuffer commandBuffer) { recordCulling(commandBuffer, indirectDrawCount, 0); });
+			renderGraph_.setRecord(nodes.draw, [&](VkCommandBuffer commandBuffer) { recordIndirectDraws(commandBuffer, vertexBuffer, indexBuffer, indirectDrawCount, 0); });
+			if (occlusionCulling_) {
+				renderGraph_.setRecord(nodes.hiZBuild, [this](VkCommandBuffer commandBuffer) { recordHiZBuild(commandBuffer); });
+				renderGraph_.setRecord(nodes.lateCull, [&](VkCommandBuffer commandBuffer) { recordCulling(commandBuffer, indirectDrawCount, 1); });
+				renderGraph_.setRecord(nodes.lateDraw, [&](VkCommandBuffer commandBuffer) { recordIndirectDraws(commandBuffer, vertexBuffer, indexBuffer, indirectDrawCount, 1); });
+			}
+			renderGraph_.execute(frameResources.commandBuffer, currentFrameIndex_);
+		}));
+	}
+	else if (sliceCount <= 1) {
+		auto queue = graph.add("render queue", [this, frame]() { buildRenderQueue(frame); });
+		auto record = graph.add("record", [&]() {
+			renderGraph_.setSecondaryCommandBuffers(renderGraphNodes_.draw, false);
+			renderGraph_.setRecord(renderGraphNodes_.draw, [&](VkCommandBuffer commandBuffer) {
+				sliceStateChanges_[0] = recordDrawItems(commandBuffer, vertexBuffer, indexBuffer, 0, itemCount);
+			});
+			renderGraph_.execute(frameResources.commandBuffer, currentFrameIndex_);
+		});
+		graph.depend(record, queue);
+		submitDependencies.push_back(record);
+	}
+	else {
+		auto queue = graph.add("render queue", [this, frame]() { buildRenderQueue(frame); });
+		// slices only read render pass / framebuffer of graph, so graph is touched after all of them
+		auto execute = graph.add("execute", [&]() {
+			renderGraph_.setSecondaryCommandBuffers(renderGraphNodes_.draw, true);
+			renderGraph_.setRecord(renderGraphNodes_.draw, [&](VkCommandBuffer commandBuffer) {
+				vkCmdExecuteCommands(commandBuffer, sliceCount, frameResources.secondaryCommandBuffers.data());
+			});
+			renderGraph_.execute(frameResources.commandBuffer, currentFrameIndex_);
+		});
+		for (std::uint32_t slice = 0; slice < sliceCount; ++slice) {
+			auto record = graph.add("record slice", [&, slice]() { recordDrawSlice(slice, sliceCount, vertexBuffer, indexBuffer, itemCount); });
+			graph.depend(record, queue);
+			graph.depend(execute, record);
+		}
+		submitDependencies.push_back(execute);
+	}
+
+	// queue submit and present stay on main thread (window system)
+	auto submit = graph.add("submit", [&]() {
+		frameTimings_.recordMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - graphBeginTime).count();
+		if (!gpuDriven_) {
+			frameTimings_.drawCount += itemCount;
+			for (std::uint32_t slice = 0; slice < std::max(sliceCount, 1u); ++slice) {
+				frameTimings_.pipelineChanges += sliceStateChanges_[slice].pipelines;
+				frameTimings_.materialChanges += sliceStateChanges_[slice].materials;
+			}
+		}
+		endFrame();
+	}, true);
+	for (auto dependency : submitDependencies) graph.depend(submit, dependency);
+
+	jobSystem_->run(graph);
+}
+
+void GraphicsEngine::draw() {
+	// minimized: nothing to present, do not spin
+	if (!beginFrame()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		return;
+	}
+
+	drawFrame(frame_, vertexBuffer_.buffer, indexBuffer_.buffer, 1);
+	++frame_;
+
+	if (frameTimings_.frameCount == frameTimingReportInterval) {
+		printFrameTimings();
+		resetFrameTimings();
+	}
+}
+
+void GraphicsEngine::benchmarkMemoryPlacement(std::uint32_t frameCount) {
+	if (!properties_.limits.timestampComputeAndGraphics) {
+		std::cerr << "[benchmarkMemoryPlacement] timestamps are not supported on graphics queue" << std::endl;
+		return;
+	}
+
+	// copies of geometry in the previous placement (host visible, read by GPU over the bus on discrete devices)
+	auto indexBufferSize = indexBuffer_.size * (indexBuffer_.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(std::uint16_t) : sizeof(std::uint32_t));
+
+	VkBuffer hostVertexBuffer = VK_NULL_HANDLE, hostIndexBuffer = VK_NULL_HANDLE;
+	MemoryAllocator::Allocation hostVertexAllocation{}, hostIndexAllocation{};
+
+	createBuffer(vertexBuffer_.size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostVertexBuffer);
+	allocateDeviceMemory(hostVertexBuffer, hostVertexAllocation, MemoryAllocator::MemoryUsage::Upload);
+	createBuffer(indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostIndexBuffer);
+	allocateDeviceMemory(hostIndexBuffer, hostIndexAllocation, MemoryAllocator::MemoryUsage::Upload);
+
+	// vertexBuffer_ / indexBuffer_ have no CPU copy anymore -> copy on GPU
+	submitCommandsOnce([&]() {
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer_, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		VkBufferCopy vertexRegion{ 0, 0, vertexBuffer_.size };
+		VkBufferCopy indexRegion{ 0, 0, indexBufferSize };
+		vkCmdCopyBuffer(commandBuffer_, vertexBuffer_.buffer, hostVertexBuffer, 1, &vertexRegion);
+		vkCmdCopyBuffer(commandBuffer_, indexBuffer_.buffer, hostIndexBuffer, 1, &indexRegion);
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer_, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	});
+
+	// model is drawn several times per frame so vertex fetch dominates over clear / resolve
+	constexpr std::uint32_t drawRepeatCount = 16;
+
+	std::uint64_t triangleCount = 0;
+	for (const auto& object : scene_.objects()) {
+		const auto& range = models_[object.model];
+		for (auto i = range.firstMaterial; i < range.firstMaterial + range.materialCount; ++i) {
+			triangleCount += materials_[i].indexCount / 3;
+		}
+	}
+	triangleCount *= drawRepeatCount * instanceCount_;
+
+	// GPU time from frame timestamps, frames still overlap with CPU as in draw()
+	auto measure = [&](VkBuffer vertexBuffer, VkBuffer indexBuffer) {
+		waitFrames();
+		resetFrameTimings();
+
+		for (std::uint32_t frame = 0; frame < frameCount; ++frame) {
+			if (!beginFrame()) continue;
+			drawFrame(frame, vertexBuffer, indexBuffer, drawRepeatCount);
+		}
 
-	acquireNextImage();
-}
\ No newline at end of file
+		waitFrames();
+		auto milliseconds = frameTimings_.gpuMilliseconds / std::max(frameTimings_.gpuFrameCount, 1u);
+		resetFrameTimings();
+
+		return milliseconds;
+	};
+
+	// one untimed pass per placement so first touch / cache warm up is not measured
+	measure(hostVertexBuffer, hostIndexBuffer);
+	auto hostMilliseconds = measure(hostVertexBuffer, hostIndexBuffer);
+	measure(vertexBuffer_.buffer, indexBuffer_.buffer);
+	auto deviceMilliseconds = measure(vertexBuffer_.buffer, indexBuffer_.buffer);
+
+	auto print = [&](const char* name, double milliseconds) {
+		std::cout << "  " << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(9) << milliseconds << " ms/frame  "
+			<< std::setw(9) << triangleCount / (milliseconds * 1e3) << " Mtri/s" << std::endl;
+	};
+
+	auto flags = std::cout.flags();
+	auto precision = std::cout.precision();
+
+	std::cout << "memory placement benchmark (" << frameCount << " frames, " << triangleCount << " triangles per frame, GPU time)" << std::endl;
+	print("host visible", hostMilliseconds);
+	print("device local", deviceMilliseconds);
+	std::cout << "  speedup " << std::setprecision(2) << hostMilliseconds / deviceMilliseconds << "x" << std::endl;
+
+	std::cout.flags(flags);
+	std::cout.precision(precision);
+
+	vkDestroyBuffer(device_, hostVertexBuffer, allocator);
+	freeDeviceMemory(hostVertexAllocation);
+	vkDestroyBuffer(device_, hostIndexBuffer, allocator);
+	freeDeviceMemory(hostIndexAllocation);
+}
+
+void GraphicsEngine::benchmarkRecording(std::uint32_t frameCount) {
+	// many copies of model, so recording (bind + draw per material) dominates CPU time of frame
+	constexpr std::uint32_t drawRepeatCount = 64;
+	constexpr std::array<std::uint32_t, 7> threadCounts{ 1, 2, 3, 4, 8, 12, 16 };
+
+	auto drawCount = drawRepeatCount * scenePacketCount_;
+	auto originalThreadCount = recordThreadCount_;
+
+	auto measure = [&](std::uint32_t threadCount) {
+		waitFrames();
+		applyRecordThreads(threadCount);
+		resetFrameTimings();
+
+		for (std::uint32_t frame = 0; frame < frameCount; ++frame) {
+			if (!beginFrame()) continue;
+			drawFrame(frame, vertexBuffer_.buffer, indexBuffer_.buffer, drawRepeatCount);
+		}
+
+		waitFrames();
+		auto milliseconds = frameTimings_.recordMilliseconds / std::max(frameTimings_.frameCount, 1u);
+		resetFrameTimings();
+
+		return milliseconds;
+	};
+
+	auto flags = std::cout.flags();
+	auto precision = std::cout.precision();
+
+	std::cout << "recording benchmark (" << frameCount << " frames, " << drawCount << " draws per frame, " << std::thread::hardware_concurrency() << " hardware threads, CPU time)" << std::endl;
+
+	// untimed pass warms up pools and caches
+	measure(1);
+
+	double baseMilliseconds = 0.0;
+	for (auto threadCount : threadCounts) {
+		auto milliseconds = measure(threadCount);
+		if (threadCount == 1) baseMilliseconds = milliseconds;
+
+		std::cout << "  " << std::setw(2) << threadCount << " threads " << std::fixed << std::setprecision(3)
+			<< std::setw(9) << milliseconds << " ms/frame  "
+			<< std::setw(9) << drawCount / (milliseconds * 1e3) << " Mdraws/s  "
+			<< std::setprecision(2) << baseMilliseconds / milliseconds << "x" << std::endl;
+	}
+
+	std::cout.flags(flags);
+	std::cout.precision(precision);
+
+	waitFrames();
+	applyRecordThreads(originalThreadCount);
+}
+
+void GraphicsEngine::captureJobTrace(const std::filesystem::path& path, std::uint32_t frameCount) {
+	waitFrames();
+	jobSystem_->beginTrace();
+
+	for (std::uint32_t frame = 0; frame < frameCount; ++frame) {
+		if (!beginFrame()) continue;
+		drawFrame(frame_, vertexBuffer_.buffer, indexBuffer_.buffer, 1);
+		++frame_;
+	}
+
+	waitFrames();
+	jobSystem_->endTrace(path);
+	resetFrameTimings();
+}
@@ -8,14 +8,30 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
+#include <deque>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
 #include <vector>
 
+#include "MemoryAllocator.h"
+#include "TexEncoder.h"
 #include "TexLoader.h"
+#include "TextureCache.h"
+#include "JobSystem.h"
+#include "PipelineCache.h"
+#include "PipelineManager.h"
+#include "RenderGraph.h"
+#include "RenderQueue.h"
+#include "Scene.h"
 
 #include "PMXLoader.h"
 
@@ -40,15 +56,87 @@ struct MaterialBufferObject {
 	float specCoef;
 	glm::vec3 ambient;
 	std::uint32_t isTextureUsed;
-	std::uint32_t isSphereUsed;
+	// 0: none, 1: multiply, 2: add
+	std::uint32_t sphereMode;
 	std::uint32_t isToonUsed;
 };
 
+// std430 element of bindless material buffer (binding 1 of bindless.frag), indices address bindless texture array
+struct MaterialRecord {
+	glm::vec4 diffuse;
+	glm::vec3 specular;
+	float specCoef;
+	glm::vec3 ambient;
+	std::uint32_t isTextureUsed;
+	std::uint32_t sphereMode;
+	std::uint32_t isToonUsed;
+	std::uint32_t textureIndex;
+	std::uint32_t sphereIndex;
+	std::uint32_t toonIndex;
+	std::uint32_t padding[3];
+};
+
+// std430 element of GPU-driven draw records (cull.comp / indirect.vert), one per material draw of an instance
+struct DrawRecord {
+	glm::mat4 model;
+	// model space center (xyz) and radius (w)
+	glm::vec4 boundingSphere;
+	std::uint32_t materialIndex;
+	std::uint32_t indexCount;
+	std::uint32_t firstIndex;
+	std::int32_t vertexOffset;
+	// first bone of instance's palette in shared bone buffer
+	std::uint32_t boneOffset;
+	std::uint32_t padding[3];
+};
+
+// std430 element of instance buffer (binding 6 of basic.vert), indexed by gl_InstanceIndex
+struct InstanceRecord {
+	glm::mat4 model;
+	glm::mat4 normalMatrix;
+	// first bone of instance's palette in shared bone buffer
+	std::uint32_t boneOffset;
+	std::uint32_t padding[3];
+};
+
+// uniform block of cull.comp
+struct CullParameters {
+	glm::mat4 viewProjection;
+	glm::vec4 frustumPlanes[6];
+	std::uint32_t drawCount;
+	std::uint32_t compact;
+	// 1 -> two phase occlusion culling against Hi-Z
+	std::uint32_t occlusion;
+};
+
 struct Bone {
 	glm::mat4 matrix;
 };
 
+// swapchain and frame pacing options of GraphicsEngine::initialize
+struct PresentSettings {
+	// FIFO is always supported, other modes fall back to it
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	// 0 -> one more than frames in flight (2 with low latency pacing)
+	std::uint32_t imageCount = 0;
+	// frames are serialized and input is sampled as late as the measured frame cost allows
+	bool lowLatency = false;
+	// budget from input sampling to end of GPU work (low latency only), 0 -> measured CPU + GPU time
+	double targetLatencyMilliseconds = 0.0;
+};
+
 class GraphicsEngine {
+public:
+	// load-time block compression of PNG/JPEG/BMP textures (cooked result is cached on disk)
+	enum class TextureCompression {
+		None,
+		// BC1 (opaque) / BC3 (alpha)
+		Fast,
+		// BC7
+		Quality,
+	};
+
+private:
 	// engine version information (requires C++17 or later)
 	static constexpr std::string_view engineName = "VulkanGraphicsEngine";
 	static constexpr std::uint32_t engineVersion = VK_MAKE_API_VERSION(0, 0, 1, 0);
@@ -60,38 +148,260 @@ class GraphicsEngine {
 
 	struct VertexBuffer {
 		VkBuffer buffer;
-		VkDeviceMemory memory;
+		MemoryAllocator::Allocation allocation;
+		std::size_t size;
 	};
 
 	struct IndexBuffer {
 		VkBuffer buffer;
-		VkDeviceMemory memory;
+		MemoryAllocator::Allocation allocation;
 		std::size_t size;
 		VkIndexType indexType;
 	};
 
-	template<typename T>
-	struct UniformBuffer {
-		using type = T;
+	struct StorageBuffer {
+		VkBuffer buffer;
+		MemoryAllocator::Allocation allocation;
+		std::size_t size;
+	};
 
+	// host visible ring for per-frame data (transforms, bone palette, material parameters)
+	// one region per frame in flight, slices are handed out by bumping head and bound by dynamic offsets
+	struct FrameRingBuffer {
+		std::size_t regionSize;
+		std::size_t alignment;
+		std::size_t regionOffset;
+		std::size_t head;
 		VkBuffer buffer;
-		VkDeviceMemory memory;
+		MemoryAllocator::Allocation allocation;
 		std::uint8_t* pointer;
 	};
 
-	struct StorageBuffer {
-		std::size_t size;
+	// dynamic offsets of current frame's slices
+	struct FrameDataOffsets {
+		std::uint32_t transform;
+		std::uint32_t materials;
+		std::uint32_t materialStride;
+		std::uint32_t bones;
+		std::uint32_t instances;
+		std::uint32_t cullParameters;
+		std::uint32_t drawRecords;
+	};
+
+	// mapped destinations of FrameDataOffsets, filled by frame tasks
+	struct FrameDataPointers {
+		std::uint8_t* transform;
+		std::uint8_t* materials;
+		std::uint8_t* bones;
+		std::uint8_t* instances;
+		std::uint8_t* cullParameters;
+		std::uint8_t* drawRecords;
+	};
+
+	// GPU written draw counts + VkDrawIndexedIndirectCommand lists (early / late pass), one region per frame in flight
+	struct IndirectDrawBuffer {
 		VkBuffer buffer;
-		VkDeviceMemory memory;
-		std::uint8_t* pointer;
+		MemoryAllocator::Allocation allocation;
+		std::size_t regionSize;
+		// commands follow draw counts in region
+		std::size_t commandOffset;
+	};
+
+	// fixed function state that differs between pipelines of one render pass
+	struct PipelineState {
+		VkCompareOp depthCompareOp;
+		VkBool32 depthWrite;
+		VkBool32 blend;
+	};
+
+	// node of forward frame graph (CPU recorded path), all nodes run inside forward pass of render graph in RenderQueue::Pass order
+	struct ForwardPass {
+		RenderQueue::Pass pass;
+		PipelineState state;
+	};
+
+	// max depth pyramid (R32F, level 0 = depth image size), rebuilt every frame from early pass depth
+	// image is a transient of render graph, per level views and descriptor sets are owned here
+	struct HiZPyramid {
+		VkExtent2D size;
+		std::uint32_t mipLevels;
+		std::vector<VkImageView> mipViews;
+		// level i: depth (i == 0) or level i - 1 -> level i
+		std::vector<VkDescriptorSet> buildDescriptorSets;
+		// whole pyramid, read by late cull pass
+		VkDescriptorSet cullDescriptorSet;
 	};
 
 	struct Texture {
 		VkImage image;
-		VkDeviceMemory memory;
+		MemoryAllocator::Allocation allocation;
 		VkImageView view;
+		std::uint32_t mipLevels;
+		std::uint64_t contentHash;
+		// alpha is 1 everywhere (see TexImage::opaque)
+		bool opaque;
+	};
+
+	// host visible ring for CPU -> GPU copies
+	// [tail, head) (wrapping) is referenced by pending or in flight uploads, head == tail -> empty
+	struct StagingBuffer {
+		std::size_t size;
+		std::size_t head;
+		std::size_t tail;
+		VkBuffer buffer;
+		MemoryAllocator::Allocation allocation;
+		std::uint8_t* pointer;
+	};
+
+	struct TextureUpload {
+		VkImage image;
+		VkExtent3D size;
+		std::uint32_t mipLevels;
+		std::uint32_t arrayLayers;
+		// levels [1, mipLevels) are blitted from level 0
+		bool generateMips;
+		std::vector<VkBufferImageCopy> regions;
+	};
+
+	struct BufferUpload {
+		VkBuffer buffer;
+		VkBufferCopy region;
+	};
+
+	// per frame in flight resources, reused once fence signals
+	struct Frame {
+		VkCommandPool commandPool;
+		VkCommandBuffer commandBuffer;
+		// signaled when GPU finished this frame (created signaled)
+		VkFence fence;
+		VkSemaphore imageAvailableSemaphore;
+		// begin / end of frame timestamps (VK_NULL_HANDLE if not supported)
+		VkQueryPool timestampQueryPool;
+		bool timestampsWritten;
+		// when input shown by this frame was sampled
+		std::chrono::steady_clock::time_point inputSampleTime;
+		// frameSerial_ of last submit from this slot
+		std::uint64_t serial;
+		// one pool + secondary command buffer per recording thread (pools are not thread safe)
+		std::vector<VkCommandPool> recordCommandPools;
+		std::vector<VkCommandBuffer> secondaryCommandBuffers;
+	};
+
+	// size dependent resources replaced by recreateSwapchain, destroyed once frames that used them retire
+	struct RetiredSwapchain {
+		std::uint64_t frameSerial;
+		VkSwapchainKHR swapchain;
+		std::vector<VkImageView> imageViews;
+		std::vector<VkSemaphore> renderFinishedSemaphores;
+		// transient images, render passes and framebuffers
+		RenderGraph renderGraph;
+		HiZPyramid hiZPyramid;
+	};
+
+	// low latency pacing state (moving averages)
+	struct FramePacing {
+		double refreshMilliseconds;
+		double cpuMilliseconds;
+		double gpuMilliseconds;
+		// image release observed through acquire fence (vblank with double buffered FIFO)
+		std::chrono::steady_clock::time_point imageReleaseTime;
+		bool imageAcquired;
+		VkFence acquireFence;
+	};
+
+	// maps GPU timestamps to steady_clock
+	struct TimestampCalibration {
+		std::chrono::steady_clock::time_point cpuTime;
+		std::uint64_t gpuTimestamp;
 	};
 
+	// accumulated since last report
+	struct FrameTimings {
+		std::chrono::steady_clock::time_point beginTime;
+		std::uint32_t frameCount;
+		// recording, submit and present
+		double cpuMilliseconds;
+		// blocked on frame fence
+		double waitMilliseconds;
+		double gpuMilliseconds;
+		std::uint32_t gpuFrameCount;
+		// frame task graph up to submit: frame data + recording (part of cpu)
+		double recordMilliseconds;
+		// input sampling to end of GPU work of that frame
+		double latencyMilliseconds;
+		double maxLatencyMilliseconds;
+		// render queue emission (CPU recorded path)
+		std::uint64_t drawCount;
+		std::uint64_t pipelineChanges;
+		std::uint64_t materialChanges;
+	};
+
+	// resources and passes of renderGraph_ (unused ones stay 0)
+	struct RenderGraphNodes {
+		RenderGraph::ResourceId color;
+		RenderGraph::ResourceId depth;
+		RenderGraph::ResourceId hiZ;
+		RenderGraph::ResourceId indirectDraws;
+		RenderGraph::ResourceId visibility;
+		// only cull pass without occlusion culling
+		RenderGraph::PassId earlyCull;
+		// forward pass (CPU recorded path), pipelines and secondary command buffers are made against it
+		RenderGraph::PassId draw;
+		RenderGraph::PassId hiZBuild;
+		RenderGraph::PassId lateCull;
+		RenderGraph::PassId lateDraw;
+	};
+
+	// materials of one loaded model inside merged material list
+	struct ModelRange {
+		std::uint32_t firstMaterial;
+		std::uint32_t materialCount;
+	};
+
+	// pending uploads submitted together, retired when fence signals
+	struct UploadBatch {
+		std::uint64_t serial;
+		// copies (+ queue family ownership release) on transfer queue
+		VkCommandBuffer transferCommandBuffer;
+		// ownership acquire, mip generation and final layouts on graphics queue (dedicated transfer family only)
+		VkCommandBuffer graphicsCommandBuffer;
+		VkSemaphore transferSemaphore;
+		VkFence fence;
+		// staging head at submit, becomes tail when retired
+		std::size_t stagingEnd;
+	};
+
+	static constexpr std::size_t stagingBufferSize = 64 * 1024 * 1024;
+	static constexpr std::uint32_t maxFramesInFlight = 3;
+	static constexpr std::uint32_t maxRecordThreads = 16;
+	static constexpr std::uint32_t frameTimingReportInterval = 300;
+	static constexpr const char* textureCacheDirectory = "cache/textures";
+	// part of cooked file name, bumped when cooked content changes (2: alpha mode is written)
+	static constexpr std::uint32_t cookedTextureVersion = 2;
+	static constexpr const char* pipelineCachePath = "cache/pipelines.bin";
+	// upper bound of bindless texture array (further limited by maxPerStageDescriptorSampledImages)
+	static constexpr std::uint32_t maxBindlessTextures = 4096;
+	// draw repeats (benchmarks) GPU-driven buffers are sized for, more are clamped
+	static constexpr std::uint32_t maxIndirectRepeatCount = 16;
+	// local_size_x of cull.comp
+	static constexpr std::uint32_t cullGroupSize = 64;
+	// local_size_x / y of hiz.comp
+	static constexpr std::uint32_t hiZGroupSize = 8;
+	static constexpr std::uint32_t maxHiZLevels = 16;
+	// Hi-Z descriptor pool: current pyramid + pyramids retired with swapchains still used by frames in flight
+	static constexpr std::uint32_t hiZPyramidCapacity = maxFramesInFlight + 1;
+	// background threads compiling pipeline variants
+	static constexpr std::uint32_t pipelineCompileThreads = 2;
+	// PMX_Material::flags bit: both faces are drawn
+	static constexpr std::uint8_t doubleSidedFlag = 0x01;
+	// materialFeatures bits, specialization constant 0 of basic.frag / bindless.frag (all ones -> read from material)
+	static constexpr std::uint32_t textureFeature = 0x1;
+	static constexpr std::uint32_t toonFeature = 0x2;
+	static constexpr std::uint32_t sphereModeShift = 2;
+	static constexpr std::uint32_t dynamicMaterialFeatures = UINT32_MAX;
+	static constexpr float nearPlane = 0.1f;
+	static constexpr float farPlane = 100.0f;
+
 	VkExtent2D imageSize_;
 
 	std::uint32_t frame_;
@@ -99,27 +409,64 @@ class GraphicsEngine {
 	VkInstance instance_;
 	VkDevice device_;
 
+	SDL_Window* window_;
 	VkSurfaceKHR surface_;
 	VkSwapchainKHR swapchain_;
+	// set on resize or suboptimal acquire / present, swapchain is recreated before next acquire
+	bool swapchainOutdated_;
+	std::vector<RetiredSwapchain> retiredSwapchains_;
 
 	VkPhysicalDevice physicalDevice_;
 	VkPhysicalDeviceProperties properties_;
 	VkPhysicalDeviceMemoryProperties memoryProperties_;
+	VkPhysicalDeviceFeatures supportedFeatures_;
+	// zeroed when device is older than Vulkan 1.2
+	VkPhysicalDeviceVulkan12Features supportedFeatures12_;
+	MemoryAllocator memoryAllocator_;
 	std::uint32_t queueFamilyIndex_;
 	VkQueue deviceQueue_;
+	// same as queueFamilyIndex_ / deviceQueue_ when device has no dedicated transfer family
+	std::uint32_t transferQueueFamilyIndex_;
+	VkQueue transferQueue_;
 
 	VkCommandPool commandPool_;
+	// one time commands (submitCommandsOnce)
 	VkCommandBuffer commandBuffer_;
 
-	VkFence fence_;
+	std::uint32_t framesInFlight_ = 2;
+	std::array<Frame, maxFramesInFlight> frames_;
+	std::uint32_t frameIndex_;
+	// submitted / known finished frames, frames finish in submission order
+	std::uint64_t frameSerial_;
+	std::uint64_t completedFrameSerial_;
+	// job system threads (main thread included) = record slices, 1 -> draws recorded inline into primary command buffer
+	std::uint32_t recordThreadCount_ = 1;
+	std::unique_ptr<JobSystem> jobSystem_;
+	TaskGraph frameGraph_;
+	// per swapchain image: free again once image is acquired again
+	std::vector<VkSemaphore> renderFinishedSemaphores_;
+	FrameTimings frameTimings_;
+	std::chrono::steady_clock::time_point frameCpuBeginTime_;
+	PresentSettings presentSettings_;
+	FramePacing framePacing_;
+	TimestampCalibration timestampCalibration_;
+	std::chrono::steady_clock::time_point inputSampleTime_;
+
+	StagingBuffer stagingBuffer_;
+	std::vector<TextureUpload> pendingTextureUploads_;
+	std::vector<BufferUpload> pendingBufferUploads_;
+	VkCommandPool uploadCommandPool_;
+	// in flight, oldest first
+	std::deque<UploadBatch> uploadBatches_;
+	std::vector<UploadBatch> freeUploadBatches_;
+	std::uint64_t uploadSerial_;
+	std::uint64_t completedUploadSerial_;
 	
 	std::vector<VkImage> defaultImages_;
 	std::vector<VkImageView> defaultImageViews_;
-	VkImage defaultDepthImage_;
-	VkDeviceMemory defaultDepthImageMemory_;
-	VkImageView defaultDepthImageView_;
-	VkRenderPass defaultRenderPass_;
-	std::vector<VkFramebuffer> defaultFramebuffers_;
+	// passes of one frame, rebuilt with swapchain (swapchain image, depth and Hi-Z are its resources)
+	RenderGraph renderGraph_;
+	RenderGraphNodes renderGraphNodes_;
 	std::uint32_t currentFrameIndex_;
 
 	VertexBuffer vertexBuffer_;
@@ -127,27 +474,106 @@ class GraphicsEngine {
 	IndexBuffer indexBuffer_;
 
 	std::vector<Texture> textures_{};
+	std::uint32_t maxTextureMipLevels_;
+	TextureCompression textureCompression_ = TextureCompression::None;
 	VkSampler textureSampler_;
 	VkSampler toonSampler_;
 
-	UniformBuffer<TransformBufferObject> transformBuffer_;
-	std::vector<UniformBuffer<MaterialBufferObject>> materialBuffers_;
-	StorageBuffer boneBuffer_;
+	FrameRingBuffer frameRingBuffer_;
+	FrameDataOffsets frameDataOffsets_;
+	FrameDataPointers frameDataPointers_;
+	std::vector<MaterialBufferObject> materialParameters_;
+
+	// requested by setBindless, cleared in initialize when device lacks descriptor indexing
+	bool bindless_ = true;
+	// bindless: static material records indexed by push constant
+	StorageBuffer materialBuffer_;
+	VkDescriptorSet bindlessDescriptorSet_;
+
+	// GPU-driven: draw records are frustum culled by compute and drawn with one indirect call (requires bindless)
+	bool gpuDriven_ = true;
+	// survivors are compacted and counted on GPU (vkCmdDrawIndexedIndirectCount)
+	bool drawIndirectCount_;
+	std::vector<glm::vec4> materialBounds_;
+	IndirectDrawBuffer indirectDrawBuffer_;
+	VkShaderModule indirectVertexShaderModule_;
+	VkShaderModule indirectFragmentShaderModule_;
+	VkShaderModule cullShaderModule_;
+	// set 0 of cull pass, set 1 of indirect draw (draw records)
+	VkDescriptorSetLayout indirectDescriptorSetLayout_;
+	VkDescriptorPool indirectDescriptorPool_;
+	VkDescriptorSet indirectDescriptorSet_;
+	VkPipelineLayout indirectPipelineLayout_;
+	VkPipeline indirectGraphicsPipeline_;
+	VkPipelineLayout cullPipelineLayout_;
+	VkPipeline cullPipeline_;
+
+	// two phase occlusion culling (GPU-driven only): last frame's visible draws -> Hi-Z -> rest tested against it
+	bool occlusionCulling_ = true;
+	// per draw record: visible in last late cull pass
+	StorageBuffer visibilityBuffer_;
+	HiZPyramid hiZPyramid_{};
+	VkSampler hiZSampler_;
+	VkShaderModule hiZShaderModule_;
+	VkDescriptorSetLayout hiZBuildDescriptorSetLayout_;
+	VkDescriptorSetLayout hiZCullDescriptorSetLayout_;
+	// sets are freed when their pyramid retires
+	VkDescriptorPool hiZDescriptorPool_;
+	VkPipelineLayout hiZPipelineLayout_;
+	VkPipeline hiZPipeline_;
 
 	VkShaderModule vertexShaderModule_;
 	VkShaderModule fragmentShaderModule_;
+	// position only, depth prepass
+	VkShaderModule depthVertexShaderModule_;
 
 	VkDescriptorSetLayout defaultDescriptorSetLayout_;
 	VkDescriptorPool defaultDescriptorPool_;
 	std::vector<VkDescriptorSet> defaultDescriptorSets_;
 
 	VkPipelineLayout defaultPipelineLayout_;
-	VkPipeline defaultGraphicsPipeline_;
+
+	// every pipeline is created through it, loaded in initialize and written by savePipelineCache
+	PipelineCache pipelineCache_;
+	// false -> cache file is ignored at startup (cold pipeline creation)
+	bool loadPipelineCache_ = true;
+	// graphics pipeline variants by state key, created through pipelineCache_
+	PipelineManager pipelineManager_;
 
 	std::uint32_t numIndices_;
 	std::vector<PMX_Material> materials_;
+	// classified at load: diffuse alpha < 1 or texture with alpha -> blended in transparent pass
+	std::vector<bool> transparentMaterials_;
 	std::vector<Bone> bones_;
 
+	// models are merged into one vertex / index buffer, material list and bone palette at load time
+	Scene scene_;
+	std::vector<ModelRange> models_;
+	// material draws of all scene objects
+	std::uint32_t sceneDrawCount_;
+	// draw records per frame of GPU-driven path (material draws x instances x maxIndirectRepeatCount), constant 0 of cull.comp
+	std::uint32_t indirectDrawCapacity_ = 1;
+	// render queue packets per frame: material draws + depth prepass draws of opaque materials
+	std::uint32_t scenePacketCount_;
+	RenderQueue renderQueue_;
+	// opaque materials are laid down in depth only pass first, then shaded with EQUAL test (no overdraw)
+	bool depthPrepass_ = true;
+	// built from depthPrepass_ by buildForwardPasses
+	std::vector<ForwardPass> forwardPasses_;
+	// pipelineManager_ variants of each RenderQueue::Pass (invalidId -> pass is not in graph)
+	// [0]: generic (both faces, features read from material), [1]: depth pass only, back faces culled (single sided materials)
+	std::array<std::array<PipelineManager::PipelineId, 2>, RenderQueue::passCount> passPipelines_;
+	// shading variant of each material: its features and cull mode baked in, pass generic until compiled
+	// (with depth prepass: until its depth variant is compiled as well, see buildRenderQueue)
+	std::vector<PipelineManager::PipelineId> materialPipelines_;
+	// written by record slice i, summed at submit
+	std::array<RenderQueue::StateChanges, maxRecordThreads> sliceStateChanges_;
+
+	// copies of model drawn by one instanced draw per material, each with own transform and bone palette
+	std::uint32_t instanceCount_ = 1;
+	// palettes in shared bone buffer, instance i uses palette i % count
+	std::uint32_t bonePaletteCount_ = 1;
+
 	// resorce creation
 
 	void createInstance(const char*, std::uint32_t, const std::vector<const char*>&, const std::vector<const char*>&);
@@ -156,24 +582,28 @@ class GraphicsEngine {
 
 	void getPhysicalDevice();
 	void getQueueFamilyIndex();
+	bool isBindlessSupported();
 
 	void createDevice(const std::vector<const char*>&, const std::vector<const char*>&);
 	void getDeviceQueue();
 
+	VkExtent2D surfaceExtent(const VkSurfaceCapabilitiesKHR&);
 	void createSwapchain();
+	// false while window is minimized (zero extent)
+	bool recreateSwapchain();
+	void destroyRetiredSwapchains();
 
 	void createDefaultImages();
 	void createDefaultImageViews();
-	void createDefaultDepthImage();
-	void createDefaultDepthImageView();
-	void createDefaultRenderPass();
-	void createDefaultFramebuffers();
+	// depth (+ Hi-Z) transients, passes of current path, compiled against current swapchain
+	void buildRenderGraph();
 
 	void createBuffer(std::size_t, VkBufferUsageFlags, VkBuffer&);
-	void createImage2D(VkFormat, const VkExtent3D&, VkImageUsageFlags, VkSampleCountFlagBits, VkImage&);
-	void createImageView2D(const VkImage&, VkFormat, const VkImageSubresourceRange&, VkImageView&);
+	void createImage2D(VkFormat, const VkExtent3D&, std::uint32_t, std::uint32_t, VkImageCreateFlags, VkImageUsageFlags, VkSampleCountFlagBits, VkImage&);
+	void createImageView2D(const VkImage&, VkImageViewType, VkFormat, const VkImageSubresourceRange&, VkImageView&);
 	template<typename T, std::enable_if_t<std::is_same_v<T, VkBuffer> || std::is_same_v<T, VkImage>, std::nullptr_t> = nullptr>
-	void allocateDeviceMemory(const T&, VkDeviceMemory&, VkMemoryPropertyFlags);
+	void allocateDeviceMemory(const T&, MemoryAllocator::Allocation&, MemoryAllocator::MemoryUsage);
+	void freeDeviceMemory(const MemoryAllocator::Allocation&);
 
 	template<typename T>
 	void createVertexBuffer(const std::vector<T>&, VertexBuffer&);
@@ -181,36 +611,81 @@ class GraphicsEngine {
 	template<typename T, std::enable_if_t<std::is_same_v<T, std::uint16_t> || std::is_same_v<T, std::uint32_t>, std::nullptr_t> = nullptr>
 	void createIndexBuffer(const std::vector<T>&, IndexBuffer&);
 
-	template<typename T>
-	void createUniformBuffer(UniformBuffer<T>&);
-	template<typename T>
-	void createConstantUnifromBuffer(const T&, UniformBuffer<T>&);
+	void createFrameRingBuffer(std::size_t, FrameRingBuffer&);
 
-	void createStorageBuffer(std::size_t, StorageBuffer&);
+	void createStagingBuffer(std::size_t, StagingBuffer&);
+	void destroyStagingBuffer(StagingBuffer&);
 
-	void createTexture(const std::vector<std::uint8_t>&, VkFormat, const VkExtent3D&, Texture&);
+	bool isMipmapGenerationSupported(VkFormat);
+	void createTexture(const TexImage&, std::size_t, Texture&);
+	bool stageDDS(const std::filesystem::path&, TexImage&, std::uint64_t&, std::size_t&);
+	std::filesystem::path cookedTexturePath(std::uint64_t);
+	bool loadTexture(const std::filesystem::path&, Texture&);
+	void releaseTexture(const Texture&);
+	void destroyTexture(const Texture&);
+	// appends model to merged textures, bones, materials and geometry
+	void loadModel(const std::filesystem::path&, std::vector<PMX_Vertex>&, std::vector<std::uint32_t>&, bool demoPose);
 	void createTextureSampler();
 	void createToonSampler();
 
+	void loadShaderModule(const char*, VkShaderModule&);
 	void createShaderModule(const char*, const char*);
 
 	void createDefaultDescriptorSetLayout();
 	void createDefaultDescriptorPool(std::uint32_t);
-	void createDefaultDescriptorSets(const UniformBuffer<MaterialBufferObject>&, const Texture&, const Texture&, const Texture&, VkDescriptorSet&);
+	void createDefaultDescriptorSets(const Texture&, const Texture&, const Texture&, VkDescriptorSet&);
+
+	void createMaterialBuffer();
+	void createBindlessDescriptorSetLayout();
+	void createBindlessDescriptorPool();
+	void createBindlessDescriptorSet();
+
+	void computeMaterialBounds(const std::vector<PMX_Vertex>&, const PMX_Indices&);
+	void createIndirectDrawBuffer();
+	void createIndirectDescriptorSetLayout();
+	void createIndirectDescriptorPool();
+	void createIndirectDescriptorSet();
+	void createVisibilityBuffer();
+
+	void createHiZSampler();
+	void createHiZDescriptorSetLayouts();
+	void createHiZDescriptorPool();
+	void createHiZPyramid();
+	void destroyHiZPyramid(const HiZPyramid&);
 
 	void createDefaultPipelineLayout();
-	void createDefaultGraphicsPipeline();
+	// attachments of render graph's draw passes, no culling
+	GraphicsPipelineDesc pipelineDesc(VkShaderModule, VkShaderModule, VkPipelineLayout, const PipelineState&);
+	// PipelineManager::CreateFunction, also runs on its background threads (result is returned instead of VK_CHECK)
+	VkResult createGraphicsPipeline(const GraphicsPipelineDesc&, VkRenderPass, VkPipeline&);
+	// PMX sphere mode the shaders support (sub texture -> none)
+	static std::uint32_t sphereMode(const PMX_Material&);
+	// specialization of shading pipeline drawing material
+	static std::uint32_t materialFeatures(const PMX_Material&);
+	void buildForwardPasses();
+	void createForwardPipelines();
+	void createIndirectPipelineLayout();
+	void createCullPipeline();
+	void createHiZPipeline();
 
 	void createCommandPool();
 	void createCommandBuffer();
 
-	void createFence();
+	void createFrames();
+	void createRenderFinishedSemaphores();
+	void calibrateTimestamps();
+	void createRecordCommandBuffers();
+	void applyRecordThreads(std::uint32_t);
+
+	void createUploadCommandPool();
+	void createUploadBatch(UploadBatch&);
 
 	// ----------------
 
 	// command utilities
 
-	void acquireNextImage();
+	// false -> no image this frame (window minimized)
+	bool acquireNextImage();
 	
 	void beginCommand();
 	void endCommand();
@@ -221,11 +696,55 @@ class GraphicsEngine {
 
 	void present();
 
-	VkResult waitFence();
-	void resetFence();
-
-	void beginRenderPass();
-	void endRenderPass();
+	std::size_t reserveStagingData(std::size_t);
+	std::size_t stageData(const void*, std::size_t);
+	void uploadBuffer(VkBuffer, const void*, std::size_t);
+	std::uint64_t flushUploads();
+	void retireUploads(bool);
+	void waitUploads(std::uint64_t);
+
+	// false -> frame skipped, nothing recorded
+	bool beginFrame();
+	void endFrame();
+	void waitFrames();
+	void readFrameTimestamps(Frame&);
+	void resetFrameTimings();
+	void printFrameTimings();
+
+	void beginFrameData(std::uint32_t);
+	// bytes reserveFrameData takes per frame (instances, palettes and bones are fixed at initialize)
+	std::size_t frameDataSize() const;
+	std::uint32_t allocateFrameData(std::size_t, std::uint8_t*&);
+	void reserveFrameData();
+	glm::mat4 modelMatrix(std::uint32_t);
+	// scene object placed on instance grid, spinning with modelMatrix
+	glm::mat4 instanceMatrix(std::uint32_t, std::uint32_t, std::uint32_t);
+	// instance records: object * instance count + instance
+	std::uint32_t instanceRecordCount() const { return static_cast<std::uint32_t>(scene_.objects().size()) * instanceCount_; }
+	std::uint32_t instanceBoneOffset(std::uint32_t);
+	void cameraMatrices(glm::mat4&, glm::mat4&);
+	void writeTransform(std::uint32_t);
+	void writeDrawRecords(std::uint32_t, std::uint32_t);
+	void writeBones();
+	void writeInstances(std::uint32_t);
+	// packets of all scene objects, sorted
+	void buildRenderQueue(std::uint32_t);
+	void writeMaterials();
+	void bindDefaultDescriptorSet(VkCommandBuffer, std::uint32_t);
+	void bindBindlessDescriptorSet(VkCommandBuffer);
+	// draw items [begin, end), item = repeat * packet count + sorted packet, each drawn for all instances
+	RenderQueue::StateChanges recordDrawItems(VkCommandBuffer, VkBuffer, VkBuffer, std::uint32_t, std::uint32_t);
+	void recordDrawSlice(std::uint32_t, std::uint32_t, VkBuffer, VkBuffer, std::uint32_t);
+	// in binding order of indirect set: cull parameters, draw records, commands, draw count
+	std::array<std::uint32_t, 4> indirectDynamicOffsets();
+	// outside render pass: phase 0 (early, also resets draw counts), phase 1 (late, after Hi-Z)
+	void recordCulling(VkCommandBuffer, std::uint32_t, std::uint32_t);
+	void recordHiZBuild(VkCommandBuffer);
+	void recordIndirectDraws(VkCommandBuffer, VkBuffer, VkBuffer, std::uint32_t, std::uint32_t);
+	// runs frame task graph (frame data, recording, submit + present) after beginFrame
+	void drawFrame(std::uint32_t, VkBuffer, VkBuffer, std::uint32_t);
+
+	void setViewport(VkCommandBuffer);
 
 	// -----------------
 
@@ -240,8 +759,49 @@ public:
 	GraphicsEngine(GraphicsEngine&&) = default;
 	GraphicsEngine& operator=(GraphicsEngine&&) = default;
 
-	void initialize(SDL_Window* window, const char* applicationName, std::uint32_t applicationVersion, const VkExtent2D& imageSize);
+	// must be called before initialize()
+	void setTextureCompression(TextureCompression compression) { textureCompression_ = compression; }
+	// 1 -> CPU and GPU are serialized
+	void setFramesInFlight(std::uint32_t count) { framesInFlight_ = std::clamp(count, 1u, maxFramesInFlight); }
+	// > 1 -> frame tasks run on this many job threads and material draws are split into as many secondary command buffers
+	void setRecordThreads(std::uint32_t count) { recordThreadCount_ = std::clamp(count, 1u, maxRecordThreads); }
+
+	// false -> one descriptor set per material (also used when device lacks descriptor indexing)
+	void setBindless(bool enable) { bindless_ = enable; }
+	// false -> one CPU recorded draw per material (also used without bindless or multi draw indirect)
+	void setGpuDriven(bool enable) { gpuDriven_ = enable; }
+	// false -> frustum culling only (GPU-driven path)
+	void setOcclusionCulling(bool enable) { occlusionCulling_ = enable; }
+	// false -> opaque materials are shaded with LESS test and depth writes, without prepass (CPU recorded path)
+	void setDepthPrepass(bool enable) { depthPrepass_ = enable; }
+	// must be called before initialize(), false -> pipelines are compiled from scratch (cache is still saved)
+	void setPipelineCacheLoad(bool enable) { loadPipelineCache_ = enable; }
+	// must be called before initialize(), empty -> built-in model
+	void setScene(const Scene& scene) { scene_ = scene; }
+	// must be called before initialize()
+	void setInstanceCount(std::uint32_t count) { instanceCount_ = std::max(count, 1u); }
+	// must be called before initialize(), clamped to instance count
+	void setBonePaletteCount(std::uint32_t count) { bonePaletteCount_ = std::max(count, 1u); }
+
+	void initialize(SDL_Window* window, const char* applicationName, std::uint32_t applicationVersion, const VkExtent2D& imageSize, const PresentSettings& presentSettings = PresentSettings{});
 	//void deinitialize();
 
+	// call at shutdown: pipelines compiled this run are reused by next one
+	void savePipelineCache();
+
+	// call right before polling input: with low latency pacing, blocks until the latest moment
+	// input can be sampled and still make next refresh, otherwise only records sampling time
+	void paceFrame();
+
+	// window size changed: swapchain and size dependent resources are rebuilt before next frame
+	void resize() { swapchainOutdated_ = true; }
+
 	void draw();
+
+	// GPU time of drawing the model from host visible vs device local vertex / index buffers
+	void benchmarkMemoryPlacement(std::uint32_t frameCount);
+	// CPU recording time of many model copies with 1 .. maxRecordThreads threads
+	void benchmarkRecording(std::uint32_t frameCount);
+	// draws frameCount frames and writes their task timings as Chrome trace JSON
+	void captureJobTrace(const std::filesystem::path& path, std::uint32_t frameCount);
 };
\ No newline at end of file
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit FNV-1a (pass previous result as value to continue over several chunks)
+inline std::uint64_t hashContent(const std::uint8_t* data, std::size_t size, std::uint64_t value = 0xcbf29ce484222325ull) {
+	for (std::size_t i = 0; i < size; ++i) {
+		value ^= data[i];
+		value *= 0x100000001b3ull;
+	}
+	return value;
+}
@@ -0,0 +1,230 @@
+#include "JobSystem.h"
+
+TaskGraph::TaskId TaskGraph::add(const char* name, std::function<void()> function, bool mainThread) {
+	Task task{};
+	task.name = name;
+	task.function = std::move(function);
+	task.dependencyCount = 0;
+	task.mainThread = mainThread;
+
+	tasks_.push_back(std::move(task));
+
+	return static_cast<TaskId>(tasks_.size() - 1);
+}
+
+void TaskGraph::depend(TaskId task, TaskId dependency) {
+	tasks_[dependency].dependents.push_back(task);
+	++tasks_[task].dependencyCount;
+}
+
+JobSystem::JobSystem(std::uint32_t threadCount) : graph_(nullptr), pendingCapacity_(0), remainingTasks_(0), queuedTasks_(0), queuedMainTasks_(0), stealCount_(0), quit_(false), tracing_(false), graphIndex_(0) {
+	if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	for (std::uint32_t i = 0; i < threadCount; ++i) queues_.push_back(std::make_unique<WorkQueue>());
+	traceEvents_.resize(threadCount);
+
+	for (std::uint32_t i = 1; i < threadCount; ++i) threads_.emplace_back(&JobSystem::workerMain, this, i);
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex_);
+		quit_ = true;
+	}
+	sleepCondition_.notify_all();
+
+	for (auto& thread : threads_) thread.join();
+}
+
+void JobSystem::push(std::uint32_t threadIndex, TaskGraph::TaskId taskId) {
+	// counted before it is visible, so a thread seeing an empty queue never sleeps on queued work
+	if (graph_->tasks_[taskId].mainThread) {
+		queuedMainTasks_.fetch_add(1);
+		{
+			std::lock_guard<std::mutex> lock(mainQueue_.mutex);
+			mainQueue_.tasks.push_back(taskId);
+		}
+		// main thread has to be the one that wakes up
+		{ std::lock_guard<std::mutex> lock(sleepMutex_); }
+		sleepCondition_.notify_all();
+		return;
+	}
+
+	queuedTasks_.fetch_add(1);
+	{
+		std::lock_guard<std::mutex> lock(queues_[threadIndex]->mutex);
+		queues_[threadIndex]->tasks.push_back(taskId);
+	}
+	{ std::lock_guard<std::mutex> lock(sleepMutex_); }
+	sleepCondition_.notify_one();
+}
+
+bool JobSystem::pop(std::uint32_t threadIndex, TaskGraph::TaskId& taskId) {
+	// main thread tasks first, they are on the critical path (submit / present)
+	if (threadIndex == 0 && queuedMainTasks_.load() != 0) {
+		std::lock_guard<std::mutex> lock(mainQueue_.mutex);
+		if (!mainQueue_.tasks.empty()) {
+			taskId = mainQueue_.tasks.front();
+			mainQueue_.tasks.pop_front();
+			queuedMainTasks_.fetch_sub(1);
+			return true;
+		}
+	}
+
+	{
+		auto& queue = *queues_[threadIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			taskId = queue.tasks.back();
+			queue.tasks.pop_back();
+			queuedTasks_.fetch_sub(1);
+			return true;
+		}
+	}
+
+	// steal oldest task of another thread
+	auto count = static_cast<std::uint32_t>(queues_.size());
+	for (std::uint32_t i = 1; i < count; ++i) {
+		auto& queue = *queues_[(threadIndex + i) % count];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			taskId = queue.tasks.front();
+			queue.tasks.pop_front();
+			queuedTasks_.fetch_sub(1);
+			stealCount_.fetch_add(1);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::execute(std::uint32_t threadIndex, TaskGraph::TaskId taskId) {
+	auto& task = graph_->tasks_[taskId];
+
+	auto beginTime = tracing_ ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+	task.function();
+	if (tracing_) traceEvents_[threadIndex].push_back({ task.name, graphIndex_, beginTime, std::chrono::steady_clock::now() });
+
+	for (auto dependent : task.dependents) {
+		if (pendingDependencies_[dependent].fetch_sub(1) == 1) push(threadIndex, dependent);
+	}
+
+	// last access to graph_ is above, run() may return right after this
+	if (remainingTasks_.fetch_sub(1) == 1) {
+		{ std::lock_guard<std::mutex> lock(sleepMutex_); }
+		sleepCondition_.notify_all();
+	}
+}
+
+void JobSystem::workerMain(std::uint32_t threadIndex) {
+	for (;;) {
+		TaskGraph::TaskId taskId{};
+		if (pop(threadIndex, taskId)) {
+			execute(threadIndex, taskId);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex_);
+		sleepCondition_.wait(lock, [&]() { return quit_ || queuedTasks_.load() != 0; });
+		if (quit_) return;
+	}
+}
+
+void JobSystem::run(TaskGraph& graph) {
+	auto taskCount = graph.tasks_.size();
+	if (taskCount == 0) return;
+
+	if (pendingCapacity_ < taskCount) {
+		pendingCapacity_ = std::max(taskCount, pendingCapacity_ * 2);
+		pendingDependencies_ = std::make_unique<std::atomic<std::uint32_t>[]>(pendingCapacity_);
+	}
+	for (std::size_t i = 0; i < taskCount; ++i) pendingDependencies_[i].store(graph.tasks_[i].dependencyCount);
+
+	graph_ = &graph;
+	remainingTasks_.store(static_cast<std::uint32_t>(taskCount));
+
+	// roots are spread over all threads, so work starts without stealing
+	std::uint32_t nextQueue = 0;
+	for (std::size_t i = 0; i < taskCount; ++i) {
+		if (graph.tasks_[i].dependencyCount != 0) continue;
+
+		push(nextQueue, static_cast<TaskGraph::TaskId>(i));
+		nextQueue = (nextQueue + 1) % threadCount();
+	}
+
+	while (remainingTasks_.load() != 0) {
+		TaskGraph::TaskId taskId{};
+		if (pop(0, taskId)) {
+			execute(0, taskId);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex_);
+		sleepCondition_.wait(lock, [&]() { return remainingTasks_.load() == 0 || queuedTasks_.load() != 0 || queuedMainTasks_.load() != 0; });
+	}
+
+	graph_ = nullptr;
+	++graphIndex_;
+}
+
+void JobSystem::beginTrace() {
+	for (auto& events : traceEvents_) events.clear();
+	stealCount_.store(0);
+	graphIndex_ = 0;
+	traceBeginTime_ = std::chrono::steady_clock::now();
+	tracing_ = true;
+}
+
+bool JobSystem::endTrace(const std::filesystem::path& path) {
+	tracing_ = false;
+
+	std::ofstream file(path);
+	if (!file) {
+		std::cerr << "[JobSystem] failed to open trace file " << path << std::endl;
+		return false;
+	}
+
+	struct Summary {
+		double totalMilliseconds;
+		std::uint32_t count;
+	};
+	std::map<std::string, Summary> summaries{};
+
+	auto microseconds = [&](std::chrono::steady_clock::time_point time) {
+		return std::chrono::duration<double, std::micro>(time - traceBeginTime_).count();
+	};
+
+	file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[" << std::endl;
+	bool first = true;
+	for (std::size_t thread = 0; thread < traceEvents_.size(); ++thread) {
+		for (const auto& event : traceEvents_[thread]) {
+			if (!first) file << "," << std::endl;
+			first = false;
+
+			auto beginTime = microseconds(event.beginTime);
+			auto duration = microseconds(event.endTime) - beginTime;
+			file << "{\"name\":\"" << event.name << "\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":" << beginTime << ",\"dur\":" << duration
+				<< ",\"pid\":0,\"tid\":" << thread << ",\"args\":{\"graph\":" << event.graphIndex << "}}";
+
+			auto& summary = summaries[event.name];
+			summary.totalMilliseconds += duration * 1e-3;
+			++summary.count;
+		}
+	}
+	file << std::endl << "]}" << std::endl;
+
+	auto flags = std::cout.flags();
+	auto precision = std::cout.precision();
+
+	std::cout << "[JobSystem] trace of " << graphIndex_ << " graphs on " << threadCount() << " threads (" << stealCount_.load() << " steals) written to " << path << std::endl;
+	for (const auto& [name, summary] : summaries) {
+		std::cout << "  " << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(9) << summary.totalMilliseconds / summary.count << " ms avg  x" << summary.count << std::endl;
+	}
+
+	std::cout.flags(flags);
+	std::cout.precision(precision);
+
+	return true;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// tasks of one frame and their dependencies, rebuilt (clear + add) every frame
+class TaskGraph {
+public:
+	using TaskId = std::uint32_t;
+
+private:
+	friend class JobSystem;
+
+	struct Task {
+		const char* name;
+		std::function<void()> function;
+		std::vector<TaskId> dependents;
+		std::uint32_t dependencyCount;
+		// only run by thread calling JobSystem::run (SDL, present)
+		bool mainThread;
+	};
+
+	std::vector<Task> tasks_;
+
+public:
+	TaskId add(const char* name, std::function<void()> function, bool mainThread = false);
+	// task starts after dependency finished
+	void depend(TaskId task, TaskId dependency);
+	void clear() { tasks_.clear(); }
+
+	std::size_t size() const { return tasks_.size(); }
+};
+
+// work stealing scheduler
+// - one deque per thread: owner pushes / pops at back (LIFO, data still in cache), idle threads steal from front
+// - a finished task releases dependents whose counter drops to 0 onto the finishing thread's deque
+// - calling thread (index 0) takes part and is the only one running main thread tasks
+class JobSystem {
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<TaskGraph::TaskId> tasks;
+	};
+
+	struct TraceEvent {
+		const char* name;
+		std::uint32_t graphIndex;
+		std::chrono::steady_clock::time_point beginTime;
+		std::chrono::steady_clock::time_point endTime;
+	};
+
+	std::vector<std::thread> threads_;
+	// [0] = calling thread
+	std::vector<std::unique_ptr<WorkQueue>> queues_;
+	WorkQueue mainQueue_;
+
+	// graph being run (nullptr between runs)
+	TaskGraph* graph_;
+	std::unique_ptr<std::atomic<std::uint32_t>[]> pendingDependencies_;
+	std::size_t pendingCapacity_;
+	std::atomic<std::uint32_t> remainingTasks_;
+
+	// tasks sitting in queues_ / mainQueue_ (sleeping threads wait for these)
+	std::atomic<std::uint32_t> queuedTasks_;
+	std::atomic<std::uint32_t> queuedMainTasks_;
+	std::atomic<std::uint64_t> stealCount_;
+
+	std::mutex sleepMutex_;
+	std::condition_variable sleepCondition_;
+	bool quit_;
+
+	// per thread, written only by owner while tracing
+	bool tracing_;
+	std::uint32_t graphIndex_;
+	std::chrono::steady_clock::time_point traceBeginTime_;
+	std::vector<std::vector<TraceEvent>> traceEvents_;
+
+	void push(std::uint32_t, TaskGraph::TaskId);
+	bool pop(std::uint32_t, TaskGraph::TaskId&);
+	void execute(std::uint32_t, TaskGraph::TaskId);
+	void workerMain(std::uint32_t);
+
+public:
+	// 0 -> one thread per hardware thread (calling thread included)
+	explicit JobSystem(std::uint32_t threadCount = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	std::uint32_t threadCount() const { return static_cast<std::uint32_t>(queues_.size()); }
+
+	// returns when every task of graph has finished
+	void run(TaskGraph& graph);
+
+	// records task timings of all graphs run until endTrace
+	void beginTrace();
+	// writes Chrome trace event JSON (chrome://tracing, Perfetto) and prints per task averages
+	bool endTrace(const std::filesystem::path& path);
+};
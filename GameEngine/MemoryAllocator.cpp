@@ -0,0 +1,443 @@
+#include "MemoryAllocator.h"
+
+void MemoryAllocator::initialize(VkDevice device, const VkPhysicalDeviceProperties& properties, const VkPhysicalDeviceMemoryProperties& memoryProperties) {
+	device_ = device;
+	memoryProperties_ = memoryProperties;
+	bufferImageGranularity_ = std::max<VkDeviceSize>(1, properties.limits.bufferImageGranularity);
+	deviceMemoryCount_ = 0;
+
+	pools_.clear();
+	pools_.resize(memoryProperties_.memoryTypeCount * 2);
+
+	for (std::uint32_t i = 0; i < memoryProperties_.memoryTypeCount; ++i) {
+		// small heaps (e.g. 256 MiB BAR) get proportionally smaller blocks
+		auto heapSize = memoryProperties_.memoryHeaps[memoryProperties_.memoryTypes[i].heapIndex].size;
+		auto blockSize = std::min(preferredBlockSize, std::bit_floor(std::max<VkDeviceSize>(heapSize / 8, 1)));
+
+		for (auto kind : { ResourceKind::Linear, ResourceKind::Optimal }) {
+			auto& target = pools_[i * 2 + static_cast<std::uint32_t>(kind)];
+			target.memoryTypeIndex = i;
+			target.kind = kind;
+			target.blockSize = blockSize;
+			target.dedicatedAllocationCount = 0;
+			target.dedicatedSize = 0;
+		}
+	}
+}
+
+void MemoryAllocator::deinitialize() {
+	for (auto& target : pools_) {
+		for (auto& block : target.blocks) destroyBlock(*block);
+		target.blocks.clear();
+	}
+	pools_.clear();
+}
+
+MemoryAllocator::Pool& MemoryAllocator::pool(std::uint32_t memoryTypeIndex, ResourceKind kind) {
+	// granularity of 1 -> linear and optimal resources can be neighbours, share one pool
+	if (bufferImageGranularity_ == 1) kind = ResourceKind::Linear;
+	return pools_[memoryTypeIndex * 2 + static_cast<std::uint32_t>(kind)];
+}
+
+bool MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, std::uint32_t memoryTypeIndex, VkDeviceMemory& memory, std::uint8_t*& pointer) {
+	VkMemoryAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocateInfo.allocationSize = size;
+	allocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+	if (vkAllocateMemory(device_, &allocateInfo, nullptr, &memory) != VK_SUCCESS) return false;
+	++deviceMemoryCount_;
+
+	pointer = nullptr;
+	if (memoryProperties_.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(device_, memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&pointer)) != VK_SUCCESS) {
+			freeDeviceMemory(memory);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void MemoryAllocator::freeDeviceMemory(VkDeviceMemory memory) {
+	// freeing implicitly unmaps
+	vkFreeMemory(device_, memory, nullptr);
+	--deviceMemoryCount_;
+}
+
+bool MemoryAllocator::createBlock(Pool& target) {
+	auto block = std::make_unique<Block>();
+	block->size = target.blockSize;
+	block->usedSize = 0;
+	block->allocationCount = 0;
+
+	if (!allocateDeviceMemory(block->size, target.memoryTypeIndex, block->memory, block->pointer)) return false;
+
+	block->firstLevelBitmap = 0;
+	block->secondLevelBitmaps.fill(0);
+	for (auto& freeList : block->freeLists) freeList.fill(invalidIndex);
+
+	// whole block is one free range
+	auto index = createNode(*block);
+	block->nodes[index] = Node{ 0, block->size, invalidIndex, invalidIndex, invalidIndex, invalidIndex, true };
+	insertFreeNode(*block, index);
+
+	target.blocks.push_back(std::move(block));
+
+	return true;
+}
+
+void MemoryAllocator::destroyBlock(Block& block) {
+	freeDeviceMemory(block.memory);
+	block.memory = VK_NULL_HANDLE;
+}
+
+void MemoryAllocator::mapping(VkDeviceSize size, std::uint32_t& firstLevel, std::uint32_t& secondLevel) {
+	// [0, 16) -> first level 0 (linear), [2^n, 2^(n + 1)) -> first level n - 3, split into 16 second levels
+	if (size < secondLevelCount) {
+		firstLevel = 0;
+		secondLevel = static_cast<std::uint32_t>(size);
+		return;
+	}
+
+	auto log2 = static_cast<std::uint32_t>(std::bit_width(size)) - 1;
+	firstLevel = log2 - secondLevelBits + 1;
+	secondLevel = static_cast<std::uint32_t>(size >> (log2 - secondLevelBits)) & (secondLevelCount - 1);
+}
+
+std::uint32_t MemoryAllocator::findFreeNode(const Block& block, VkDeviceSize size) {
+	// round up to next class so that every range in found list is large enough
+	if (size >= secondLevelCount) {
+		auto log2 = static_cast<std::uint32_t>(std::bit_width(size)) - 1;
+		size += (VkDeviceSize(1) << (log2 - secondLevelBits)) - 1;
+	}
+
+	std::uint32_t firstLevel{}, secondLevel{};
+	mapping(size, firstLevel, secondLevel);
+	if (firstLevel >= firstLevelCount) return invalidIndex;
+
+	auto secondLevelMap = block.secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+	if (secondLevelMap == 0) {
+		auto firstLevelMap = firstLevel + 1 < firstLevelCount ? block.firstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+		if (firstLevelMap == 0) return invalidIndex;
+
+		firstLevel = static_cast<std::uint32_t>(std::countr_zero(firstLevelMap));
+		secondLevelMap = block.secondLevelBitmaps[firstLevel];
+	}
+	secondLevel = static_cast<std::uint32_t>(std::countr_zero(secondLevelMap));
+
+	return block.freeLists[firstLevel][secondLevel];
+}
+
+std::uint32_t MemoryAllocator::createNode(Block& block) {
+	if (!block.unusedNodes.empty()) {
+		auto index = block.unusedNodes.back();
+		block.unusedNodes.pop_back();
+		return index;
+	}
+
+	block.nodes.push_back(Node{});
+	return static_cast<std::uint32_t>(block.nodes.size() - 1);
+}
+
+void MemoryAllocator::insertFreeNode(Block& block, std::uint32_t index) {
+	std::uint32_t firstLevel{}, secondLevel{};
+	mapping(block.nodes[index].size, firstLevel, secondLevel);
+
+	auto& head = block.freeLists[firstLevel][secondLevel];
+
+	block.nodes[index].free = true;
+	block.nodes[index].prevFree = invalidIndex;
+	block.nodes[index].nextFree = head;
+	if (head != invalidIndex) block.nodes[head].prevFree = index;
+	head = index;
+
+	block.firstLevelBitmap |= 1ull << firstLevel;
+	block.secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+}
+
+void MemoryAllocator::removeFreeNode(Block& block, std::uint32_t index) {
+	std::uint32_t firstLevel{}, secondLevel{};
+	mapping(block.nodes[index].size, firstLevel, secondLevel);
+
+	auto& node = block.nodes[index];
+	if (node.prevFree != invalidIndex) block.nodes[node.prevFree].nextFree = node.nextFree;
+	if (node.nextFree != invalidIndex) block.nodes[node.nextFree].prevFree = node.prevFree;
+
+	auto& head = block.freeLists[firstLevel][secondLevel];
+	if (head == index) {
+		head = node.nextFree;
+		if (head == invalidIndex) {
+			block.secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+			if (block.secondLevelBitmaps[firstLevel] == 0) block.firstLevelBitmap &= ~(1ull << firstLevel);
+		}
+	}
+
+	node.free = false;
+	node.prevFree = invalidIndex;
+	node.nextFree = invalidIndex;
+}
+
+bool MemoryAllocator::allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation) {
+	// search with worst case padding, then cut padding and tail off as free ranges
+	auto index = findFreeNode(block, size + alignment - 1);
+	if (index == invalidIndex) return false;
+
+	removeFreeNode(block, index);
+
+	auto alignedOffset = (block.nodes[index].offset + alignment - 1) / alignment * alignment;
+	auto padding = alignedOffset - block.nodes[index].offset;
+
+	if (padding > 0) {
+		auto paddingIndex = createNode(block);
+		auto& node = block.nodes[index];
+		block.nodes[paddingIndex] = Node{ node.offset, padding, node.prevPhysical, index, invalidIndex, invalidIndex, true };
+		if (node.prevPhysical != invalidIndex) block.nodes[node.prevPhysical].nextPhysical = paddingIndex;
+		node.prevPhysical = paddingIndex;
+		node.offset += padding;
+		node.size -= padding;
+		insertFreeNode(block, paddingIndex);
+	}
+
+	if (block.nodes[index].size > size) {
+		auto tailIndex = createNode(block);
+		auto& node = block.nodes[index];
+		block.nodes[tailIndex] = Node{ node.offset + size, node.size - size, index, node.nextPhysical, invalidIndex, invalidIndex, true };
+		if (node.nextPhysical != invalidIndex) block.nodes[node.nextPhysical].prevPhysical = tailIndex;
+		node.nextPhysical = tailIndex;
+		node.size = size;
+		insertFreeNode(block, tailIndex);
+	}
+
+	block.usedSize += size;
+	++block.allocationCount;
+
+	allocation.memory = block.memory;
+	allocation.offset = block.nodes[index].offset;
+	allocation.size = size;
+	allocation.pointer = block.pointer ? block.pointer + allocation.offset : nullptr;
+	allocation.block = &block;
+	allocation.node = index;
+
+	return true;
+}
+
+void MemoryAllocator::freeToBlock(Block& block, std::uint32_t index) {
+	block.usedSize -= block.nodes[index].size;
+	--block.allocationCount;
+
+	// merge with free physical neighbours
+	auto prevIndex = block.nodes[index].prevPhysical;
+	if (prevIndex != invalidIndex && block.nodes[prevIndex].free) {
+		removeFreeNode(block, prevIndex);
+
+		auto& prev = block.nodes[prevIndex];
+		prev.size += block.nodes[index].size;
+		prev.nextPhysical = block.nodes[index].nextPhysical;
+		if (prev.nextPhysical != invalidIndex) block.nodes[prev.nextPhysical].prevPhysical = prevIndex;
+
+		block.unusedNodes.push_back(index);
+		index = prevIndex;
+	}
+
+	auto nextIndex = block.nodes[index].nextPhysical;
+	if (nextIndex != invalidIndex && block.nodes[nextIndex].free) {
+		removeFreeNode(block, nextIndex);
+
+		auto& node = block.nodes[index];
+		node.size += block.nodes[nextIndex].size;
+		node.nextPhysical = block.nodes[nextIndex].nextPhysical;
+		if (node.nextPhysical != invalidIndex) block.nodes[node.nextPhysical].prevPhysical = index;
+
+		block.unusedNodes.push_back(nextIndex);
+	}
+
+	insertFreeNode(block, index);
+}
+
+std::vector<std::uint32_t> MemoryAllocator::memoryTypeCandidates(std::uint32_t memoryTypeBits, MemoryUsage usage) const {
+	VkMemoryPropertyFlags required{}, preferred{}, avoided{};
+	switch (usage) {
+	case MemoryUsage::Static:
+		preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		avoided = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		break;
+	case MemoryUsage::Upload:
+		// system memory, write combined is fine (CPU only writes sequentially)
+		required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		avoided = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		break;
+	case MemoryUsage::Dynamic:
+		// device local + host visible (BAR / UMA) when available
+		required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		avoided = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		break;
+	case MemoryUsage::Readback:
+		required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		avoided = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		break;
+	}
+	avoided |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+	std::vector<std::pair<int, std::uint32_t>> scores{};
+	for (std::uint32_t i = 0; i < memoryProperties_.memoryTypeCount; ++i) {
+		if (!(memoryTypeBits & (1u << i))) continue;
+
+		auto flags = memoryProperties_.memoryTypes[i].propertyFlags;
+		if ((flags & required) != required) continue;
+
+		// preferred properties outweigh avoided ones, ties keep driver order
+		auto score = 2 * std::popcount(flags & preferred) - std::popcount(flags & avoided);
+		scores.emplace_back(score, i);
+	}
+	std::stable_sort(scores.begin(), scores.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+	std::vector<std::uint32_t> candidates{};
+	for (const auto& score : scores) candidates.push_back(score.second);
+
+	return candidates;
+}
+
+bool MemoryAllocator::allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, ResourceKind kind, Allocation& allocation) {
+	auto candidates = memoryTypeCandidates(requirements.memoryTypeBits, usage);
+
+	for (auto memoryTypeIndex : candidates) {
+		if (allocate(requirements, memoryTypeIndex, kind, allocation)) return true;
+	}
+
+	std::cerr << "[MemoryAllocator] failed to allocate " << requirements.size << " bytes (" << candidates.size() << " candidate memory types)" << std::endl;
+	return false;
+}
+
+bool MemoryAllocator::allocate(const VkMemoryRequirements& requirements, std::uint32_t memoryTypeIndex, ResourceKind kind, Allocation& allocation) {
+	std::lock_guard lock(mutex_);
+
+	auto& target = pool(memoryTypeIndex, kind);
+
+	allocation = Allocation{};
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	allocation.kind = kind;
+
+	// granularity > 1 keeps linear and optimal resources in separate pools,
+	// aligning size / offset to it as well keeps any two resources off a shared page
+	auto alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+	auto size = requirements.size;
+	if (bufferImageGranularity_ > 1) {
+		alignment = std::max(alignment, bufferImageGranularity_);
+		size = (size + bufferImageGranularity_ - 1) / bufferImageGranularity_ * bufferImageGranularity_;
+	}
+
+	// large resources (render targets, big textures) -> dedicated allocation
+	if (size <= target.blockSize / 2) {
+		for (auto& block : target.blocks) {
+			if (block->size - block->usedSize < size) continue;
+			if (allocateFromBlock(*block, size, alignment, allocation)) return true;
+		}
+
+		if (createBlock(target) && allocateFromBlock(*target.blocks.back(), size, alignment, allocation)) return true;
+		allocation.memoryTypeIndex = memoryTypeIndex;
+		allocation.kind = kind;
+	}
+
+	// fallback: own VkDeviceMemory
+	if (!allocateDeviceMemory(requirements.size, memoryTypeIndex, allocation.memory, allocation.pointer)) return false;
+	allocation.offset = 0;
+	allocation.size = requirements.size;
+	allocation.block = nullptr;
+	allocation.node = invalidIndex;
+
+	++target.dedicatedAllocationCount;
+	target.dedicatedSize += requirements.size;
+
+	return true;
+}
+
+void MemoryAllocator::free(const Allocation& allocation) {
+	if (allocation.memory == VK_NULL_HANDLE) return;
+
+	std::lock_guard lock(mutex_);
+
+	auto& target = pool(allocation.memoryTypeIndex, allocation.kind);
+
+	if (allocation.block == nullptr) {
+		--target.dedicatedAllocationCount;
+		target.dedicatedSize -= allocation.size;
+
+		freeDeviceMemory(allocation.memory);
+	}
+	else {
+		auto block = allocation.block;
+		freeToBlock(*block, allocation.node);
+
+		// release empty blocks, but keep last one of each pool to avoid allocation churn
+		if (block->allocationCount == 0 && target.blocks.size() > 1) {
+			destroyBlock(*block);
+			std::erase_if(target.blocks, [block](const auto& candidate) { return candidate.get() == block; });
+		}
+	}
+}
+
+MemoryAllocator::Statistics MemoryAllocator::statistics() {
+	std::lock_guard lock(mutex_);
+
+	Statistics statistics{};
+	statistics.deviceMemoryCount = deviceMemoryCount_;
+	for (const auto& target : pools_) {
+		statistics.blockCount += static_cast<std::uint32_t>(target.blocks.size());
+		statistics.dedicatedAllocationCount += target.dedicatedAllocationCount;
+		statistics.allocationCount += target.dedicatedAllocationCount;
+		statistics.reservedSize += target.dedicatedSize;
+		statistics.usedSize += target.dedicatedSize;
+		for (const auto& block : target.blocks) {
+			statistics.allocationCount += block->allocationCount;
+			statistics.reservedSize += block->size;
+			statistics.usedSize += block->usedSize;
+		}
+	}
+
+	return statistics;
+}
+
+void MemoryAllocator::printStatistics() {
+	constexpr double mebibyte = 1024.0 * 1024.0;
+
+	{
+		std::lock_guard lock(mutex_);
+
+		auto flags = std::cout.flags();
+		auto precision = std::cout.precision();
+
+		for (const auto& target : pools_) {
+			if (target.blocks.empty() && target.dedicatedAllocationCount == 0) continue;
+
+			VkDeviceSize reservedSize = target.dedicatedSize, usedSize = target.dedicatedSize, largestFreeRange = 0;
+			std::uint32_t allocationCount = target.dedicatedAllocationCount;
+			for (const auto& block : target.blocks) {
+				reservedSize += block->size;
+				usedSize += block->usedSize;
+				allocationCount += block->allocationCount;
+				for (const auto& node : block->nodes) {
+					if (node.free) largestFreeRange = std::max(largestFreeRange, node.size);
+				}
+			}
+
+			auto flags = memoryProperties_.memoryTypes[target.memoryTypeIndex].propertyFlags;
+			std::cout << "[MemoryAllocator] type " << target.memoryTypeIndex
+				<< ((flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ? " DEVICE_LOCAL" : "")
+				<< ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? " HOST_VISIBLE" : "")
+				<< ((flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) ? " HOST_CACHED" : "")
+				<< (target.kind == ResourceKind::Linear ? " (linear)" : " (optimal)")
+				<< ": " << target.blocks.size() << " blocks, " << target.dedicatedAllocationCount << " dedicated, "
+				<< allocationCount << " allocations, " << std::fixed << std::setprecision(2)
+				<< usedSize / mebibyte << " / " << reservedSize / mebibyte << " MiB used, largest free range " << largestFreeRange / mebibyte << " MiB" << std::endl;
+		}
+
+		std::cout.flags(flags);
+		std::cout.precision(precision);
+	}
+
+	auto total = statistics();
+	std::cout << "[MemoryAllocator] " << total.allocationCount << " resources in " << total.deviceMemoryCount << " device memory allocations" << std::endl;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// sub-allocates buffers and images from large VkDeviceMemory blocks
+// - one pool of blocks per memory type (and per resource kind when bufferImageGranularity > 1)
+// - placement inside block is TLSF (two level segregated fit): O(1) allocate / free with immediate coalescing
+// - resources larger than half a block get their own (dedicated) VkDeviceMemory
+// - host visible memory is mapped once per block and stays mapped
+class MemoryAllocator {
+public:
+	// linear (buffer) and optimal tiled (image) resources must not share a bufferImageGranularity page
+	enum class ResourceKind {
+		Linear,
+		Optimal,
+	};
+
+	// what CPU / GPU do with resource -> memory type preference
+	enum class MemoryUsage {
+		// GPU read only, filled once through staging (vertex / index / texture / constant data)
+		Static,
+		// CPU writes once, GPU copies from it (staging)
+		Upload,
+		// CPU rewrites every frame, GPU reads (transform / bone data)
+		Dynamic,
+		// GPU writes, CPU reads
+		Readback,
+	};
+
+	struct Block;
+
+	struct Allocation {
+		VkDeviceMemory memory;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		// mapped address of offset (nullptr if memory is not host visible)
+		std::uint8_t* pointer;
+		// owner block (nullptr -> dedicated allocation)
+		Block* block;
+		std::uint32_t node;
+		std::uint32_t memoryTypeIndex;
+		ResourceKind kind;
+	};
+
+	static constexpr std::uint32_t invalidIndex = UINT32_MAX;
+
+	static constexpr std::uint32_t secondLevelBits = 4;
+	static constexpr std::uint32_t secondLevelCount = 1u << secondLevelBits;
+	static constexpr std::uint32_t firstLevelCount = 64;
+
+	// physical range in block (free or used)
+	struct Node {
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		std::uint32_t prevPhysical;
+		std::uint32_t nextPhysical;
+		std::uint32_t prevFree;
+		std::uint32_t nextFree;
+		bool free;
+	};
+
+	struct Block {
+		VkDeviceMemory memory;
+		VkDeviceSize size;
+		std::uint8_t* pointer;
+		VkDeviceSize usedSize;
+		std::uint32_t allocationCount;
+
+		std::vector<Node> nodes;
+		std::vector<std::uint32_t> unusedNodes;
+
+		std::uint64_t firstLevelBitmap;
+		std::array<std::uint32_t, firstLevelCount> secondLevelBitmaps;
+		std::array<std::array<std::uint32_t, secondLevelCount>, firstLevelCount> freeLists;
+	};
+
+	struct Statistics {
+		std::uint32_t deviceMemoryCount;
+		std::uint32_t blockCount;
+		std::uint32_t allocationCount;
+		std::uint32_t dedicatedAllocationCount;
+		VkDeviceSize reservedSize;
+		VkDeviceSize usedSize;
+	};
+
+private:
+	struct Pool {
+		std::uint32_t memoryTypeIndex;
+		ResourceKind kind;
+		VkDeviceSize blockSize;
+		std::vector<std::unique_ptr<Block>> blocks;
+		std::uint32_t dedicatedAllocationCount;
+		VkDeviceSize dedicatedSize;
+	};
+
+	static constexpr VkDeviceSize preferredBlockSize = 64ull * 1024 * 1024;
+
+	VkDevice device_;
+	VkPhysicalDeviceMemoryProperties memoryProperties_;
+	VkDeviceSize bufferImageGranularity_;
+
+	std::vector<Pool> pools_;
+	std::uint32_t deviceMemoryCount_;
+
+	std::mutex mutex_;
+
+	Pool& pool(std::uint32_t, ResourceKind);
+
+	bool allocateDeviceMemory(VkDeviceSize, std::uint32_t, VkDeviceMemory&, std::uint8_t*&);
+	void freeDeviceMemory(VkDeviceMemory);
+
+	bool createBlock(Pool&);
+	void destroyBlock(Block&);
+
+	static void mapping(VkDeviceSize, std::uint32_t&, std::uint32_t&);
+	static std::uint32_t findFreeNode(const Block&, VkDeviceSize);
+	static std::uint32_t createNode(Block&);
+	static void insertFreeNode(Block&, std::uint32_t);
+	static void removeFreeNode(Block&, std::uint32_t);
+
+	static bool allocateFromBlock(Block&, VkDeviceSize, VkDeviceSize, Allocation&);
+	static void freeToBlock(Block&, std::uint32_t);
+
+	bool allocate(const VkMemoryRequirements&, std::uint32_t, ResourceKind, Allocation&);
+
+public:
+	void initialize(VkDevice device, const VkPhysicalDeviceProperties& properties, const VkPhysicalDeviceMemoryProperties& memoryProperties);
+	void deinitialize();
+
+	// memory types allowed by memoryTypeBits that satisfy usage, best first
+	std::vector<std::uint32_t> memoryTypeCandidates(std::uint32_t memoryTypeBits, MemoryUsage usage) const;
+
+	// tries candidates in order (e.g. device local heap exhausted -> next best type)
+	bool allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, ResourceKind kind, Allocation& allocation);
+	void free(const Allocation& allocation);
+
+	Statistics statistics();
+	void printStatistics();
+};
@@ -0,0 +1,203 @@
+#include "PipelineCache.h"
+
+bool PipelineCache::initialize(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::filesystem::path& path, bool load) {
+	device_ = device;
+	properties_ = properties;
+	path_ = path;
+	warm_ = false;
+	loadedSize_ = 0;
+	pipelineCount_ = 0;
+	creationNanoseconds_ = 0;
+
+	std::vector<std::uint8_t> data{};
+	if (load && !this->load(data)) data.clear();
+
+	VkPipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = data.size();
+	cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &cache_) != VK_SUCCESS) {
+		cache_ = VK_NULL_HANDLE;
+		if (data.empty()) {
+			std::cerr << "[PipelineCache] failed to create pipeline cache" << std::endl;
+			return false;
+		}
+
+		// header matched, but driver still refused content
+		std::cerr << "[PipelineCache] (" << path_ << ") rejected by driver, starting cold" << std::endl;
+		data.clear();
+		cacheInfo.initialDataSize = 0;
+		cacheInfo.pInitialData = nullptr;
+		if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &cache_) != VK_SUCCESS) {
+			cache_ = VK_NULL_HANDLE;
+			std::cerr << "[PipelineCache] failed to create pipeline cache" << std::endl;
+			return false;
+		}
+	}
+
+	warm_ = !data.empty();
+	loadedSize_ = data.size();
+
+	return true;
+}
+
+void PipelineCache::deinitialize() {
+	if (cache_ != VK_NULL_HANDLE) vkDestroyPipelineCache(device_, cache_, nullptr);
+	cache_ = VK_NULL_HANDLE;
+}
+
+bool PipelineCache::load(std::vector<std::uint8_t>& data) const {
+	std::error_code error{};
+	auto fileSize = std::filesystem::file_size(path_, error);
+	// first run
+	if (error) return false;
+
+	std::ifstream ifs(path_, std::ios::in | std::ios::binary);
+	if (!ifs) {
+		std::cerr << "[PipelineCache] (" << path_ << ") failed to open file" << std::endl;
+		return false;
+	}
+
+	FileHeader header{};
+	ifs.read((char*)&header, sizeof(FileHeader));
+	if (!ifs || header.magic != fileMagic || header.version != fileVersion || header.dataSize != fileSize - sizeof(FileHeader)) {
+		std::cerr << "[PipelineCache] (" << path_ << ") unknown or truncated file, starting cold" << std::endl;
+		return false;
+	}
+
+	if (header.vendorID != properties_.vendorID || header.deviceID != properties_.deviceID || header.driverVersion != properties_.driverVersion ||
+		std::memcmp(header.pipelineCacheUUID, properties_.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+		std::cout << "[PipelineCache] (" << path_ << ") written by other device or driver, starting cold" << std::endl;
+		return false;
+	}
+
+	data.resize(static_cast<std::size_t>(header.dataSize));
+	ifs.read((char*)data.data(), data.size());
+	if (!ifs || hashContent(data.data(), data.size()) != header.dataHash) {
+		std::cerr << "[PipelineCache] (" << path_ << ") damaged file, starting cold" << std::endl;
+		return false;
+	}
+
+	// blob carries its own header, driver would reject (or misread) one that disagrees
+	VkPipelineCacheHeaderVersionOne blobHeader{};
+	if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne)) {
+		std::cerr << "[PipelineCache] (" << path_ << ") blob is smaller than its header, starting cold" << std::endl;
+		return false;
+	}
+	std::memcpy(&blobHeader, data.data(), sizeof(VkPipelineCacheHeaderVersionOne));
+
+	if (blobHeader.headerSize < sizeof(VkPipelineCacheHeaderVersionOne) || blobHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+		blobHeader.vendorID != properties_.vendorID || blobHeader.deviceID != properties_.deviceID ||
+		std::memcmp(blobHeader.pipelineCacheUUID, properties_.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+		std::cerr << "[PipelineCache] (" << path_ << ") blob header does not match device, starting cold" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool PipelineCache::save() const {
+	if (cache_ == VK_NULL_HANDLE) return false;
+
+	std::size_t dataSize = 0;
+	if (vkGetPipelineCacheData(device_, cache_, &dataSize, nullptr) != VK_SUCCESS) {
+		std::cerr << "[PipelineCache] failed to query pipeline cache size" << std::endl;
+		return false;
+	}
+
+	// VK_INCOMPLETE if cache grew in between: not all of it is written, but what is written is valid
+	std::vector<std::uint8_t> data(dataSize);
+	auto result = vkGetPipelineCacheData(device_, cache_, &dataSize, data.data());
+	if (result != VK_SUCCESS && result != VK_INCOMPLETE) {
+		std::cerr << "[PipelineCache] failed to get pipeline cache data" << std::endl;
+		return false;
+	}
+	data.resize(dataSize);
+
+	FileHeader header{};
+	header.magic = fileMagic;
+	header.version = fileVersion;
+	header.vendorID = properties_.vendorID;
+	header.deviceID = properties_.deviceID;
+	header.driverVersion = properties_.driverVersion;
+	std::memcpy(header.pipelineCacheUUID, properties_.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = data.size();
+	header.dataHash = hashContent(data.data(), data.size());
+
+	std::error_code error{};
+	if (path_.has_parent_path()) std::filesystem::create_directories(path_.parent_path(), error);
+
+	auto temporaryPath = path_;
+	temporaryPath += ".tmp";
+
+	{
+		std::ofstream ofs(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!ofs) {
+			std::cerr << "[PipelineCache] (" << temporaryPath << ") failed to open file" << std::endl;
+			return false;
+		}
+
+		ofs.write((const char*)&header, sizeof(FileHeader));
+		ofs.write((const char*)data.data(), data.size());
+
+		if (!ofs) {
+			std::cerr << "[PipelineCache] (" << temporaryPath << ") failed to write file" << std::endl;
+			return false;
+		}
+	}
+
+	// crash while saving leaves previous file intact
+	std::filesystem::rename(temporaryPath, path_, error);
+	if (error) {
+		std::cerr << "[PipelineCache] (" << path_ << ") failed to rename file: " << error.message() << std::endl;
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+
+	return true;
+}
+
+void PipelineCache::addCreationTime(std::chrono::steady_clock::time_point beginTime) {
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - beginTime);
+	creationNanoseconds_ += elapsed.count();
+	++pipelineCount_;
+}
+
+VkResult PipelineCache::createGraphicsPipeline(const VkGraphicsPipelineCreateInfo& info, VkPipeline& pipeline) {
+	auto beginTime = std::chrono::steady_clock::now();
+	auto result = vkCreateGraphicsPipelines(device_, cache_, 1, &info, nullptr, &pipeline);
+	addCreationTime(beginTime);
+
+	return result;
+}
+
+VkResult PipelineCache::createComputePipeline(const VkComputePipelineCreateInfo& info, VkPipeline& pipeline) {
+	auto beginTime = std::chrono::steady_clock::now();
+	auto result = vkCreateComputePipelines(device_, cache_, 1, &info, nullptr, &pipeline);
+	addCreationTime(beginTime);
+
+	return result;
+}
+
+PipelineCache::Statistics PipelineCache::statistics() const {
+	Statistics statistics{};
+	statistics.warm = warm_;
+	statistics.loadedSize = loadedSize_;
+	statistics.pipelineCount = pipelineCount_.load();
+	statistics.creationMilliseconds = creationNanoseconds_.load() / 1000000.0;
+
+	return statistics;
+}
+
+void PipelineCache::printStatistics() const {
+	auto flags = std::cout.flags();
+	auto precision = std::cout.precision();
+
+	auto current = statistics();
+	std::cout << "pipeline cache: " << (current.warm ? "warm" : "cold") << " (" << std::fixed << std::setprecision(1) << current.loadedSize / 1024.0 << " KiB loaded), "
+		<< current.pipelineCount << " pipelines created in " << std::setprecision(2) << current.creationMilliseconds << " ms" << std::endl;
+
+	std::cout.flags(flags);
+	std::cout.precision(precision);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "Hash.h"
+
+// VkPipelineCache shared by all pipeline creation, persisted between runs
+// file: FileHeader (device identity, payload size and hash) followed by vkGetPipelineCacheData blob
+// - blob of other device / driver version or damaged file is dropped before driver sees it (cold start)
+// - saved to temporary file, then renamed
+// - pipeline creation through it is timed, so cold and warm runs can be compared
+class PipelineCache {
+public:
+	struct Statistics {
+		// initial data came from file
+		bool warm;
+		std::size_t loadedSize;
+		std::uint32_t pipelineCount;
+		double creationMilliseconds;
+	};
+
+private:
+	struct FileHeader {
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::uint32_t vendorID;
+		std::uint32_t deviceID;
+		// not part of Vulkan cache header, but drivers may reject (or misuse) blobs of other versions
+		std::uint32_t driverVersion;
+		std::uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		std::uint64_t dataSize;
+		// 64-bit FNV-1a of blob
+		std::uint64_t dataHash;
+	};
+
+	// "PLCH"
+	static constexpr std::uint32_t fileMagic = 0x48434c50;
+	static constexpr std::uint32_t fileVersion = 1;
+
+	VkDevice device_ = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties properties_{};
+	std::filesystem::path path_;
+	VkPipelineCache cache_ = VK_NULL_HANDLE;
+
+	bool warm_ = false;
+	std::size_t loadedSize_ = 0;
+	// pipelines may be created from several threads
+	std::atomic<std::uint32_t> pipelineCount_ = 0;
+	std::atomic<std::int64_t> creationNanoseconds_ = 0;
+
+	bool load(std::vector<std::uint8_t>&) const;
+	void addCreationTime(std::chrono::steady_clock::time_point);
+
+public:
+	// load = false -> file is ignored (cold start), still written by save
+	// false -> no cache object, pipelines are created without one
+	bool initialize(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::filesystem::path& path, bool load = true);
+	void deinitialize();
+
+	// whole cache content (also pipelines created this run) replaces file
+	bool save() const;
+
+	VkPipelineCache handle() const { return cache_; }
+
+	// one pipeline through cache, creation time is accumulated
+	VkResult createGraphicsPipeline(const VkGraphicsPipelineCreateInfo& info, VkPipeline& pipeline);
+	VkResult createComputePipeline(const VkComputePipelineCreateInfo& info, VkPipeline& pipeline);
+
+	Statistics statistics() const;
+	void printStatistics() const;
+};
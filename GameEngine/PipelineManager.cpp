@@ -0,0 +1,218 @@
+#include "PipelineManager.h"
+
+std::uint64_t PipelineManager::hash(const GraphicsPipelineDesc& desc) {
+	// field by field, so padding never enters key
+	auto value = hashContent((const std::uint8_t*)&desc.vertexShader, sizeof(desc.vertexShader));
+	value = hashContent((const std::uint8_t*)&desc.fragmentShader, sizeof(desc.fragmentShader), value);
+	value = hashContent((const std::uint8_t*)&desc.layout, sizeof(desc.layout), value);
+	value = hashContent((const std::uint8_t*)&desc.colorFormat, sizeof(desc.colorFormat), value);
+	value = hashContent((const std::uint8_t*)&desc.depthFormat, sizeof(desc.depthFormat), value);
+	value = hashContent((const std::uint8_t*)&desc.samples, sizeof(desc.samples), value);
+	value = hashContent((const std::uint8_t*)&desc.cullMode, sizeof(desc.cullMode), value);
+	value = hashContent((const std::uint8_t*)&desc.depthCompareOp, sizeof(desc.depthCompareOp), value);
+	value = hashContent((const std::uint8_t*)&desc.depthWrite, sizeof(desc.depthWrite), value);
+	value = hashContent((const std::uint8_t*)&desc.blend, sizeof(desc.blend), value);
+	value = hashContent((const std::uint8_t*)&desc.specializationCount, sizeof(desc.specializationCount), value);
+	value = hashContent((const std::uint8_t*)desc.specialization.data(), sizeof(std::uint32_t) * desc.specialization.size(), value);
+
+	return value;
+}
+
+void PipelineManager::initialize(VkDevice device, CreateFunction create, std::uint32_t threadCount) {
+	device_ = device;
+	create_ = std::move(create);
+	quit_ = false;
+
+	for (std::uint32_t i = 0; i < std::max(threadCount, 1u); ++i) {
+		threads_.emplace_back(&PipelineManager::workerMain, this);
+	}
+}
+
+void PipelineManager::stopThreads() {
+	{
+		std::lock_guard lock(mutex_);
+		quit_ = true;
+		// variants nobody compiled yet keep using their fallback
+		queue_.clear();
+	}
+	queueCondition_.notify_all();
+
+	for (auto& thread : threads_) thread.join();
+	threads_.clear();
+}
+
+void PipelineManager::deinitialize() {
+	stopThreads();
+
+	std::lock_guard lock(mutex_);
+	for (auto& entry : entries_) {
+		auto pipeline = entry->pipeline.load();
+		if (pipeline != VK_NULL_HANDLE) vkDestroyPipeline(device_, pipeline, nullptr);
+	}
+	for (auto& [key, renderPass] : renderPasses_) vkDestroyRenderPass(device_, renderPass, nullptr);
+
+	entries_.clear();
+	lookup_.clear();
+	renderPasses_.clear();
+}
+
+VkRenderPass PipelineManager::renderPass(const GraphicsPipelineDesc& desc) {
+	auto key = hashContent((const std::uint8_t*)&desc.colorFormat, sizeof(desc.colorFormat));
+	key = hashContent((const std::uint8_t*)&desc.depthFormat, sizeof(desc.depthFormat), key);
+	key = hashContent((const std::uint8_t*)&desc.samples, sizeof(desc.samples), key);
+
+	auto found = renderPasses_.find(key);
+	if (found != renderPasses_.end()) return found->second;
+
+	// only formats and samples matter for compatibility, load / store ops and layouts are arbitrary
+	VkAttachmentDescription colorAttachmentDesc{};
+	colorAttachmentDesc.format = desc.colorFormat;
+	colorAttachmentDesc.samples = desc.samples;
+	colorAttachmentDesc.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colorAttachmentDesc.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	colorAttachmentDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colorAttachmentDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	colorAttachmentDesc.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachmentDesc.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentDescription depthAttachmentDesc = colorAttachmentDesc;
+	depthAttachmentDesc.format = desc.depthFormat;
+	depthAttachmentDesc.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachmentDesc.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	std::array<VkAttachmentDescription, 2> attachmentDesc{ colorAttachmentDesc, depthAttachmentDesc };
+
+	VkAttachmentReference colorAttachmentRef{ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	VkAttachmentReference depthAttachmentRef{ 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+	VkSubpassDescription subpassDesc{};
+	subpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpassDesc.colorAttachmentCount = 1;
+	subpassDesc.pColorAttachments = &colorAttachmentRef;
+	subpassDesc.pDepthStencilAttachment = &depthAttachmentRef;
+
+	VkRenderPassCreateInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = static_cast<std::uint32_t>(attachmentDesc.size());
+	renderPassInfo.pAttachments = attachmentDesc.data();
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpassDesc;
+
+	VkRenderPass renderPass{};
+	if (vkCreateRenderPass(device_, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+		std::cerr << "[PipelineManager] failed to create compatible render pass" << std::endl;
+		return VK_NULL_HANDLE;
+	}
+	renderPasses_.emplace(key, renderPass);
+
+	return renderPass;
+}
+
+void PipelineManager::compile(Entry& entry) {
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	auto result = entry.renderPass != VK_NULL_HANDLE ? create_(entry.desc, entry.renderPass, pipeline) : VK_ERROR_INITIALIZATION_FAILED;
+
+	// pipeline() keeps handing out fallback
+	if (result != VK_SUCCESS || pipeline == VK_NULL_HANDLE) {
+		std::cerr << "[PipelineManager] failed to compile pipeline variant " << std::hex << hash(entry.desc) << std::dec << " (VkResult " << result << ")" << std::endl;
+		entry.failed = true;
+		return;
+	}
+
+	// record threads pick it up with their next bind
+	entry.pipeline.store(pipeline, std::memory_order_release);
+}
+
+PipelineManager::PipelineId PipelineManager::request(const GraphicsPipelineDesc& desc, PipelineId fallback) {
+	std::unique_lock lock(mutex_);
+
+	auto key = hash(desc);
+	auto& candidates = lookup_[key];
+	for (auto id : candidates) {
+		if (entries_[id]->desc == desc) return id;
+	}
+
+	auto entry = std::make_unique<Entry>();
+	entry->desc = desc;
+	entry->fallback = fallback;
+	// created here, so workers never touch renderPasses_
+	entry->renderPass = renderPass(desc);
+	entry->pipeline = VK_NULL_HANDLE;
+	entry->failed = false;
+
+	auto id = static_cast<PipelineId>(entries_.size());
+	auto& target = *entry;
+	entries_.push_back(std::move(entry));
+	candidates.push_back(id);
+
+	if (fallback == invalidId) {
+		// nothing to draw with until it exists
+		lock.unlock();
+		compile(target);
+		return id;
+	}
+
+	queue_.push_back(id);
+	lock.unlock();
+	queueCondition_.notify_one();
+
+	return id;
+}
+
+VkPipeline PipelineManager::pipeline(PipelineId id) const {
+	const auto& entry = *entries_[id];
+	auto pipeline = entry.pipeline.load(std::memory_order_acquire);
+	if (pipeline != VK_NULL_HANDLE || entry.fallback == invalidId) return pipeline;
+
+	return entries_[entry.fallback]->pipeline.load(std::memory_order_acquire);
+}
+
+void PipelineManager::workerMain() {
+	while (true) {
+		Entry* entry = nullptr;
+		{
+			std::unique_lock lock(mutex_);
+			queueCondition_.wait(lock, [this]() { return quit_ || !queue_.empty(); });
+			if (quit_) return;
+
+			entry = entries_[queue_.front()].get();
+			queue_.pop_front();
+			++compilingCount_;
+		}
+
+		// driver compile, the slow part, runs without lock
+		compile(*entry);
+
+		{
+			std::lock_guard lock(mutex_);
+			--compilingCount_;
+		}
+		idleCondition_.notify_all();
+	}
+}
+
+void PipelineManager::waitIdle() {
+	std::unique_lock lock(mutex_);
+	idleCondition_.wait(lock, [this]() { return queue_.empty() && compilingCount_ == 0; });
+}
+
+PipelineManager::Statistics PipelineManager::statistics() {
+	std::lock_guard lock(mutex_);
+
+	Statistics statistics{};
+	statistics.variantCount = static_cast<std::uint32_t>(entries_.size());
+	for (const auto& entry : entries_) {
+		if (entry->pipeline.load() != VK_NULL_HANDLE) ++statistics.readyCount;
+		else if (entry->failed) ++statistics.failedCount;
+	}
+	statistics.pendingCount = statistics.variantCount - statistics.readyCount - statistics.failedCount;
+
+	return statistics;
+}
+
+void PipelineManager::printStatistics() {
+	auto current = statistics();
+	std::cout << "pipeline variants: " << current.variantCount << " (" << current.readyCount << " ready, " << current.pendingCount << " compiling in background";
+	if (current.failedCount != 0) std::cout << ", " << current.failedCount << " failed";
+	std::cout << ")" << std::endl;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Hash.h"
+
+// everything a graphics pipeline variant depends on, hashed into its key
+// formats and sample count stand for render pass: any render pass with same attachments is compatible
+struct GraphicsPipelineDesc {
+	VkShaderModule vertexShader;
+	// VK_NULL_HANDLE -> depth only (no color writes)
+	VkShaderModule fragmentShader;
+	VkPipelineLayout layout;
+	VkFormat colorFormat;
+	VkFormat depthFormat;
+	VkSampleCountFlagBits samples;
+	VkCullModeFlags cullMode;
+	VkCompareOp depthCompareOp;
+	VkBool32 depthWrite;
+	VkBool32 blend;
+	// fragment shader specialization constants: constant_id i <- specialization[i], unused ones stay 0
+	std::uint32_t specializationCount;
+	std::array<std::uint32_t, 4> specialization;
+
+	bool operator==(const GraphicsPipelineDesc&) const = default;
+};
+
+// graphics pipeline variants by key, missing ones compiled on background threads
+// - generic variants (no fallback) are compiled on request, the caller waits for them
+// - other variants are queued, pipeline() hands out their fallback until they are ready -> drawing never waits
+// - request (main thread, outside of recording) must not run concurrently with pipeline()
+class PipelineManager {
+public:
+	using PipelineId = std::uint32_t;
+	static constexpr PipelineId invalidId = UINT32_MAX;
+
+	// fills pipeline from desc, created against render pass; runs on background threads too, so errors are returned (never exits)
+	using CreateFunction = std::function<VkResult(const GraphicsPipelineDesc&, VkRenderPass, VkPipeline&)>;
+
+	struct Statistics {
+		std::uint32_t variantCount;
+		std::uint32_t readyCount;
+		std::uint32_t pendingCount;
+		std::uint32_t failedCount;
+	};
+
+private:
+	struct Entry {
+		GraphicsPipelineDesc desc;
+		PipelineId fallback;
+		// compatible render pass, looked up on request
+		VkRenderPass renderPass;
+		// VK_NULL_HANDLE until compiled
+		std::atomic<VkPipeline> pipeline;
+		std::atomic<bool> failed;
+	};
+
+	VkDevice device_ = VK_NULL_HANDLE;
+	CreateFunction create_;
+
+	// guards everything below except entry pipelines
+	std::mutex mutex_;
+	std::vector<std::unique_ptr<Entry>> entries_;
+	// key -> variants with that key (equal descs, collisions are told apart by operator==)
+	std::unordered_map<std::uint64_t, std::vector<PipelineId>> lookup_;
+	// formats + samples -> render pass pipelines are created against
+	std::unordered_map<std::uint64_t, VkRenderPass> renderPasses_;
+
+	std::deque<PipelineId> queue_;
+	std::condition_variable queueCondition_;
+	std::condition_variable idleCondition_;
+	std::uint32_t compilingCount_ = 0;
+	bool quit_ = false;
+	std::vector<std::thread> threads_;
+
+	VkRenderPass renderPass(const GraphicsPipelineDesc&);
+	void compile(Entry&);
+	void workerMain();
+	void stopThreads();
+
+public:
+	PipelineManager() = default;
+	~PipelineManager() { stopThreads(); }
+
+	PipelineManager(const PipelineManager&) = delete;
+	PipelineManager& operator=(const PipelineManager&) = delete;
+
+	static std::uint64_t hash(const GraphicsPipelineDesc& desc);
+
+	void initialize(VkDevice device, CreateFunction create, std::uint32_t threadCount);
+	// waits for background compiles, destroys every variant
+	void deinitialize();
+
+	// fallback == invalidId -> compiled before returning (generic variant)
+	// otherwise queued, fallback has to be generic; same desc again -> same id
+	PipelineId request(const GraphicsPipelineDesc& desc, PipelineId fallback = invalidId);
+
+	// never blocks: variant once compiled, its fallback before that (or when compile failed)
+	VkPipeline pipeline(PipelineId id) const;
+	bool isReady(PipelineId id) const { return entries_[id]->pipeline.load(std::memory_order_acquire) != VK_NULL_HANDLE; }
+
+	// blocks until every queued variant is compiled (benchmarks)
+	void waitIdle();
+
+	Statistics statistics();
+	void printStatistics();
+};
@@ -0,0 +1,590 @@
+#include "RenderGraph.h"
+
+RenderGraph::UsageInfo RenderGraph::usageInfo(Usage usage) {
+	switch (usage) {
+	case Usage::ColorAttachment:
+		return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT };
+	case Usage::DepthAttachment:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT };
+	case Usage::DepthRead:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_USAGE_SAMPLED_BIT };
+	case Usage::SampledRead:
+		return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_USAGE_SAMPLED_BIT };
+	case Usage::StorageRead:
+		return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT };
+	case Usage::StorageWrite:
+		return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT };
+	case Usage::IndirectRead:
+		return { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, 0, 0 };
+	case Usage::Present:
+		// semaphore signal at end of submission makes transition available to presentation engine
+		return { VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, 0 };
+	default:
+		return {};
+	}
+}
+
+VkImageAspectFlags RenderGraph::aspectOf(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT;
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	default:
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
+RenderGraph::ResourceId RenderGraph::createImage(const char* name, const ImageDesc& desc) {
+	Resource resource{};
+	resource.name = name;
+	resource.isImage = true;
+	resource.desc = desc;
+	resource.desc.mipLevels = std::max(desc.mipLevels, 1u);
+
+	resources_.push_back(resource);
+	return static_cast<ResourceId>(resources_.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::importImage(const char* name, const ImageDesc& desc, const std::vector<VkImage>& images, const std::vector<VkImageView>& views) {
+	Resource resource{};
+	resource.name = name;
+	resource.isImage = true;
+	resource.imported = true;
+	resource.desc = desc;
+	resource.desc.mipLevels = std::max(desc.mipLevels, 1u);
+	resource.images = images;
+	resource.views = views;
+
+	resources_.push_back(resource);
+	return static_cast<ResourceId>(resources_.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::importBuffer(const char* name, VkBuffer buffer) {
+	Resource resource{};
+	resource.name = name;
+	resource.imported = true;
+	resource.buffer = buffer;
+
+	resources_.push_back(resource);
+	return static_cast<ResourceId>(resources_.size() - 1);
+}
+
+void RenderGraph::present(ResourceId resource) {
+	resources_[resource].present = true;
+	resources_[resource].output = true;
+}
+
+RenderGraph::PassId RenderGraph::addPass(const char* name, PassType type) {
+	Pass pass{};
+	pass.name = name;
+	pass.type = type;
+
+	passes_.push_back(std::move(pass));
+	return static_cast<PassId>(passes_.size() - 1);
+}
+
+RenderGraph::Use& RenderGraph::use(PassId pass, ResourceId resource, Usage usage) {
+	// one use per resource and pass, read + write merge into it
+	auto& uses = passes_[pass].uses;
+	auto found = std::find_if(uses.begin(), uses.end(), [resource](const Use& use) { return use.resource == resource; });
+	if (found != uses.end()) {
+		if (found->usage != usage) {
+			std::cerr << "[RenderGraph] pass " << passes_[pass].name << " uses " << resources_[resource].name << " in two ways, only first one is kept" << std::endl;
+		}
+		return *found;
+	}
+
+	uses.push_back(Use{ resource, usage, false, false });
+	return uses.back();
+}
+
+void RenderGraph::read(PassId pass, ResourceId resource, Usage usage) {
+	use(pass, resource, usage).read = true;
+}
+
+void RenderGraph::write(PassId pass, ResourceId resource, Usage usage) {
+	use(pass, resource, usage).write = true;
+}
+
+void RenderGraph::attachColor(PassId pass, ResourceId resource, VkAttachmentLoadOp loadOp, const VkClearColorValue& clearColor) {
+	write(pass, resource, Usage::ColorAttachment);
+	if (loadOp == VK_ATTACHMENT_LOAD_OP_LOAD) read(pass, resource, Usage::ColorAttachment);
+
+	VkClearValue clearValue{};
+	clearValue.color = clearColor;
+	passes_[pass].attachments.push_back(Attachment{ resource, loadOp, clearValue });
+}
+
+void RenderGraph::attachDepth(PassId pass, ResourceId resource, VkAttachmentLoadOp loadOp, float clearDepth) {
+	write(pass, resource, Usage::DepthAttachment);
+	if (loadOp == VK_ATTACHMENT_LOAD_OP_LOAD) read(pass, resource, Usage::DepthAttachment);
+
+	VkClearValue clearValue{};
+	clearValue.depthStencil = { clearDepth, 0 };
+	passes_[pass].attachments.push_back(Attachment{ resource, loadOp, clearValue });
+}
+
+void RenderGraph::cullPasses() {
+	// walk back from outputs: pass is live if it writes something a live pass (or outside) reads
+	std::vector<bool> needed(resources_.size(), false);
+	for (ResourceId resource = 0; resource < resources_.size(); ++resource) needed[resource] = resources_[resource].output;
+
+	for (auto pass = passes_.rbegin(); pass != passes_.rend(); ++pass) {
+		pass->culled = std::none_of(pass->uses.begin(), pass->uses.end(), [&needed](const Use& use) { return use.write && needed[use.resource]; });
+		if (pass->culled) continue;
+
+		for (const auto& use : pass->uses) {
+			if (use.read) needed[use.resource] = true;
+		}
+	}
+}
+
+bool RenderGraph::createTransientImages() {
+	// lifetimes and usage flags from live passes only
+	for (auto& resource : resources_) {
+		resource.firstPass = UINT32_MAX;
+		resource.lastPass = 0;
+		resource.imageUsage = 0;
+		resource.aspect = resource.isImage ? aspectOf(resource.desc.format) : 0;
+	}
+	for (std::uint32_t passIndex = 0; passIndex < passes_.size(); ++passIndex) {
+		if (passes_[passIndex].culled) continue;
+
+		for (const auto& use : passes_[passIndex].uses) {
+			auto& resource = resources_[use.resource];
+			resource.firstPass = std::min(resource.firstPass, passIndex);
+			resource.lastPass = std::max(resource.lastPass, passIndex);
+			resource.imageUsage |= usageInfo(use.usage).imageUsage;
+		}
+	}
+
+	std::vector<ResourceId> transients{};
+	for (ResourceId id = 0; id < resources_.size(); ++id) {
+		auto& resource = resources_[id];
+		if (!resource.isImage || resource.imported) continue;
+		// only used by culled passes
+		if (resource.firstPass == UINT32_MAX) continue;
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { resource.desc.size.width, resource.desc.size.height, 1 };
+		imageInfo.mipLevels = resource.desc.mipLevels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = resource.desc.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = resource.imageUsage;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+
+		VkImage image{};
+		if (vkCreateImage(device_, &imageInfo, allocator, &image) != VK_SUCCESS) {
+			std::cerr << "[RenderGraph] failed to create transient image " << resource.name << std::endl;
+			return false;
+		}
+		resource.images = { image };
+		transients.push_back(id);
+	}
+
+	// first fit in order of first use: slot is free once its last image's lifetime has ended
+	std::sort(transients.begin(), transients.end(), [this](ResourceId a, ResourceId b) { return resources_[a].firstPass < resources_[b].firstPass; });
+
+	std::vector<VkMemoryRequirements> requirements(resources_.size());
+	for (auto id : transients) {
+		auto& resource = resources_[id];
+		auto& imageRequirements = requirements[id];
+		vkGetImageMemoryRequirements(device_, resource.images[0], &imageRequirements);
+		statistics_.unaliasedSize += imageRequirements.size;
+
+		auto slot = std::find_if(aliasSlots_.begin(), aliasSlots_.end(), [&](const AliasSlot& slot) {
+			return slot.lastPass < resource.firstPass && (slot.requirements.memoryTypeBits & imageRequirements.memoryTypeBits) != 0;
+		});
+		if (slot == aliasSlots_.end()) {
+			aliasSlots_.push_back(AliasSlot{ imageRequirements, resource.lastPass, {} });
+			resource.aliasSlot = static_cast<std::uint32_t>(aliasSlots_.size() - 1);
+			continue;
+		}
+
+		slot->requirements.size = std::max(slot->requirements.size, imageRequirements.size);
+		slot->requirements.alignment = std::max(slot->requirements.alignment, imageRequirements.alignment);
+		slot->requirements.memoryTypeBits &= imageRequirements.memoryTypeBits;
+		slot->lastPass = resource.lastPass;
+		resource.aliasSlot = static_cast<std::uint32_t>(slot - aliasSlots_.begin());
+	}
+
+	for (auto& slot : aliasSlots_) {
+		if (!memoryAllocator_->allocate(slot.requirements, MemoryAllocator::MemoryUsage::Static, MemoryAllocator::ResourceKind::Optimal, slot.allocation)) {
+			std::cerr << "[RenderGraph] failed to allocate transient memory" << std::endl;
+			return false;
+		}
+		statistics_.transientSize += slot.requirements.size;
+	}
+	statistics_.transientImageCount = static_cast<std::uint32_t>(transients.size());
+	statistics_.aliasSlotCount = static_cast<std::uint32_t>(aliasSlots_.size());
+
+	for (auto id : transients) {
+		auto& resource = resources_[id];
+		const auto& allocation = aliasSlots_[resource.aliasSlot].allocation;
+		if (vkBindImageMemory(device_, resource.images[0], allocation.memory, allocation.offset) != VK_SUCCESS) {
+			std::cerr << "[RenderGraph] failed to bind memory of transient image " << resource.name << std::endl;
+			return false;
+		}
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = resource.images[0];
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = resource.desc.format;
+		viewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+		viewInfo.subresourceRange = { resource.aspect, 0, resource.desc.mipLevels, 0, 1 };
+
+		VkImageView view{};
+		if (vkCreateImageView(device_, &viewInfo, allocator, &view) != VK_SUCCESS) {
+			std::cerr << "[RenderGraph] failed to create view of transient image " << resource.name << std::endl;
+			return false;
+		}
+		resource.views = { view };
+	}
+
+	return true;
+}
+
+bool RenderGraph::createRenderPasses() {
+	for (std::uint32_t passIndex = 0; passIndex < passes_.size(); ++passIndex) {
+		auto& pass = passes_[passIndex];
+		if (pass.culled || pass.type != PassType::Graphics) continue;
+
+		std::vector<VkAttachmentDescription> attachmentDescs{};
+		std::vector<VkAttachmentReference> colorRefs{};
+		VkAttachmentReference depthRef{ VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED };
+		std::uint32_t variantCount = 1;
+
+		for (const auto& attachment : pass.attachments) {
+			const auto& resource = resources_[attachment.resource];
+			bool depth = resource.aspect & VK_IMAGE_ASPECT_DEPTH_BIT;
+			auto layout = depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			// content nobody reads later is not written back
+			bool store = resource.imported || resource.output || resource.lastPass > passIndex;
+
+			// layout is set by barriers before pass, so render pass does not transition
+			VkAttachmentDescription desc{};
+			desc.format = resource.desc.format;
+			desc.samples = VK_SAMPLE_COUNT_1_BIT;
+			desc.loadOp = attachment.loadOp;
+			desc.storeOp = store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			desc.initialLayout = layout;
+			desc.finalLayout = layout;
+
+			auto index = static_cast<std::uint32_t>(attachmentDescs.size());
+			attachmentDescs.push_back(desc);
+			if (depth) depthRef = { index, layout };
+			else colorRefs.push_back({ index, layout });
+
+			pass.extent = resource.desc.size;
+			variantCount = std::max(variantCount, static_cast<std::uint32_t>(resource.views.size()));
+		}
+
+		VkSubpassDescription subpassDesc{};
+		subpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDesc.colorAttachmentCount = static_cast<std::uint32_t>(colorRefs.size());
+		subpassDesc.pColorAttachments = colorRefs.data();
+		subpassDesc.pDepthStencilAttachment = depthRef.attachment != VK_ATTACHMENT_UNUSED ? &depthRef : nullptr;
+
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<std::uint32_t>(attachmentDescs.size());
+		renderPassInfo.pAttachments = attachmentDescs.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpassDesc;
+
+		if (vkCreateRenderPass(device_, &renderPassInfo, allocator, &pass.renderPass) != VK_SUCCESS) {
+			std::cerr << "[RenderGraph] failed to create render pass of " << pass.name << std::endl;
+			return false;
+		}
+
+		pass.framebuffers.resize(variantCount);
+		for (std::uint32_t variant = 0; variant < variantCount; ++variant) {
+			std::vector<VkImageView> views{};
+			for (const auto& attachment : pass.attachments) {
+				const auto& resource = resources_[attachment.resource];
+				views.push_back(resource.views[variant % resource.views.size()]);
+			}
+
+			VkFramebufferCreateInfo framebufferInfo{};
+			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferInfo.renderPass = pass.renderPass;
+			framebufferInfo.attachmentCount = static_cast<std::uint32_t>(views.size());
+			framebufferInfo.pAttachments = views.data();
+			framebufferInfo.width = pass.extent.width;
+			framebufferInfo.height = pass.extent.height;
+			framebufferInfo.layers = 1;
+
+			if (vkCreateFramebuffer(device_, &framebufferInfo, allocator, &pass.framebuffers[variant]) != VK_SUCCESS) {
+				std::cerr << "[RenderGraph] failed to create framebuffer of " << pass.name << std::endl;
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+RenderGraph::AccessState RenderGraph::initialState(ResourceId id) const {
+	// previous frame may still touch resource (or image sharing its memory) in any stage it is used in
+	const auto& resource = resources_[id];
+	bool aliased = resource.isImage && !resource.imported;
+
+	AccessState state{};
+	state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	for (std::uint32_t passIndex = 0; passIndex < passes_.size(); ++passIndex) {
+		if (passes_[passIndex].culled) continue;
+
+		for (const auto& use : passes_[passIndex].uses) {
+			const auto& other = resources_[use.resource];
+			bool sameMemory = use.resource == id || (aliased && other.isImage && !other.imported && other.firstPass != UINT32_MAX && other.aliasSlot == resource.aliasSlot);
+			if (!sameMemory) continue;
+
+			auto info = usageInfo(use.usage);
+			if (use.write) {
+				state.writeStages |= info.stages;
+				state.writeAccess |= info.writeAccess;
+			}
+			else {
+				state.readStages |= info.stages;
+			}
+		}
+	}
+	if (resource.present) state.writeStages |= usageInfo(Usage::Present).stages;
+
+	return state;
+}
+
+void RenderGraph::transition(ResourceId id, AccessState& state, Usage usage, bool write, BarrierBatch& batch) {
+	const auto& resource = resources_[id];
+	auto info = usageInfo(usage);
+
+	bool layoutChange = resource.isImage && state.layout != info.layout;
+	auto dstAccess = info.readAccess | (write ? info.writeAccess : 0);
+
+	VkPipelineStageFlags srcStages = 0;
+	VkAccessFlags srcAccess = 0;
+	bool needed = false;
+	if (layoutChange || write) {
+		// transition / write has to wait for earlier reads too
+		srcStages = state.writeStages | state.readStages;
+		srcAccess = state.writeAccess;
+		needed = layoutChange || srcStages != 0;
+	}
+	else if (state.writeStages != 0 && (state.visibleStages & info.stages) != info.stages) {
+		srcStages = state.writeStages;
+		srcAccess = state.writeAccess;
+		needed = true;
+	}
+
+	if (needed) {
+		batch.srcStages |= srcStages != 0 ? srcStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		batch.dstStages |= info.stages;
+		if (resource.isImage) batch.imageBarriers.push_back(ImageBarrier{ id, state.layout, info.layout, srcAccess, dstAccess });
+		else batch.bufferBarriers.push_back(BufferBarrier{ id, srcAccess, dstAccess });
+		++statistics_.barrierCount;
+	}
+
+	if (layoutChange || write) {
+		// layout transition counts as write later readers in other stages wait for
+		state.layout = resource.isImage ? info.layout : state.layout;
+		state.writeStages = write || layoutChange ? info.stages : 0;
+		state.writeAccess = write ? info.writeAccess : 0;
+		state.readStages = write ? 0 : info.stages;
+		state.visibleStages = info.stages;
+	}
+	else {
+		state.readStages |= info.stages;
+		if (needed) state.visibleStages |= info.stages;
+	}
+}
+
+void RenderGraph::buildBarriers() {
+	std::vector<AccessState> states(resources_.size());
+	for (ResourceId id = 0; id < resources_.size(); ++id) states[id] = initialState(id);
+
+	for (auto& pass : passes_) {
+		if (pass.culled) continue;
+
+		pass.barriers = BarrierBatch{};
+		for (const auto& use : pass.uses) transition(use.resource, states[use.resource], use.usage, use.write, pass.barriers);
+	}
+
+	finalBarriers_ = BarrierBatch{};
+	for (ResourceId id = 0; id < resources_.size(); ++id) {
+		if (resources_[id].present) transition(id, states[id], Usage::Present, false, finalBarriers_);
+	}
+}
+
+bool RenderGraph::compile(VkDevice device, MemoryAllocator& memoryAllocator) {
+	device_ = device;
+	memoryAllocator_ = &memoryAllocator;
+	statistics_ = Statistics{};
+
+	for (const auto& pass : passes_) {
+		if (pass.type == PassType::Graphics && pass.attachments.empty()) {
+			std::cerr << "[RenderGraph] graphics pass " << pass.name << " has no attachment" << std::endl;
+			return false;
+		}
+	}
+
+	cullPasses();
+	if (!createTransientImages()) return false;
+	if (!createRenderPasses()) return false;
+	buildBarriers();
+
+	statistics_.passCount = static_cast<std::uint32_t>(passes_.size());
+	statistics_.culledPassCount = static_cast<std::uint32_t>(std::count_if(passes_.begin(), passes_.end(), [](const Pass& pass) { return pass.culled; }));
+	compiled_ = true;
+
+	return true;
+}
+
+void RenderGraph::destroy() {
+	if (device_ == VK_NULL_HANDLE) return;
+
+	for (auto& pass : passes_) {
+		for (auto framebuffer : pass.framebuffers) vkDestroyFramebuffer(device_, framebuffer, allocator);
+		if (pass.renderPass != VK_NULL_HANDLE) vkDestroyRenderPass(device_, pass.renderPass, allocator);
+		pass.framebuffers.clear();
+		pass.renderPass = VK_NULL_HANDLE;
+	}
+	for (auto& resource : resources_) {
+		if (resource.imported) continue;
+
+		for (auto view : resource.views) vkDestroyImageView(device_, view, allocator);
+		for (auto image : resource.images) vkDestroyImage(device_, image, allocator);
+		resource.views.clear();
+		resource.images.clear();
+	}
+	// images are gone, so nothing is bound to slot memory anymore
+	for (const auto& slot : aliasSlots_) memoryAllocator_->free(slot.allocation);
+	aliasSlots_.clear();
+
+	compiled_ = false;
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch, std::uint32_t variant) const {
+	if (batch.imageBarriers.empty() && batch.bufferBarriers.empty()) return;
+
+	std::vector<VkImageMemoryBarrier> imageBarriers(batch.imageBarriers.size());
+	for (std::size_t i = 0; i < batch.imageBarriers.size(); ++i) {
+		const auto& barrier = batch.imageBarriers[i];
+		const auto& resource = resources_[barrier.resource];
+
+		auto& imageBarrier = imageBarriers[i];
+		imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageBarrier.srcAccessMask = barrier.srcAccess;
+		imageBarrier.dstAccessMask = barrier.dstAccess;
+		imageBarrier.oldLayout = barrier.oldLayout;
+		imageBarrier.newLayout = barrier.newLayout;
+		imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.image = image(barrier.resource, variant);
+		imageBarrier.subresourceRange = { resource.aspect, 0, resource.desc.mipLevels, 0, 1 };
+	}
+
+	std::vector<VkBufferMemoryBarrier> bufferBarriers(batch.bufferBarriers.size());
+	for (std::size_t i = 0; i < batch.bufferBarriers.size(); ++i) {
+		const auto& barrier = batch.bufferBarriers[i];
+
+		auto& bufferBarrier = bufferBarriers[i];
+		bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		bufferBarrier.srcAccessMask = barrier.srcAccess;
+		bufferBarrier.dstAccessMask = barrier.dstAccess;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = resources_[barrier.resource].buffer;
+		bufferBarrier.offset = 0;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+	}
+
+	vkCmdPipelineBarrier(commandBuffer, batch.srcStages, batch.dstStages, 0, 0, nullptr,
+		static_cast<std::uint32_t>(bufferBarriers.size()), bufferBarriers.data(), static_cast<std::uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer, std::uint32_t variant) const {
+	for (const auto& pass : passes_) {
+		if (pass.culled) continue;
+
+		recordBarriers(commandBuffer, pass.barriers, variant);
+
+		if (pass.type == PassType::Compute) {
+			if (pass.record) pass.record(commandBuffer);
+			continue;
+		}
+
+		std::vector<VkClearValue> clearValues{};
+		for (const auto& attachment : pass.attachments) clearValues.push_back(attachment.clearValue);
+
+		VkRenderPassBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		beginInfo.renderPass = pass.renderPass;
+		beginInfo.framebuffer = framebuffer(static_cast<PassId>(&pass - passes_.data()), variant);
+		beginInfo.renderArea.extent = pass.extent;
+		beginInfo.clearValueCount = static_cast<std::uint32_t>(clearValues.size());
+		beginInfo.pClearValues = clearValues.data();
+
+		auto contents = pass.secondaryCommandBuffers ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+		vkCmdBeginRenderPass(commandBuffer, &beginInfo, contents);
+
+		// secondary command buffers do not inherit dynamic state, they set their own
+		if (!pass.secondaryCommandBuffers) {
+			VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(pass.extent.width), static_cast<float>(pass.extent.height), 0.0f, 1.0f };
+			VkRect2D scissor = { {0, 0}, pass.extent };
+
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		}
+
+		if (pass.record) pass.record(commandBuffer);
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	recordBarriers(commandBuffer, finalBarriers_, variant);
+}
+
+VkImage RenderGraph::image(ResourceId resource, std::uint32_t variant) const {
+	const auto& images = resources_[resource].images;
+	return images.empty() ? VK_NULL_HANDLE : images[variant % images.size()];
+}
+
+VkImageView RenderGraph::imageView(ResourceId resource, std::uint32_t variant) const {
+	const auto& views = resources_[resource].views;
+	return views.empty() ? VK_NULL_HANDLE : views[variant % views.size()];
+}
+
+VkFramebuffer RenderGraph::framebuffer(PassId pass, std::uint32_t variant) const {
+	const auto& framebuffers = passes_[pass].framebuffers;
+	return framebuffers.empty() ? VK_NULL_HANDLE : framebuffers[variant % framebuffers.size()];
+}
+
+void RenderGraph::printStatistics() const {
+	auto flags = std::cout.flags();
+	auto precision = std::cout.precision();
+
+	constexpr double mebibyte = 1024.0 * 1024.0;
+	std::cout << "render graph: " << statistics_.passCount - statistics_.culledPassCount << " passes (" << statistics_.culledPassCount << " culled), "
+		<< statistics_.barrierCount << " barriers, " << statistics_.transientImageCount << " transient images in " << statistics_.aliasSlotCount << " allocations, "
+		<< std::fixed << std::setprecision(1) << statistics_.transientSize / mebibyte << " MiB (" << statistics_.unaliasedSize / mebibyte << " MiB without aliasing)" << std::endl;
+
+	for (const auto& pass : passes_) {
+		std::cout << "  " << (pass.culled ? "(culled) " : "") << pass.name << std::endl;
+	}
+
+	std::cout.flags(flags);
+	std::cout.precision(precision);
+}
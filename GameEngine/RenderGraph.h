@@ -0,0 +1,229 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "MemoryAllocator.h"
+
+// passes of one frame declared by the resources they read and write, compiled once per swapchain size
+// - barriers and layout transitions are derived from declared usages (also between end of one frame and start of next)
+// - passes whose writes never reach an output (present / markOutput) are culled
+// - transient images whose lifetimes (first to last live pass using them) do not overlap share memory
+// - graphics passes get render pass + framebuffers for their attachments, all transitions happen outside of them
+// image contents do not survive frames (first use starts from UNDEFINED), buffer contents do
+class RenderGraph {
+public:
+	using ResourceId = std::uint32_t;
+	using PassId = std::uint32_t;
+
+	// how a pass touches a resource -> layout, stages and accesses of barriers
+	enum class Usage {
+		// image, attachment of graphics pass (see attachColor / attachDepth)
+		ColorAttachment,
+		DepthAttachment,
+		// image, sampled in fragment or compute shader
+		DepthRead,
+		SampledRead,
+		// image (GENERAL, storage or sampled) or buffer, compute shader
+		StorageRead,
+		StorageWrite,
+		// buffer, arguments of indirect draws
+		IndirectRead,
+		// image, handed to presentation engine after last pass (see present)
+		Present,
+	};
+
+	enum class PassType {
+		Graphics,
+		Compute,
+	};
+
+	struct ImageDesc {
+		VkFormat format;
+		VkExtent2D size;
+		std::uint32_t mipLevels;
+	};
+
+	struct Statistics {
+		std::uint32_t passCount;
+		std::uint32_t culledPassCount;
+		std::uint32_t barrierCount;
+		std::uint32_t transientImageCount;
+		// memory blocks shared by transient images
+		std::uint32_t aliasSlotCount;
+		VkDeviceSize transientSize;
+		// what transient images would take with own memory each
+		VkDeviceSize unaliasedSize;
+	};
+
+private:
+	struct Resource {
+		const char* name;
+		bool isImage;
+		bool imported;
+		// read after graph (present, next frame) -> passes writing it are never culled
+		bool output;
+		bool present;
+		ImageDesc desc;
+		// imported: one per variant (e.g. swapchain image), transient: one
+		std::vector<VkImage> images;
+		std::vector<VkImageView> views;
+		VkBuffer buffer;
+
+		// filled by compile
+		VkImageUsageFlags imageUsage;
+		VkImageAspectFlags aspect;
+		std::uint32_t firstPass;
+		std::uint32_t lastPass;
+		std::uint32_t aliasSlot;
+	};
+
+	struct Use {
+		ResourceId resource;
+		Usage usage;
+		bool read;
+		bool write;
+	};
+
+	struct Attachment {
+		ResourceId resource;
+		VkAttachmentLoadOp loadOp;
+		VkClearValue clearValue;
+	};
+
+	struct ImageBarrier {
+		ResourceId resource;
+		VkImageLayout oldLayout;
+		VkImageLayout newLayout;
+		VkAccessFlags srcAccess;
+		VkAccessFlags dstAccess;
+	};
+
+	struct BufferBarrier {
+		ResourceId resource;
+		VkAccessFlags srcAccess;
+		VkAccessFlags dstAccess;
+	};
+
+	// recorded right before a pass (or after last one)
+	struct BarrierBatch {
+		VkPipelineStageFlags srcStages;
+		VkPipelineStageFlags dstStages;
+		std::vector<ImageBarrier> imageBarriers;
+		std::vector<BufferBarrier> bufferBarriers;
+	};
+
+	struct Pass {
+		const char* name;
+		PassType type;
+		std::vector<Use> uses;
+		std::vector<Attachment> attachments;
+		bool secondaryCommandBuffers;
+		std::function<void(VkCommandBuffer)> record;
+
+		// filled by compile
+		bool culled;
+		BarrierBatch barriers;
+		VkRenderPass renderPass;
+		VkExtent2D extent;
+		// one per variant of imported attachments
+		std::vector<VkFramebuffer> framebuffers;
+	};
+
+	// memory shared by transient images used one after another
+	struct AliasSlot {
+		VkMemoryRequirements requirements;
+		std::uint32_t lastPass;
+		MemoryAllocator::Allocation allocation;
+	};
+
+	// access state of a resource while barriers are derived
+	struct AccessState {
+		VkImageLayout layout;
+		VkPipelineStageFlags writeStages;
+		VkAccessFlags writeAccess;
+		VkPipelineStageFlags readStages;
+		// stages that already waited for last write
+		VkPipelineStageFlags visibleStages;
+	};
+
+	struct UsageInfo {
+		VkImageLayout layout;
+		VkPipelineStageFlags stages;
+		VkAccessFlags readAccess;
+		VkAccessFlags writeAccess;
+		VkImageUsageFlags imageUsage;
+	};
+
+	static constexpr VkAllocationCallbacks* allocator = nullptr;
+
+	VkDevice device_ = VK_NULL_HANDLE;
+	MemoryAllocator* memoryAllocator_ = nullptr;
+
+	std::vector<Resource> resources_;
+	std::vector<Pass> passes_;
+	std::vector<AliasSlot> aliasSlots_;
+	// transitions of presented images after last pass
+	BarrierBatch finalBarriers_;
+	Statistics statistics_{};
+	bool compiled_ = false;
+
+	static UsageInfo usageInfo(Usage);
+	static VkImageAspectFlags aspectOf(VkFormat);
+
+	Use& use(PassId, ResourceId, Usage);
+	void cullPasses();
+	bool createTransientImages();
+	bool createRenderPasses();
+	AccessState initialState(ResourceId) const;
+	void transition(ResourceId, AccessState&, Usage, bool, BarrierBatch&);
+	void buildBarriers();
+	void recordBarriers(VkCommandBuffer, const BarrierBatch&, std::uint32_t) const;
+
+public:
+	// transient image, created (and aliased) by compile
+	ResourceId createImage(const char* name, const ImageDesc& desc);
+	// image owned by caller, variant is picked by execute (e.g. swapchain image index)
+	ResourceId importImage(const char* name, const ImageDesc& desc, const std::vector<VkImage>& images, const std::vector<VkImageView>& views);
+	ResourceId importBuffer(const char* name, VkBuffer buffer);
+	// image is transitioned for presentation after last pass, its writers are kept
+	void present(ResourceId resource);
+	// resource is consumed outside of graph (e.g. by next frame), its writers are kept
+	void markOutput(ResourceId resource) { resources_[resource].output = true; }
+
+	// passes run in order of addition
+	PassId addPass(const char* name, PassType type);
+	void read(PassId pass, ResourceId resource, Usage usage);
+	void write(PassId pass, ResourceId resource, Usage usage);
+	// LOAD also counts as read of previous content
+	void attachColor(PassId pass, ResourceId resource, VkAttachmentLoadOp loadOp, const VkClearColorValue& clearColor = {});
+	void attachDepth(PassId pass, ResourceId resource, VkAttachmentLoadOp loadOp, float clearDepth = 1.0f);
+	// pass body is vkCmdExecuteCommands of secondaries recorded against renderPass / framebuffer
+	void setSecondaryCommandBuffers(PassId pass, bool enable) { passes_[pass].secondaryCommandBuffers = enable; }
+	// called by execute inside render pass (graphics) or after barriers (compute), may be replaced every frame
+	void setRecord(PassId pass, std::function<void(VkCommandBuffer)> record) { passes_[pass].record = std::move(record); }
+
+	// culls passes, creates transient images, render passes and framebuffers, derives barriers
+	bool compile(VkDevice device, MemoryAllocator& memoryAllocator);
+	// every object created by compile, caller makes sure GPU no longer uses them
+	void destroy();
+
+	// live passes with their barriers, variant selects imported images
+	void execute(VkCommandBuffer commandBuffer, std::uint32_t variant) const;
+
+	VkImage image(ResourceId resource, std::uint32_t variant = 0) const;
+	VkImageView imageView(ResourceId resource, std::uint32_t variant = 0) const;
+	const ImageDesc& imageDesc(ResourceId resource) const { return resources_[resource].desc; }
+	bool isCulled(PassId pass) const { return passes_[pass].culled; }
+	VkRenderPass renderPass(PassId pass) const { return passes_[pass].renderPass; }
+	VkFramebuffer framebuffer(PassId pass, std::uint32_t variant) const;
+
+	const Statistics& statistics() const { return statistics_; }
+	void printStatistics() const;
+};
@@ -0,0 +1,57 @@
+#include "RenderQueue.h"
+
+#include <cassert>
+
+std::uint64_t RenderQueue::makeKey(Pass pass, std::uint32_t pipeline, std::uint32_t material, float depth) {
+	constexpr std::uint64_t depthMask = (1ull << depthBits) - 1;
+	constexpr std::uint64_t pipelineMask = (1ull << pipelineBits) - 1;
+	constexpr std::uint64_t materialMask = (1ull << materialBits) - 1;
+
+	// masked bits would alias other materials or pipelines in sort order
+	assert(pipeline <= pipelineMask && material <= materialMask);
+
+	auto quantizedDepth = static_cast<std::uint64_t>(std::clamp(depth, 0.0f, 1.0f) * depthMask);
+
+	std::uint64_t key = static_cast<std::uint64_t>(pass) << 62;
+	if (pass == Pass::Depth) {
+		// nearest first, nothing is bound between depth only draws
+		key |= quantizedDepth << 38;
+		key |= (pipeline & pipelineMask) << 30;
+		key |= (material & materialMask) << 14;
+	}
+	else if (pass == Pass::Transparent) {
+		// farthest first, state only breaks ties
+		key |= (depthMask - quantizedDepth) << 38;
+		key |= (pipeline & pipelineMask) << 30;
+		key |= (material & materialMask) << 14;
+	}
+	else {
+		key |= (pipeline & pipelineMask) << 54;
+		key |= (material & materialMask) << 38;
+		key |= quantizedDepth << 14;
+	}
+
+	return key;
+}
+
+void RenderQueue::sort() {
+	scratch_.resize(packets_.size());
+
+	for (std::uint32_t shift = 0; shift < 64; shift += radixBits) {
+		std::array<std::uint32_t, radixSize> counts{};
+		for (const auto& packet : packets_) ++counts[(packet.key >> shift) & (radixSize - 1)];
+
+		// every key has same digit -> pass would not move anything
+		if (std::any_of(counts.begin(), counts.end(), [this](std::uint32_t count) { return count == packets_.size(); })) continue;
+
+		std::uint32_t offset = 0;
+		for (auto& count : counts) {
+			auto digitCount = count;
+			count = offset;
+			offset += digitCount;
+		}
+
+		for (const auto& packet : packets_) scratch_[counts[(packet.key >> shift) & (radixSize - 1)]++] = packet;
+		packets_.swap(scratch_);
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// draw of one material of one scene object
+struct DrawPacket {
+	std::uint64_t key;
+	std::uint32_t pipeline;
+	std::uint32_t material;
+	std::uint32_t object;
+	// RenderQueue::Pass
+	std::uint32_t pass;
+};
+
+// draw packets of one frame, radix sorted by 64 bit key
+// - depth:       pass (2) | depth (24) | pipeline (8) | material (16)          -> front to back (state is same for whole pass)
+// - opaque:      pass (2) | pipeline (8) | material (16) | depth (24)          -> state sorted, front to back inside
+// - transparent: pass (2) | inverted depth (24) | pipeline (8) | material (16) -> back to front
+// - lowest 14 bits are unused (their radix passes are skipped)
+class RenderQueue {
+public:
+	// also execution order of passes
+	enum class Pass : std::uint32_t {
+		Depth = 0,
+		Opaque = 1,
+		Transparent = 2,
+	};
+	static constexpr std::uint32_t passCount = 3;
+
+	// binds issued while emitting sorted packets
+	struct StateChanges {
+		std::uint32_t pipelines;
+		std::uint32_t materials;
+	};
+
+	static constexpr std::uint32_t pipelineBits = 8;
+	static constexpr std::uint32_t materialBits = 16;
+	static constexpr std::uint32_t depthBits = 24;
+
+private:
+	static constexpr std::uint32_t radixBits = 8;
+	static constexpr std::uint32_t radixSize = 1u << radixBits;
+
+	std::vector<DrawPacket> packets_;
+	// ping-pong buffer of radix sort
+	std::vector<DrawPacket> scratch_;
+
+public:
+	// depth: view distance normalized to [0, 1] (near -> 0), clamped
+	static std::uint64_t makeKey(Pass pass, std::uint32_t pipeline, std::uint32_t material, float depth);
+
+	void clear() { packets_.clear(); }
+	void push(const DrawPacket& packet) { packets_.push_back(packet); }
+	// stable LSD radix sort, 8 bits per pass
+	void sort();
+
+	const std::vector<DrawPacket>& packets() const { return packets_; }
+	std::size_t size() const { return packets_.size(); }
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// models to load and objects placing them, handed to GraphicsEngine before initialize
+// - every model is loaded once, objects referencing the same model share its geometry and textures
+class Scene {
+public:
+	struct Object {
+		std::uint32_t model;
+		glm::mat4 transform;
+	};
+
+private:
+	std::vector<std::filesystem::path> models_;
+	std::vector<Object> objects_;
+
+public:
+	// returns index for addObject
+	std::uint32_t addModel(const std::filesystem::path& path) {
+		models_.push_back(path);
+		return static_cast<std::uint32_t>(models_.size() - 1);
+	}
+	void addObject(std::uint32_t model, const glm::mat4& transform) { objects_.push_back(Object{ model, transform }); }
+
+	const std::vector<std::filesystem::path>& models() const { return models_; }
+	const std::vector<Object>& objects() const { return objects_; }
+	bool empty() const { return objects_.empty(); }
+};
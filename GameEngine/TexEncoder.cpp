@@ -0,0 +1,473 @@
+#include "TexEncoder.h"
+
+namespace {
+	// 8-bit sRGB <-> linear tables for mip filtering
+	struct SRGBTable {
+		float toLinear[256];
+		std::uint8_t fromLinear[4096];
+
+		SRGBTable() {
+			for (auto i = 0; i < 256; ++i) {
+				auto c = i / 255.0f;
+				toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (auto i = 0; i < 4096; ++i) {
+				auto c = i / 4095.0f;
+				auto s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+				fromLinear[i] = static_cast<std::uint8_t>(std::clamp(s * 255.0f + 0.5f, 0.0f, 255.0f));
+			}
+		}
+	};
+
+	const SRGBTable& srgbTable() {
+		static SRGBTable table{};
+		return table;
+	}
+
+	// per channel min / max of 16 texels
+	void blockMinMax(const std::uint8_t* texels, std::uint8_t minColor[4], std::uint8_t maxColor[4]) {
+#ifdef TEX_ENCODER_SSE2
+		auto t0 = _mm_load_si128(reinterpret_cast<const __m128i*>(texels));
+		auto t1 = _mm_load_si128(reinterpret_cast<const __m128i*>(texels + 16));
+		auto t2 = _mm_load_si128(reinterpret_cast<const __m128i*>(texels + 32));
+		auto t3 = _mm_load_si128(reinterpret_cast<const __m128i*>(texels + 48));
+
+		auto minValue = _mm_min_epu8(_mm_min_epu8(t0, t1), _mm_min_epu8(t2, t3));
+		auto maxValue = _mm_max_epu8(_mm_max_epu8(t0, t1), _mm_max_epu8(t2, t3));
+
+		// 4 texels per register -> 1 texel
+		minValue = _mm_min_epu8(minValue, _mm_shuffle_epi32(minValue, _MM_SHUFFLE(1, 0, 3, 2)));
+		minValue = _mm_min_epu8(minValue, _mm_shuffle_epi32(minValue, _MM_SHUFFLE(2, 3, 0, 1)));
+		maxValue = _mm_max_epu8(maxValue, _mm_shuffle_epi32(maxValue, _MM_SHUFFLE(1, 0, 3, 2)));
+		maxValue = _mm_max_epu8(maxValue, _mm_shuffle_epi32(maxValue, _MM_SHUFFLE(2, 3, 0, 1)));
+
+		auto minPacked = static_cast<std::uint32_t>(_mm_cvtsi128_si32(minValue));
+		auto maxPacked = static_cast<std::uint32_t>(_mm_cvtsi128_si32(maxValue));
+		std::memcpy(minColor, &minPacked, 4);
+		std::memcpy(maxColor, &maxPacked, 4);
+#else
+		for (auto c = 0; c < 4; ++c) {
+			minColor[c] = 255;
+			maxColor[c] = 0;
+		}
+		for (auto i = 0; i < 16; ++i) {
+			for (auto c = 0; c < 4; ++c) {
+				minColor[c] = std::min(minColor[c], texels[i * 4 + c]);
+				maxColor[c] = std::max(maxColor[c], texels[i * 4 + c]);
+			}
+		}
+#endif
+	}
+
+	// dot(texel - origin, axis) of 16 texels
+	void project(const std::uint8_t* texels, const int origin[4], const int axis[4], int dots[16]) {
+#ifdef TEX_ENCODER_SSE2
+		auto zero = _mm_setzero_si128();
+		auto originValue = _mm_setr_epi16(
+			static_cast<short>(origin[0]), static_cast<short>(origin[1]), static_cast<short>(origin[2]), static_cast<short>(origin[3]),
+			static_cast<short>(origin[0]), static_cast<short>(origin[1]), static_cast<short>(origin[2]), static_cast<short>(origin[3]));
+		auto axisValue = _mm_setr_epi16(
+			static_cast<short>(axis[0]), static_cast<short>(axis[1]), static_cast<short>(axis[2]), static_cast<short>(axis[3]),
+			static_cast<short>(axis[0]), static_cast<short>(axis[1]), static_cast<short>(axis[2]), static_cast<short>(axis[3]));
+
+		for (auto i = 0; i < 4; ++i) {
+			auto t = _mm_load_si128(reinterpret_cast<const __m128i*>(texels + i * 16));
+
+			// 8 bit -> 16 bit (2 texels per register), then (r * ar + g * ag), (b * ab + a * aa)
+			auto low = _mm_madd_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(t, zero), originValue), axisValue);
+			auto high = _mm_madd_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(t, zero), originValue), axisValue);
+
+			auto even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(2, 0, 2, 0)));
+			auto odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(3, 1, 3, 1)));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dots + i * 4), _mm_add_epi32(even, odd));
+		}
+#else
+		for (auto i = 0; i < 16; ++i) {
+			dots[i] = 0;
+			for (auto c = 0; c < 4; ++c) dots[i] += (texels[i * 4 + c] - origin[c]) * axis[c];
+		}
+#endif
+	}
+
+	// nearest of (levels) evenly spaced points along axis, 0 = origin
+	void quantize(const int dots[16], int axisLength2, int levels, int indices[16]) {
+		for (auto i = 0; i < 16; ++i) {
+			if (axisLength2 <= 0 || dots[i] <= 0) {
+				indices[i] = 0;
+				continue;
+			}
+			indices[i] = std::min(levels - 1, (dots[i] * (levels - 1) * 2 + axisLength2) / (2 * axisLength2));
+		}
+	}
+
+	// endpoints = extent of texels along principal axis (range fit)
+	void fitEndpoints(const std::uint8_t* texels, int channels, int endpoint0[4], int endpoint1[4]) {
+		float mean[4]{};
+		for (auto i = 0; i < 16; ++i) {
+			for (auto c = 0; c < channels; ++c) mean[c] += texels[i * 4 + c];
+		}
+		for (auto c = 0; c < channels; ++c) mean[c] /= 16.0f;
+
+		float covariance[4][4]{};
+		for (auto i = 0; i < 16; ++i) {
+			for (auto r = 0; r < channels; ++r) {
+				for (auto c = 0; c < channels; ++c) {
+					covariance[r][c] += (texels[i * 4 + r] - mean[r]) * (texels[i * 4 + c] - mean[c]);
+				}
+			}
+		}
+
+		// power iteration starting from bounding box diagonal
+		std::uint8_t minColor[4]{}, maxColor[4]{};
+		blockMinMax(texels, minColor, maxColor);
+
+		float axis[4]{};
+		for (auto c = 0; c < channels; ++c) axis[c] = static_cast<float>(maxColor[c] - minColor[c]);
+
+		for (auto iteration = 0; iteration < 4; ++iteration) {
+			float next[4]{};
+			for (auto r = 0; r < channels; ++r) {
+				for (auto c = 0; c < channels; ++c) next[r] += covariance[r][c] * axis[c];
+			}
+
+			float length = 0.0f;
+			for (auto c = 0; c < channels; ++c) length = std::max(length, std::abs(next[c]));
+			if (length == 0.0f) break;
+
+			for (auto c = 0; c < channels; ++c) axis[c] = next[c] / length;
+		}
+
+		float axisLength2 = 0.0f;
+		for (auto c = 0; c < channels; ++c) axisLength2 += axis[c] * axis[c];
+
+		float minT = 0.0f, maxT = 0.0f;
+		if (axisLength2 > 0.0f) {
+			minT = std::numeric_limits<float>::max();
+			maxT = std::numeric_limits<float>::lowest();
+			for (auto i = 0; i < 16; ++i) {
+				float t = 0.0f;
+				for (auto c = 0; c < channels; ++c) t += (texels[i * 4 + c] - mean[c]) * axis[c];
+				t /= axisLength2;
+				minT = std::min(minT, t);
+				maxT = std::max(maxT, t);
+			}
+		}
+
+		for (auto c = 0; c < 4; ++c) {
+			if (c < channels) {
+				endpoint0[c] = static_cast<int>(std::clamp(mean[c] + axis[c] * maxT + 0.5f, 0.0f, 255.0f));
+				endpoint1[c] = static_cast<int>(std::clamp(mean[c] + axis[c] * minT + 0.5f, 0.0f, 255.0f));
+			}
+			else {
+				endpoint0[c] = endpoint1[c] = 255;
+			}
+		}
+	}
+
+	std::uint16_t packRGB565(const int color[4]) {
+		return static_cast<std::uint16_t>(((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 | ((color[2] * 31 + 127) / 255));
+	}
+
+	void unpackRGB565(std::uint16_t packed, int color[4]) {
+		auto r = (packed >> 11) & 0x1f;
+		auto g = (packed >> 5) & 0x3f;
+		auto b = packed & 0x1f;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+		color[3] = 0;
+	}
+
+	// BC1 color block (always 4 color mode)
+	void encodeColorBlock(const std::uint8_t* texels, std::uint8_t* dest) {
+		int endpoint0[4]{}, endpoint1[4]{};
+		fitEndpoints(texels, 3, endpoint0, endpoint1);
+
+		auto color0 = packRGB565(endpoint0);
+		auto color1 = packRGB565(endpoint1);
+		if (color0 < color1) std::swap(color0, color1);
+
+		std::uint32_t indexBits = 0;
+		if (color0 != color1) {
+			int decoded0[4]{}, decoded1[4]{};
+			unpackRGB565(color0, decoded0);
+			unpackRGB565(color1, decoded1);
+
+			int axis[4] = { decoded1[0] - decoded0[0], decoded1[1] - decoded0[1], decoded1[2] - decoded0[2], 0 };
+			int axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+			int dots[16]{}, steps[16]{};
+			project(texels, decoded0, axis, dots);
+			quantize(dots, axisLength2, 4, steps);
+
+			// step along line (color0 -> color1) -> BC1 index
+			constexpr std::uint32_t indexOfStep[4] = { 0, 2, 3, 1 };
+			for (auto i = 0; i < 16; ++i) indexBits |= indexOfStep[steps[i]] << (i * 2);
+		}
+
+		std::memcpy(dest + 0, &color0, 2);
+		std::memcpy(dest + 2, &color1, 2);
+		std::memcpy(dest + 4, &indexBits, 4);
+	}
+
+	// BC4 style alpha block (always 8 value mode)
+	void encodeAlphaBlock(const std::uint8_t* texels, std::uint8_t* dest) {
+		std::uint8_t minColor[4]{}, maxColor[4]{};
+		blockMinMax(texels, minColor, maxColor);
+
+		int alpha0 = maxColor[3];
+		int alpha1 = minColor[3];
+
+		std::uint64_t indexBits = 0;
+		if (alpha0 != alpha1) {
+			// step along line (alpha0 -> alpha1) -> BC4 index
+			constexpr std::uint64_t indexOfStep[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+			for (auto i = 0; i < 16; ++i) {
+				auto step = ((alpha0 - texels[i * 4 + 3]) * 14 + (alpha0 - alpha1)) / (2 * (alpha0 - alpha1));
+				indexBits |= indexOfStep[step] << (i * 3);
+			}
+		}
+
+		dest[0] = static_cast<std::uint8_t>(alpha0);
+		dest[1] = static_cast<std::uint8_t>(alpha1);
+		for (auto i = 0; i < 6; ++i) dest[2 + i] = static_cast<std::uint8_t>(indexBits >> (i * 8));
+	}
+
+	// little endian bit stream (BC7)
+	struct BitWriter {
+		std::uint8_t* dest;
+		std::uint32_t position;
+
+		void write(std::uint32_t value, std::uint32_t bitCount) {
+			for (std::uint32_t i = 0; i < bitCount; ++i, ++position) {
+				if ((value >> i) & 1) dest[position >> 3] |= static_cast<std::uint8_t>(1 << (position & 7));
+			}
+		}
+	};
+
+	// 8 bit -> 7 bit + shared p-bit, p-bit chosen per endpoint by error
+	void quantizeEndpointBC7(const int endpoint[4], int quantized[4], int& pBit, int decoded[4]) {
+		int bestError = std::numeric_limits<int>::max();
+		for (auto p = 0; p < 2; ++p) {
+			int candidate[4]{};
+			int error = 0;
+			for (auto c = 0; c < 4; ++c) {
+				candidate[c] = std::clamp((endpoint[c] - p + 1) >> 1, 0, 127);
+				error += std::abs(((candidate[c] << 1) | p) - endpoint[c]);
+			}
+			if (error < bestError) {
+				bestError = error;
+				pBit = p;
+				for (auto c = 0; c < 4; ++c) quantized[c] = candidate[c];
+			}
+		}
+		for (auto c = 0; c < 4; ++c) decoded[c] = (quantized[c] << 1) | pBit;
+	}
+}
+
+TexEncoder::TexEncoder(std::uint32_t threadCount) : threadCount_(threadCount) {
+	if (threadCount_ == 0) threadCount_ = std::max(1u, std::thread::hardware_concurrency());
+}
+
+void TexEncoder::encodeBC1(const Block& block, std::uint8_t* dest) {
+	encodeColorBlock(block.texels, dest);
+}
+
+void TexEncoder::encodeBC3(const Block& block, std::uint8_t* dest) {
+	encodeAlphaBlock(block.texels, dest);
+	encodeColorBlock(block.texels, dest + 8);
+}
+
+void TexEncoder::encodeBC7(const Block& block, std::uint8_t* dest) {
+	// mode 6: single subset, RGBA 7.7.7.7 + p-bit endpoints, 4 bit indices
+	int endpoint0[4]{}, endpoint1[4]{};
+	fitEndpoints(block.texels, 4, endpoint0, endpoint1);
+
+	int quantized0[4]{}, quantized1[4]{}, decoded0[4]{}, decoded1[4]{};
+	int pBit0{}, pBit1{};
+	quantizeEndpointBC7(endpoint0, quantized0, pBit0, decoded0);
+	quantizeEndpointBC7(endpoint1, quantized1, pBit1, decoded1);
+
+	int axis[4] = { decoded1[0] - decoded0[0], decoded1[1] - decoded0[1], decoded1[2] - decoded0[2], decoded1[3] - decoded0[3] };
+	int axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3];
+
+	int dots[16]{}, indices[16]{};
+	project(block.texels, decoded0, axis, dots);
+	quantize(dots, axisLength2, 16, indices);
+
+	// anchor index (texel 0) must have MSB = 0 -> swap endpoints
+	if (indices[0] >= 8) {
+		std::swap(quantized0, quantized1);
+		std::swap(pBit0, pBit1);
+		for (auto& index : indices) index = 15 - index;
+	}
+
+	std::memset(dest, 0, 16);
+	BitWriter writer{ dest, 0 };
+
+	writer.write(1 << 6, 7);
+	for (auto c = 0; c < 4; ++c) {
+		writer.write(quantized0[c], 7);
+		writer.write(quantized1[c], 7);
+	}
+	writer.write(pBit0, 1);
+	writer.write(pBit1, 1);
+
+	writer.write(indices[0], 3);
+	for (auto i = 1; i < 16; ++i) writer.write(indices[i], 4);
+}
+
+void TexEncoder::buildMipChain(const TexImage& source, std::uint32_t mipLevels, std::vector<std::vector<std::uint8_t>>& levels) {
+	const auto& table = srgbTable();
+	bool srgb = source.format == VK_FORMAT_R8G8B8A8_SRGB;
+
+	levels.resize(mipLevels);
+
+	auto sourceWidth = source.size.width;
+	auto sourceHeight = source.size.height;
+	const std::uint8_t* sourcePixels = source.data.data();
+
+	for (std::uint32_t level = 1; level < mipLevels; ++level) {
+		auto width = std::max(1u, sourceWidth >> 1);
+		auto height = std::max(1u, sourceHeight >> 1);
+
+		auto& pixels = levels[level];
+		pixels.resize(static_cast<std::size_t>(width) * height * 4);
+
+		// 2x2 box filter (color in linear space when source is sRGB)
+		for (std::uint32_t y = 0; y < height; ++y) {
+			for (std::uint32_t x = 0; x < width; ++x) {
+				std::uint32_t x0 = std::min(x * 2, sourceWidth - 1), x1 = std::min(x * 2 + 1, sourceWidth - 1);
+				std::uint32_t y0 = std::min(y * 2, sourceHeight - 1), y1 = std::min(y * 2 + 1, sourceHeight - 1);
+
+				const std::uint8_t* texels[4] = {
+					sourcePixels + (static_cast<std::size_t>(y0) * sourceWidth + x0) * 4,
+					sourcePixels + (static_cast<std::size_t>(y0) * sourceWidth + x1) * 4,
+					sourcePixels + (static_cast<std::size_t>(y1) * sourceWidth + x0) * 4,
+					sourcePixels + (static_cast<std::size_t>(y1) * sourceWidth + x1) * 4,
+				};
+
+				auto dest = pixels.data() + (static_cast<std::size_t>(y) * width + x) * 4;
+				for (auto c = 0; c < 4; ++c) {
+					if (srgb && c < 3) {
+						auto sum = table.toLinear[texels[0][c]] + table.toLinear[texels[1][c]] + table.toLinear[texels[2][c]] + table.toLinear[texels[3][c]];
+						dest[c] = table.fromLinear[static_cast<std::size_t>(sum * 0.25f * 4095.0f + 0.5f)];
+					}
+					else {
+						dest[c] = static_cast<std::uint8_t>((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+					}
+				}
+			}
+		}
+
+		sourceWidth = width;
+		sourceHeight = height;
+		sourcePixels = pixels.data();
+	}
+}
+
+void TexEncoder::loadBlock(const Level& level, std::uint32_t blockX, std::uint32_t blockY, Block& block) {
+	// edge texels are repeated for partial blocks
+	for (std::uint32_t y = 0; y < 4; ++y) {
+		auto sourceY = std::min(blockY * 4 + y, level.height - 1);
+		for (std::uint32_t x = 0; x < 4; ++x) {
+			auto sourceX = std::min(blockX * 4 + x, level.width - 1);
+			std::memcpy(block.texels + (y * 4 + x) * 4, level.pixels + (static_cast<std::size_t>(sourceY) * level.width + sourceX) * 4, 4);
+		}
+	}
+}
+
+bool TexEncoder::encode(const TexImage& source, Mode mode, TexImage& encoded) {
+	if (source.format != VK_FORMAT_R8G8B8A8_SRGB && source.format != VK_FORMAT_R8G8B8A8_UNORM) {
+		std::cerr << "[TexEncoder] source image must be R8G8B8A8" << std::endl;
+		return false;
+	}
+	if (source.mipLevels != 1 || source.arrayLayers != 1) {
+		std::cerr << "[TexEncoder] source image must have single level and layer" << std::endl;
+		return false;
+	}
+
+	auto mipLevels = static_cast<std::uint32_t>(std::floor(std::log2(std::max(source.size.width, source.size.height)))) + 1;
+
+	std::vector<std::vector<std::uint8_t>> levelPixels{};
+	buildMipChain(source, mipLevels, levelPixels);
+
+	std::vector<Level> levels(mipLevels);
+	for (std::uint32_t level = 0; level < mipLevels; ++level) {
+		levels[level].width = std::max(1u, source.size.width >> level);
+		levels[level].height = std::max(1u, source.size.height >> level);
+		levels[level].pixels = level == 0 ? source.data.data() : levelPixels[level].data();
+	}
+
+	bool srgb = source.format == VK_FORMAT_R8G8B8A8_SRGB;
+
+	// scanned by TexLoader::decode
+	bool opaque = source.opaque;
+
+	void (*encodeBlock)(const Block&, std::uint8_t*) = nullptr;
+	std::size_t blockSize{};
+	if (mode == Mode::Quality) {
+		encoded.format = srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+		encodeBlock = encodeBC7;
+		blockSize = 16;
+	}
+	else if (opaque) {
+		encoded.format = srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		encodeBlock = encodeBC1;
+		blockSize = 8;
+	}
+	else {
+		encoded.format = srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+		encodeBlock = encodeBC3;
+		blockSize = 16;
+	}
+
+	encoded.size = source.size;
+	encoded.mipLevels = mipLevels;
+	encoded.arrayLayers = 1;
+	encoded.cube = false;
+	encoded.opaque = opaque;
+	encoded.subresourceOffsets.resize(mipLevels);
+
+	// one task per block row of every level
+	struct Task {
+		std::uint32_t level;
+		std::uint32_t blockY;
+	};
+	std::vector<Task> tasks{};
+
+	std::size_t totalSize = 0;
+	for (std::uint32_t level = 0; level < mipLevels; ++level) {
+		auto blockCountY = (levels[level].height + 3) / 4;
+		encoded.subresourceOffsets[level] = totalSize;
+		totalSize += static_cast<std::size_t>((levels[level].width + 3) / 4) * blockCountY * blockSize;
+		for (std::uint32_t blockY = 0; blockY < blockCountY; ++blockY) tasks.push_back({ level, blockY });
+	}
+	encoded.data.resize(totalSize);
+
+	std::atomic<std::size_t> nextTask{ 0 };
+	auto worker = [&]() {
+		Block block{};
+		for (auto taskIndex = nextTask.fetch_add(1); taskIndex < tasks.size(); taskIndex = nextTask.fetch_add(1)) {
+			const auto& task = tasks[taskIndex];
+			const auto& level = levels[task.level];
+
+			auto blockCountX = (level.width + 3) / 4;
+			auto dest = encoded.data.data() + encoded.subresourceOffsets[task.level] + static_cast<std::size_t>(task.blockY) * blockCountX * blockSize;
+
+			for (std::uint32_t blockX = 0; blockX < blockCountX; ++blockX) {
+				loadBlock(level, blockX, task.blockY, block);
+				encodeBlock(block, dest + blockX * blockSize);
+			}
+		}
+	};
+
+	auto threadCount = std::min<std::size_t>(threadCount_, tasks.size());
+	std::vector<std::thread> threads{};
+	for (std::size_t i = 1; i < threadCount; ++i) threads.emplace_back(worker);
+	worker();
+	for (auto& thread : threads) thread.join();
+
+	return true;
+}
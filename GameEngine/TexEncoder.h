@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEX_ENCODER_SSE2
+#endif
+
+#include "TexImage.h"
+
+// block compression of decoded R8G8B8A8 images (texture cooking)
+// full mip chain is built on CPU first, then 4x4 blocks are encoded on all worker threads
+class TexEncoder {
+public:
+	enum class Mode {
+		// BC1 for opaque images, BC3 when alpha is used (4 / 8 bits per texel)
+		Fast,
+		// BC7 mode 6 (8 bits per texel, higher quality)
+		Quality,
+	};
+
+private:
+	// 4x4 texels, RGBA8
+	struct Block {
+		alignas(16) std::uint8_t texels[64];
+	};
+
+	struct Level {
+		std::uint32_t width;
+		std::uint32_t height;
+		const std::uint8_t* pixels;
+	};
+
+	std::uint32_t threadCount_;
+
+	static void buildMipChain(const TexImage&, std::uint32_t, std::vector<std::vector<std::uint8_t>>&);
+	static void loadBlock(const Level&, std::uint32_t, std::uint32_t, Block&);
+
+	static void encodeBC1(const Block&, std::uint8_t*);
+	static void encodeBC3(const Block&, std::uint8_t*);
+	static void encodeBC7(const Block&, std::uint8_t*);
+
+public:
+	// 0 -> one thread per hardware thread
+	explicit TexEncoder(std::uint32_t threadCount = 0);
+
+	// source must be single level R8G8B8A8 (UNORM or SRGB)
+	bool encode(const TexImage& source, Mode mode, TexImage& encoded);
+};
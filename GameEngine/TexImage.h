@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// decoded image ready for upload
+struct TexImage {
+	VkExtent3D size;
+	VkFormat format;
+
+	// number of mip levels stored in data (1 -> remaining levels are generated on GPU)
+	std::uint32_t mipLevels;
+	// number of array layers (cubemap: 6 faces per element, +X -X +Y -Y +Z -Z)
+	std::uint32_t arrayLayers;
+	bool cube;
+	// every texel has alpha 1 (false when unknown)
+	bool opaque;
+	// byte offset of each subresource in data, indexed by (layer * mipLevels + level)
+	std::vector<std::size_t> subresourceOffsets;
+
+	// pixel data (empty when payload is streamed straight into upload buffer)
+	std::vector<std::uint8_t> data;
+};
@@ -14,9 +14,68 @@
 #define STBI_ONLY_BMP
 #include "stb_image.h"
 #include "DDSLoader.h"
+#include "Hash.h"
+#include "TexImage.h"
 
 class TexLoader {
 
 public:
-	bool load(const std::filesystem::path&, VkExtent3D&, VkFormat&, std::vector<std::uint8_t>&);
+	// read raw file bytes (for content hashing before decode)
+	bool read(const std::filesystem::path&, std::vector<std::uint8_t>&);
+	// decode file bytes already in memory (format is decided by extension of path)
+	bool decode(const std::filesystem::path&, const std::vector<std::uint8_t>&, TexImage&);
+
+	bool load(const std::filesystem::path&, TexImage&);
+
+	// DDS only: headers are parsed first, then payload is read straight into memory returned by allocate(payloadSize)
+	// contentHash covers headers and payload
+	template<typename Allocator>
+	bool readDDS(const std::filesystem::path&, TexImage&, std::uint64_t&, Allocator);
 };
+
+template<typename Allocator>
+bool TexLoader::readDDS(const std::filesystem::path& path, TexImage& image, std::uint64_t& contentHash, Allocator allocate) {
+	std::ifstream ifs(path, std::ios::in | std::ios::binary);
+	if (!ifs) {
+		std::cerr << "[TexLoader] (" << path << ") failed to open image" << std::endl;
+		return false;
+	}
+
+	ifs.seekg(0, std::ios::end);
+	auto fileSize = static_cast<std::size_t>(ifs.tellg());
+	ifs.seekg(0, std::ios::beg);
+
+	std::uint8_t headerData[DDSLoader::maxHeaderSize]{};
+	auto headerSize = std::min(fileSize, DDSLoader::maxHeaderSize);
+	ifs.read((char*)headerData, headerSize);
+
+	DDSLoader loader{};
+	std::size_t payloadOffset{}, payloadSize{};
+	if (!loader.parseHeader(headerData, headerSize, fileSize, image, payloadOffset, payloadSize)) return false;
+
+	contentHash = hashContent(headerData, payloadOffset);
+
+	// chunks are block aligned (chunk size is multiple of every block size), so they are scanned one by one
+	bool scanAlpha = loader.isAlphaModeUnknown();
+	if (scanAlpha) image.opaque = true;
+
+	std::uint8_t* dest = allocate(payloadSize);
+	ifs.seekg(payloadOffset, std::ios::beg);
+
+	// file -> destination in chunks, hashing each chunk while it is still in cache
+	// (destination is usually write-combined upload memory, which is slow to read back)
+	constexpr std::size_t chunkSize = 256 * 1024;
+	std::vector<std::uint8_t> chunk(std::min(chunkSize, payloadSize));
+	for (std::size_t offset = 0; offset < payloadSize; offset += chunkSize) {
+		auto size = std::min(chunkSize, payloadSize - offset);
+		if (!ifs.read((char*)chunk.data(), size)) {
+			std::cerr << "[TexLoader] (" << path << ") failed to read image" << std::endl;
+			return false;
+		}
+		contentHash = hashContent(chunk.data(), size, contentHash);
+		if (scanAlpha && image.opaque) image.opaque = DDSLoader::isOpaque(image.format, chunk.data(), size);
+		std::memcpy(dest + offset, chunk.data(), size);
+	}
+
+	return true;
+}
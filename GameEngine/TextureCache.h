@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Hash.h"
+
+// process-wide cache of resident textures
+// key: canonical path (alias) + content hash (identity)
+// -> same file referenced by many models, or same image stored under different names, is decoded and uploaded once
+template<typename T>
+class TextureCache {
+	using PathKey = std::filesystem::path::string_type;
+
+	struct Entry {
+		T texture;
+		std::uint32_t refCount;
+	};
+
+	std::mutex mutex_;
+	std::unordered_map<PathKey, std::uint64_t> paths_;
+	std::unordered_map<std::uint64_t, Entry> entries_;
+
+	TextureCache() = default;
+
+public:
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+
+	static TextureCache& instance() {
+		static TextureCache cache{};
+		return cache;
+	}
+
+	// 64-bit FNV-1a over raw file bytes
+	static std::uint64_t hash(const std::vector<std::uint8_t>& data) {
+		return hashContent(data.data(), data.size());
+	}
+
+	static PathKey canonicalKey(const std::filesystem::path& path) {
+		std::error_code error{};
+		auto canonical = std::filesystem::weakly_canonical(path, error);
+		return error ? path.lexically_normal().native() : canonical.native();
+	}
+
+	// fast path: already seen this file (no file read)
+	bool acquire(const PathKey& path, T& texture) {
+		std::lock_guard lock(mutex_);
+
+		auto pathIt = paths_.find(path);
+		if (pathIt == paths_.end()) return false;
+
+		auto entryIt = entries_.find(pathIt->second);
+		if (entryIt == entries_.end()) return false;
+
+		++entryIt->second.refCount;
+		texture = entryIt->second.texture;
+		return true;
+	}
+
+	// slow path: same content under another path -> register alias
+	bool acquire(const PathKey& path, std::uint64_t contentHash, T& texture) {
+		std::lock_guard lock(mutex_);
+
+		auto entryIt = entries_.find(contentHash);
+		if (entryIt == entries_.end()) return false;
+
+		paths_[path] = contentHash;
+		++entryIt->second.refCount;
+		texture = entryIt->second.texture;
+		return true;
+	}
+
+	// register newly created texture (holds one reference)
+	// same content inserted meanwhile by racing load -> duplicate goes to deleter, texture becomes reference to resident one
+	template<typename Deleter>
+	void insert(const PathKey& path, std::uint64_t contentHash, T& texture, Deleter deleter) {
+		std::lock_guard lock(mutex_);
+
+		paths_[path] = contentHash;
+		auto [entryIt, inserted] = entries_.try_emplace(contentHash, Entry{ texture, 1 });
+		if (inserted) return;
+
+		deleter(texture);
+		++entryIt->second.refCount;
+		texture = entryIt->second.texture;
+	}
+
+	// drop one reference, deleter is called when the last reference is gone
+	template<typename Deleter>
+	void release(std::uint64_t contentHash, Deleter deleter) {
+		std::lock_guard lock(mutex_);
+
+		auto entryIt = entries_.find(contentHash);
+		if (entryIt == entries_.end()) return;
+
+		if (--entryIt->second.refCount > 0) return;
+
+		deleter(entryIt->second.texture);
+		entries_.erase(entryIt);
+		std::erase_if(paths_, [contentHash](const auto& path) { return path.second == contentHash; });
+	}
+
+	std::size_t size() {
+		std::lock_guard lock(mutex_);
+		return entries_.size();
+	}
+};
@@ -13,10 +13,15 @@ layout(binding = 1) uniform MaterialBufferObject {
 	float specCoef;
 	vec3 ambient;
 	bool isTextureUsed;
-	bool isSphereUsed;
+	// 0: none, 1: multiply, 2: add
+	uint sphereMode;
 	bool isToonUsed;
 } material;
 
+// material features baked into pipeline variant (GraphicsEngine::materialFeatures), all ones -> read from material
+layout(constant_id = 0) const uint materialFeatures = 0xffffffffu;
+const bool isDynamic = materialFeatures == 0xffffffffu;
+
 layout(binding = 2) uniform sampler2D textureSampler;
 layout(binding = 3) uniform sampler2D sphereSampler;
 layout(binding = 4) uniform sampler2D toonSampler;
@@ -39,16 +44,22 @@ void main() {
 	outColor.a = material.diffuse.a;
 	outColor = clamp(outColor, 0.0f, 1.0f);*/
 	
-	if (material.isTextureUsed) {
+	// constant in specialized variants, branches and unused samples are dropped
+	bool isTextureUsed = isDynamic ? material.isTextureUsed : (materialFeatures & 0x1u) != 0u;
+	bool isToonUsed = isDynamic ? material.isToonUsed : (materialFeatures & 0x2u) != 0u;
+	uint sphereMode = isDynamic ? material.sphereMode : (materialFeatures >> 2) & 0x3u;
+
+	if (isTextureUsed) {
 		outColor *= texture(textureSampler, vTexCoord);
 	}
 
-	if (material.isSphereUsed) {
+	if (sphereMode != 0u) {
 		vec2 sphereTexCoord = vec2(viewNormal.x * 0.5f + 0.5f, viewNormal.y * -0.5f + 0.5f);
-		outColor.rgb += texture(sphereSampler, sphereTexCoord).rgb;
+		vec3 sphere = texture(sphereSampler, sphereTexCoord).rgb;
+		outColor.rgb = sphereMode == 1u ? outColor.rgb * sphere : outColor.rgb + sphere;
 	}
 
-	if (material.isToonUsed) {
+	if (isToonUsed) {
 		outColor.rgb *= texture(toonSampler, vec2(0.5f, 1.0f - diffIntense)).rgb;
 	}
 }
\ No newline at end of file
@@ -23,11 +23,28 @@ layout(binding = 0) uniform TransformBufferObject{
 	mat4 normalMatrix;
 } transform;
 
+// palettes of all instances
 layout(std430, binding = 5) buffer BoneMatrix {
 	mat4 boneMatrix[];
 };
 
+struct InstanceRecord {
+	mat4 model;
+	mat4 normalMatrix;
+	uint boneOffset;
+};
+
+layout(std430, binding = 6) readonly buffer InstanceBuffer {
+	InstanceRecord instances[];
+};
+
+// bit exact with depth.vert, opaque pass tests EQUAL against prepass depth
+invariant gl_Position;
+
 void main() {
+	InstanceRecord instance = instances[gl_InstanceIndex];
+	int boneOffset = int(instance.boneOffset);
+
 	vec3 light = vec3(-5.0f, 5.0f, -5.0f);
 
 	vec4 pos = vec4(position, 1.0f);
@@ -37,34 +54,34 @@ void main() {
 
 	// BDEF1
 	if (boneIndices.y == -1) {
-		skinnedPos = (boneMatrix[boneIndices.x] * pos);
-		skinnedNor = (boneMatrix[boneIndices.x] * nor);
+		skinnedPos = (boneMatrix[boneOffset + boneIndices.x] * pos);
+		skinnedNor = (boneMatrix[boneOffset + boneIndices.x] * nor);
 	}
 	// BDEF2 (or SDEF)
 	else if (boneIndices.z == -1) {
-		skinnedPos = (boneMatrix[boneIndices.x] * pos) * boneWeights.x;
-		skinnedPos += (boneMatrix[boneIndices.y] * pos) * (1.0f - boneWeights.x);
-		skinnedNor = (boneMatrix[boneIndices.x] * nor) * boneWeights.x;
-		skinnedNor += (boneMatrix[boneIndices.y] * nor) * (1.0f - boneWeights.x);
+		skinnedPos = (boneMatrix[boneOffset + boneIndices.x] * pos) * boneWeights.x;
+		skinnedPos += (boneMatrix[boneOffset + boneIndices.y] * pos) * (1.0f - boneWeights.x);
+		skinnedNor = (boneMatrix[boneOffset + boneIndices.x] * nor) * boneWeights.x;
+		skinnedNor += (boneMatrix[boneOffset + boneIndices.y] * nor) * (1.0f - boneWeights.x);
 	}
 	// BDEF4
 	else {
-		skinnedPos = (boneMatrix[boneIndices.x] * pos) * boneWeights.x;
-		skinnedPos += (boneMatrix[boneIndices.y] * pos) * boneWeights.y;
-		skinnedPos += (boneMatrix[boneIndices.z] * pos) * boneWeights.z;
-		skinnedPos += (boneMatrix[boneIndices.w] * pos) * boneWeights.w;
-		skinnedNor = (boneMatrix[boneIndices.x] * nor) * boneWeights.x;
-		skinnedNor += (boneMatrix[boneIndices.y] * nor) * boneWeights.y;
-		skinnedNor += (boneMatrix[boneIndices.z] * nor) * boneWeights.z;
-		skinnedNor += (boneMatrix[boneIndices.w] * nor) * boneWeights.w;
+		skinnedPos = (boneMatrix[boneOffset + boneIndices.x] * pos) * boneWeights.x;
+		skinnedPos += (boneMatrix[boneOffset + boneIndices.y] * pos) * boneWeights.y;
+		skinnedPos += (boneMatrix[boneOffset + boneIndices.z] * pos) * boneWeights.z;
+		skinnedPos += (boneMatrix[boneOffset + boneIndices.w] * pos) * boneWeights.w;
+		skinnedNor = (boneMatrix[boneOffset + boneIndices.x] * nor) * boneWeights.x;
+		skinnedNor += (boneMatrix[boneOffset + boneIndices.y] * nor) * boneWeights.y;
+		skinnedNor += (boneMatrix[boneOffset + boneIndices.z] * nor) * boneWeights.z;
+		skinnedNor += (boneMatrix[boneOffset + boneIndices.w] * nor) * boneWeights.w;
 	}
 
 	//gl_Position = transform.projection * transform.view * transform.model * vec4(position, 1.0f);
-	gl_Position = transform.projection * transform.view * transform.model * skinnedPos;
+	gl_Position = transform.projection * transform.view * instance.model * skinnedPos;
 	//viewPosition = vec3(transform.view * transform.model * vec4(position, 1.0f));
-	viewPosition = vec3(transform.view * transform.model * skinnedPos);
+	viewPosition = vec3(transform.view * instance.model * skinnedPos);
 	//viewNormal = vec3(transform.view * transform.normalMatrix * vec4(normal, 0.0f));
-	viewNormal = vec3(transform.view * transform.normalMatrix * skinnedNor);
+	viewNormal = vec3(transform.view * instance.normalMatrix * skinnedNor);
 	vTexCoord = uv;
 
 	viewLight = vec3(transform.view * vec4(light, 1.0f));
@@ -0,0 +1,72 @@
+#version 460
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 viewPosition;
+layout(location = 1) in vec3 viewNormal;
+layout(location = 2) in vec2 vTexCoord;
+layout(location = 3) in vec3 viewLight;
+
+layout(location = 0) out vec4 outColor;
+
+struct MaterialRecord {
+	vec4 diffuse;
+	vec3 specular;
+	float specCoef;
+	vec3 ambient;
+	uint isTextureUsed;
+	// 0: none, 1: multiply, 2: add
+	uint sphereMode;
+	uint isToonUsed;
+	uint textureIndex;
+	uint sphereIndex;
+	uint toonIndex;
+};
+
+layout(std430, binding = 1) readonly buffer MaterialBuffer {
+	MaterialRecord materials[];
+};
+
+// samplers[0]: textures / sphere maps (repeat), samplers[1]: toon ramps (clamp)
+layout(binding = 7) uniform sampler samplers[2];
+layout(binding = 8) uniform texture2D textures[];
+
+// material features baked into pipeline variant (GraphicsEngine::materialFeatures), all ones -> read from material
+layout(constant_id = 0) const uint materialFeatures = 0xffffffffu;
+const bool isDynamic = materialFeatures == 0xffffffffu;
+
+layout(push_constant) uniform PushConstants {
+	uint materialIndex;
+} pushConstants;
+
+void main() {
+	MaterialRecord material = materials[pushConstants.materialIndex];
+
+	vec3 N = normalize(viewNormal);
+	vec3 L = normalize(viewLight - viewPosition);
+	vec3 V = normalize(-viewPosition);
+	vec3 H = normalize(L + V);
+
+	float diffIntense = clamp(dot(N, L), 0.0f, 1.0f);
+	float specIntense = pow(clamp(dot(H, N), 0.0f, 1.0f), material.specCoef);
+
+	outColor = vec4(1.0f);
+
+	// constant in specialized variants, branches and unused samples are dropped
+	bool isTextureUsed = isDynamic ? material.isTextureUsed != 0u : (materialFeatures & 0x1u) != 0u;
+	bool isToonUsed = isDynamic ? material.isToonUsed != 0u : (materialFeatures & 0x2u) != 0u;
+	uint sphereMode = isDynamic ? material.sphereMode : (materialFeatures >> 2) & 0x3u;
+
+	if (isTextureUsed) {
+		outColor *= texture(sampler2D(textures[nonuniformEXT(material.textureIndex)], samplers[0]), vTexCoord);
+	}
+
+	if (sphereMode != 0u) {
+		vec2 sphereTexCoord = vec2(viewNormal.x * 0.5f + 0.5f, viewNormal.y * -0.5f + 0.5f);
+		vec3 sphere = texture(sampler2D(textures[nonuniformEXT(material.sphereIndex)], samplers[0]), sphereTexCoord).rgb;
+		outColor.rgb = sphereMode == 1u ? outColor.rgb * sphere : outColor.rgb + sphere;
+	}
+
+	if (isToonUsed) {
+		outColor.rgb *= texture(sampler2D(textures[nonuniformEXT(material.toonIndex)], samplers[1]), vec2(0.5f, 1.0f - diffIntense)).rgb;
+	}
+}
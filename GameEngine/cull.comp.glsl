@@ -0,0 +1,144 @@
+#version 460
+
+layout(local_size_x = 64) in;
+
+struct DrawRecord {
+	mat4 model;
+	vec4 boundingSphere;
+	uint materialIndex;
+	uint indexCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint boneOffset;
+};
+
+struct DrawIndexedIndirectCommand {
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+};
+
+// world space planes, inside -> dot(plane.xyz, p) + plane.w >= 0
+layout(binding = 0) uniform CullParameters {
+	mat4 viewProjection;
+	vec4 frustumPlanes[6];
+	uint drawCount;
+	// 1 -> survivors are packed and counted (draw indirect count), 0 -> culled commands get instanceCount 0
+	uint compact;
+	// 1 -> two phase Hi-Z occlusion culling, 0 -> frustum culling only (phase 0)
+	uint occlusion;
+} parameters;
+
+layout(std430, binding = 1) readonly buffer DrawRecordBuffer {
+	DrawRecord records[];
+};
+
+// [early commands][late commands], maxDraws each
+layout(std430, binding = 2) writeonly buffer DrawCommandBuffer {
+	DrawIndexedIndirectCommand commands[];
+};
+
+layout(std430, binding = 3) buffer DrawCountBuffer {
+	uint visibleCount[2];
+};
+
+// 1 -> drawn last frame, kept across frames
+layout(std430, binding = 4) buffer VisibilityBuffer {
+	uint visibility[];
+};
+
+// max depth pyramid of early pass depth
+layout(set = 1, binding = 0) uniform sampler2D hiZ;
+
+// 0 -> early pass (last frame's visible set), 1 -> late pass (rest, tested against Hi-Z)
+layout(push_constant) uniform CullPushConstants {
+	uint phase;
+} pushConstants;
+
+// draw record capacity (GraphicsEngine::indirectDrawCapacity_), stride between early and late commands
+layout(constant_id = 0) const uint maxDraws = 8192;
+
+bool isOccluded(vec3 center, float radius) {
+	// screen rect and nearest depth of sphere bounding box
+	vec2 uvMin = vec2(1.0f);
+	vec2 uvMax = vec2(0.0f);
+	float nearestDepth = 1.0f;
+	for (int i = 0; i < 8; ++i) {
+		vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0f : -1.0f, (i & 2) != 0 ? 1.0f : -1.0f, (i & 4) != 0 ? 1.0f : -1.0f);
+		vec4 clip = parameters.viewProjection * vec4(corner, 1.0f);
+		// crosses near plane -> keep it
+		if (clip.w <= 0.0f) return false;
+
+		vec3 ndc = clip.xyz / clip.w;
+		vec2 uv = ndc.xy * 0.5f + 0.5f;
+		uvMin = min(uvMin, uv);
+		uvMax = max(uvMax, uv);
+		nearestDepth = min(nearestDepth, ndc.z);
+	}
+
+	ivec2 size = textureSize(hiZ, 0);
+	ivec2 begin = clamp(ivec2(clamp(uvMin, 0.0f, 1.0f) * vec2(size)), ivec2(0), size - 1);
+	ivec2 end = clamp(ivec2(clamp(uvMax, 0.0f, 1.0f) * vec2(size)), ivec2(0), size - 1);
+
+	// level where rect spans at most 2x2 texels
+	ivec2 extent = end - begin + 1;
+	int levels = textureQueryLevels(hiZ);
+	int level = min(int(ceil(log2(float(max(extent.x, extent.y))))), levels - 1);
+
+	ivec2 levelSize = max(size >> level, ivec2(1));
+	ivec2 levelBegin = min(begin >> level, levelSize - 1);
+	ivec2 levelEnd = min(end >> level, levelSize - 1);
+
+	float farthestDepth = max(
+		max(texelFetch(hiZ, levelBegin, level).r, texelFetch(hiZ, ivec2(levelEnd.x, levelBegin.y), level).r),
+		max(texelFetch(hiZ, ivec2(levelBegin.x, levelEnd.y), level).r, texelFetch(hiZ, levelEnd, level).r));
+
+	return nearestDepth > farthestDepth;
+}
+
+void main() {
+	uint drawIndex = gl_GlobalInvocationID.x;
+	if (drawIndex >= parameters.drawCount) return;
+
+	DrawRecord record = records[drawIndex];
+
+	vec3 center = vec3(record.model * vec4(record.boundingSphere.xyz, 1.0f));
+	float scale = max(length(record.model[0].xyz), max(length(record.model[1].xyz), length(record.model[2].xyz)));
+	float radius = record.boundingSphere.w * scale;
+
+	bool inFrustum = true;
+	for (int i = 0; i < 6; ++i) {
+		inFrustum = inFrustum && dot(parameters.frustumPlanes[i].xyz, center) + parameters.frustumPlanes[i].w >= -radius;
+	}
+
+	bool visible = inFrustum;
+	if (parameters.occlusion != 0) {
+		bool wasVisible = visibility[drawIndex] != 0;
+		if (pushConstants.phase == 0) {
+			visible = inFrustum && wasVisible;
+		}
+		else {
+			// early pass draws are kept, they are already on screen
+			visible = inFrustum && !isOccluded(center, radius);
+			visibility[drawIndex] = visible ? 1 : 0;
+			visible = visible && !wasVisible;
+		}
+	}
+
+	DrawIndexedIndirectCommand command;
+	command.indexCount = record.indexCount;
+	command.instanceCount = visible ? 1 : 0;
+	command.firstIndex = record.firstIndex;
+	command.vertexOffset = record.vertexOffset;
+	command.firstInstance = drawIndex;
+
+	uint base = maxDraws * pushConstants.phase;
+	if (parameters.compact != 0) {
+		if (visible) commands[base + atomicAdd(visibleCount[pushConstants.phase], 1)] = command;
+	}
+	else {
+		commands[base + drawIndex] = command;
+	}
+}
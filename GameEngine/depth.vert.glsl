@@ -0,0 +1,57 @@
+#version 460
+
+// depth prepass: same position math as basic.vert (invariant), nothing else
+layout(location = 0) in vec3 position;
+layout(location = 7) in ivec4 boneIndices;
+layout(location = 8) in vec4 boneWeights;
+
+layout(binding = 0) uniform TransformBufferObject{
+	mat4 model;
+	mat4 view;
+	mat4 projection;
+	mat4 normalMatrix;
+} transform;
+
+// palettes of all instances
+layout(std430, binding = 5) buffer BoneMatrix {
+	mat4 boneMatrix[];
+};
+
+struct InstanceRecord {
+	mat4 model;
+	mat4 normalMatrix;
+	uint boneOffset;
+};
+
+layout(std430, binding = 6) readonly buffer InstanceBuffer {
+	InstanceRecord instances[];
+};
+
+invariant gl_Position;
+
+void main() {
+	InstanceRecord instance = instances[gl_InstanceIndex];
+	int boneOffset = int(instance.boneOffset);
+
+	vec4 pos = vec4(position, 1.0f);
+	vec4 skinnedPos;
+
+	// BDEF1
+	if (boneIndices.y == -1) {
+		skinnedPos = (boneMatrix[boneOffset + boneIndices.x] * pos);
+	}
+	// BDEF2 (or SDEF)
+	else if (boneIndices.z == -1) {
+		skinnedPos = (boneMatrix[boneOffset + boneIndices.x] * pos) * boneWeights.x;
+		skinnedPos += (boneMatrix[boneOffset + boneIndices.y] * pos) * (1.0f - boneWeights.x);
+	}
+	// BDEF4
+	else {
+		skinnedPos = (boneMatrix[boneOffset + boneIndices.x] * pos) * boneWeights.x;
+		skinnedPos += (boneMatrix[boneOffset + boneIndices.y] * pos) * boneWeights.y;
+		skinnedPos += (boneMatrix[boneOffset + boneIndices.z] * pos) * boneWeights.z;
+		skinnedPos += (boneMatrix[boneOffset + boneIndices.w] * pos) * boneWeights.w;
+	}
+
+	gl_Position = transform.projection * transform.view * instance.model * skinnedPos;
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#version 460
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// depth image (level 0) or previous pyramid level
+layout(binding = 0) uniform sampler2D source;
+
+layout(binding = 1, r32f) uniform writeonly image2D destination;
+
+void main() {
+	ivec2 position = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 destinationSize = imageSize(destination);
+	if (any(greaterThanEqual(position, destinationSize))) return;
+
+	ivec2 sourceSize = textureSize(source, 0);
+	if (sourceSize == destinationSize) {
+		imageStore(destination, position, vec4(texelFetch(source, position, 0).r));
+		return;
+	}
+
+	// 2x2 footprint, last row / column also takes odd remainder so no texel is skipped
+	ivec2 begin = position * 2;
+	ivec2 end = min(begin + 2 + ivec2(equal(position, destinationSize - 1)) * (sourceSize & 1), sourceSize);
+
+	float farthestDepth = 0.0f;
+	for (int y = begin.y; y < end.y; ++y) {
+		for (int x = begin.x; x < end.x; ++x) {
+			farthestDepth = max(farthestDepth, texelFetch(source, ivec2(x, y), 0).r);
+		}
+	}
+
+	imageStore(destination, position, vec4(farthestDepth));
+}
@@ -0,0 +1,90 @@
+#version 460
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 uv;
+layout(location = 3) in vec4 a_uv1;
+layout(location = 4) in vec4 a_uv2;
+layout(location = 5) in vec4 a_uv3;
+layout(location = 6) in vec4 a_uv4;
+layout(location = 7) in ivec4 boneIndices;
+layout(location = 8) in vec4 boneWeights;
+layout(location = 9) in float edgeMult;
+
+layout(location = 0) out vec3 viewPosition;
+layout(location = 1) out vec3 viewNormal;
+layout(location = 2) out vec2 vTexCoord;
+layout(location = 3) out vec3 viewLight;
+layout(location = 4) flat out uint materialIndex;
+
+layout(binding = 0) uniform TransformBufferObject{
+	mat4 model;
+	mat4 view;
+	mat4 projection;
+	mat4 normalMatrix;
+} transform;
+
+layout(std430, binding = 5) buffer BoneMatrix {
+	mat4 boneMatrix[];
+};
+
+struct DrawRecord {
+	mat4 model;
+	vec4 boundingSphere;
+	uint materialIndex;
+	uint indexCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint boneOffset;
+};
+
+// firstInstance of every indirect command is its draw record
+layout(std430, set = 1, binding = 1) readonly buffer DrawRecordBuffer {
+	DrawRecord records[];
+};
+
+void main() {
+	DrawRecord record = records[gl_InstanceIndex];
+	mat4 model = record.model;
+	mat3 normalMatrix = transpose(inverse(mat3(model)));
+	int boneOffset = int(record.boneOffset);
+
+	vec3 light = vec3(-5.0f, 5.0f, -5.0f);
+
+	vec4 pos = vec4(position, 1.0f);
+	vec4 skinnedPos;
+	vec4 nor = vec4(normal, 0.0f);
+	vec4 skinnedNor;
+
+	// BDEF1
+	if (boneIndices.y == -1) {
+		skinnedPos = (boneMatrix[boneOffset + boneIndices.x] * pos);
+		skinnedNor = (boneMatrix[boneOffset + boneIndices.x] * nor);
+	}
+	// BDEF2 (or SDEF)
+	else if (boneIndices.z == -1) {
+		skinnedPos = (boneMatrix[boneOffset + boneIndices.x] * pos) * boneWeights.x;
+		skinnedPos += (boneMatrix[boneOffset + boneIndices.y] * pos) * (1.0f - boneWeights.x);
+		skinnedNor = (boneMatrix[boneOffset + boneIndices.x] * nor) * boneWeights.x;
+		skinnedNor += (boneMatrix[boneOffset + boneIndices.y] * nor) * (1.0f - boneWeights.x);
+	}
+	// BDEF4
+	else {
+		skinnedPos = (boneMatrix[boneOffset + boneIndices.x] * pos) * boneWeights.x;
+		skinnedPos += (boneMatrix[boneOffset + boneIndices.y] * pos) * boneWeights.y;
+		skinnedPos += (boneMatrix[boneOffset + boneIndices.z] * pos) * boneWeights.z;
+		skinnedPos += (boneMatrix[boneOffset + boneIndices.w] * pos) * boneWeights.w;
+		skinnedNor = (boneMatrix[boneOffset + boneIndices.x] * nor) * boneWeights.x;
+		skinnedNor += (boneMatrix[boneOffset + boneIndices.y] * nor) * boneWeights.y;
+		skinnedNor += (boneMatrix[boneOffset + boneIndices.z] * nor) * boneWeights.z;
+		skinnedNor += (boneMatrix[boneOffset + boneIndices.w] * nor) * boneWeights.w;
+	}
+
+	gl_Position = transform.projection * transform.view * model * skinnedPos;
+	viewPosition = vec3(transform.view * model * skinnedPos);
+	viewNormal = mat3(transform.view) * normalMatrix * skinnedNor.xyz;
+	vTexCoord = uv;
+	materialIndex = record.materialIndex;
+
+	viewLight = vec3(transform.view * vec4(light, 1.0f));
+}
\ No newline at end of file
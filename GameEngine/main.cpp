@@ -2,9 +2,11 @@
 #include <SDL2/SDL_vulkan.h>
 #include <shaderc/shaderc.hpp>
 
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <string_view>
 #include <vector>
 
 #include "GraphicsEngine.h"
@@ -15,7 +17,13 @@ int main(int argc, char* argv[]) {
 	GLSLCompiler compiler{};
 
 	compiler.compile("basic.vert.glsl");
+	compiler.compile("depth.vert.glsl");
 	compiler.compile("basic.frag.glsl");
+	compiler.compile("bindless.frag.glsl");
+	compiler.compile("indirect.vert.glsl");
+	compiler.compile("indirect.frag.glsl");
+	compiler.compile("cull.comp.glsl");
+	compiler.compile("hiz.comp.glsl");
 
 	constexpr std::int32_t windowWidth = 1024;
 	constexpr std::int32_t windowHeight = 768;
@@ -25,7 +33,7 @@ int main(int argc, char* argv[]) {
 		return 1;
 	}
 
-	auto window = SDL_CreateWindow("Game Engine", 100, 100, windowWidth, windowHeight, SDL_WINDOW_VULKAN);
+	auto window = SDL_CreateWindow("Game Engine", 100, 100, windowWidth, windowHeight, SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
 
 	if (!window) {
 		SDL_Log("failed to create window: %s", SDL_GetError());
@@ -34,18 +42,110 @@ int main(int argc, char* argv[]) {
 	}
 
 	auto graphicsEngine = GraphicsEngine();
-	graphicsEngine.initialize(window, "Game Engine", VK_MAKE_API_VERSION(0, 0, 1, 0), { windowWidth, windowHeight });
+	graphicsEngine.setTextureCompression(GraphicsEngine::TextureCompression::Quality);
+
+	PresentSettings presentSettings{};
+	const char* jobTracePath = nullptr;
+	std::vector<const char*> modelPaths{};
+	for (auto i = 1; i < argc; ++i) {
+		auto argument = std::string_view(argv[i]);
+		if (argument == "--low-latency") {
+			presentSettings.lowLatency = true;
+		}
+		if (argument == "--no-bindless") {
+			graphicsEngine.setBindless(false);
+		}
+		if (argument == "--no-gpu-driven") {
+			graphicsEngine.setGpuDriven(false);
+		}
+		if (argument == "--no-occlusion") {
+			graphicsEngine.setOcclusionCulling(false);
+		}
+		if (argument == "--no-prepass") {
+			graphicsEngine.setDepthPrepass(false);
+		}
+		if (argument == "--cold-pipelines") {
+			graphicsEngine.setPipelineCacheLoad(false);
+		}
+		if (i + 1 >= argc) continue;
+
+		auto value = std::string_view(argv[i + 1]);
+		if (argument == "--frames-in-flight") {
+			graphicsEngine.setFramesInFlight(static_cast<std::uint32_t>(std::atoi(argv[i + 1])));
+		}
+		else if (argument == "--instances") {
+			graphicsEngine.setInstanceCount(static_cast<std::uint32_t>(std::atoi(argv[i + 1])));
+		}
+		else if (argument == "--bone-palettes") {
+			graphicsEngine.setBonePaletteCount(static_cast<std::uint32_t>(std::atoi(argv[i + 1])));
+		}
+		else if (argument == "--record-threads") {
+			graphicsEngine.setRecordThreads(static_cast<std::uint32_t>(std::atoi(argv[i + 1])));
+		}
+		else if (argument == "--present-mode") {
+			if (value == "mailbox") presentSettings.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+			else if (value == "immediate") presentSettings.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+			else presentSettings.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+		}
+		else if (argument == "--images") {
+			presentSettings.imageCount = static_cast<std::uint32_t>(std::atoi(argv[i + 1]));
+		}
+		else if (argument == "--target-latency") {
+			presentSettings.targetLatencyMilliseconds = std::atof(argv[i + 1]);
+		}
+		else if (argument == "--job-trace") {
+			jobTracePath = argv[i + 1];
+		}
+		else if (argument == "--model") {
+			modelPaths.push_back(argv[i + 1]);
+		}
+		else continue;
+
+		// value is consumed, not parsed again as option
+		++i;
+	}
+
+	// one object per given model, side by side
+	if (!modelPaths.empty()) {
+		Scene scene{};
+		for (auto i = 0; i < modelPaths.size(); ++i) {
+			auto x = (i - (modelPaths.size() - 1) * 0.5f) * 10.0f;
+			scene.addObject(scene.addModel(modelPaths[i]), glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, 0.0f)));
+		}
+		graphicsEngine.setScene(scene);
+	}
+	graphicsEngine.initialize(window, "Game Engine", VK_MAKE_API_VERSION(0, 0, 1, 0), { windowWidth, windowHeight }, presentSettings);
+
+	for (auto i = 1; i < argc; ++i) {
+		if (std::string_view(argv[i]) == "--benchmark-placement") {
+			graphicsEngine.benchmarkMemoryPlacement(200);
+		}
+		if (std::string_view(argv[i]) == "--benchmark-recording") {
+			graphicsEngine.benchmarkRecording(200);
+		}
+	}
+	if (jobTracePath) {
+		graphicsEngine.captureJobTrace(jobTracePath, 10);
+	}
 
 	bool isRunning = true;
 
 	while (isRunning) {
 		SDL_Event event{};
 
+		// input is sampled from here on
+		graphicsEngine.paceFrame();
+
 		while (SDL_PollEvent(&event)) {
 			switch (event.type) {
 			case SDL_QUIT:
 				isRunning = false;
 				break;
+			case SDL_WINDOWEVENT:
+				if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+					graphicsEngine.resize();
+				}
+				break;
 			default:
 				break;
 			}
@@ -59,6 +159,8 @@ int main(int argc, char* argv[]) {
 		graphicsEngine.draw();
 	}
 
+	graphicsEngine.savePipelineCache();
+
 	SDL_Quit();
 
 	return 0;